@@ -0,0 +1,124 @@
+// Bulk dictionary import from tab-separated (roman, devanagari, count) records
+// Run with: cargo run --release --bin akshar_import -- words.tsv [--bigrams bigrams.tsv] [--output dictionary.bin] [--lexicon lexicon.akl] [--force]
+// src/bin/akshar_import.rs
+use akshar_ime::import::DictionaryBuilder;
+use akshar_ime::lexicon::write_lexicon;
+use akshar_ime::persistence::save_to_disk;
+use std::fs::File;
+use std::io::{self, BufRead, BufReader};
+use std::path::{Path, PathBuf};
+use std::process::ExitCode;
+use std::time::Instant;
+
+const USAGE: &str = "usage: akshar_import <words.tsv|-> [--bigrams <bigrams.tsv>] [--output <dictionary.bin>] [--lexicon <lexicon.akl>] [--force]
+
+  words.tsv   roman<TAB>devanagari[<TAB>count] per line, '-' for stdin
+  --bigrams   previous devanagari<TAB>devanagari[<TAB>count] per line
+  --output    user dictionary to write (default: the engine's user dictionary)
+  --lexicon   also write the read-only mappable lexicon, e.g. for system installs
+  --force     replace an existing output file";
+
+struct Args {
+    words: String,
+    bigrams: Option<String>,
+    output: Option<PathBuf>,
+    lexicon: Option<PathBuf>,
+    force: bool,
+}
+
+fn parse_args() -> Result<Args, String> {
+    let mut args = std::env::args().skip(1);
+    let mut words = None;
+    let mut parsed = Args { words: String::new(), bigrams: None, output: None, lexicon: None, force: false };
+    while let Some(arg) = args.next() {
+        match arg.as_str() {
+            "--bigrams" => parsed.bigrams = Some(args.next().ok_or("--bigrams needs a file")?),
+            "--output" | "-o" => parsed.output = Some(args.next().ok_or("--output needs a file")?.into()),
+            "--lexicon" => parsed.lexicon = Some(args.next().ok_or("--lexicon needs a file")?.into()),
+            "--force" => parsed.force = true,
+            "--help" | "-h" => return Err(String::new()),
+            _ if words.is_none() => words = Some(arg),
+            _ => return Err(format!("unexpected argument '{}'", arg)),
+        }
+    }
+    parsed.words = words.ok_or("missing words file")?;
+    Ok(parsed)
+}
+
+fn open_input(path: &str) -> io::Result<Box<dyn BufRead>> {
+    if path == "-" {
+        return Ok(Box::new(BufReader::new(io::stdin())));
+    }
+    Ok(Box::new(BufReader::new(File::open(path)?)))
+}
+
+fn run(args: Args) -> Result<(), Box<dyn std::error::Error>> {
+    let output = match (&args.output, &args.lexicon) {
+        (Some(output), _) => Some(output.clone()),
+        (None, Some(_)) => None,
+        (None, None) => Some(akshar_ime::c_api::get_dictionary_path()),
+    };
+    for path in output.iter().chain(args.lexicon.iter()) {
+        if path.exists() && !args.force {
+            return Err(format!("{} exists; pass --force to replace it", path.display()).into());
+        }
+    }
+
+    let start = Instant::now();
+    let mut builder = DictionaryBuilder::new();
+    let skipped = builder.read_words(open_input(&args.words)?)?;
+    if skipped > 0 {
+        eprintln!("[Rust WARN] Skipped {} malformed lines in {}", skipped, args.words);
+    }
+    if let Some(bigrams) = &args.bigrams {
+        let skipped = builder.read_bigrams(open_input(bigrams)?)?;
+        if skipped > 0 {
+            eprintln!("[Rust WARN] Skipped {} malformed lines in {}", skipped, bigrams);
+        }
+    }
+    println!("read input in {:.2?}", start.elapsed());
+
+    let start = Instant::now();
+    let engine = builder.build();
+    println!(
+        "built {} words, {} n-grams in {:.2?}",
+        engine.trie.metadata_store.len(),
+        engine.context_model.ngram_count(),
+        start.elapsed()
+    );
+
+    let start = Instant::now();
+    if let Some(output) = &output {
+        if let Some(parent) = output.parent() {
+            std::fs::create_dir_all(parent)?;
+        }
+        save_to_disk(&engine, output)?;
+        println!("wrote {} in {:.2?}", output.display(), start.elapsed());
+    }
+    if let Some(lexicon) = &args.lexicon {
+        let start = Instant::now();
+        write_lexicon(&engine.trie, &engine.symspell, Path::new(lexicon))?;
+        println!("wrote {} in {:.2?}", lexicon.display(), start.elapsed());
+    }
+    Ok(())
+}
+
+fn main() -> ExitCode {
+    let args = match parse_args() {
+        Ok(args) => args,
+        Err(message) => {
+            if !message.is_empty() {
+                eprintln!("akshar_import: {}", message);
+            }
+            eprintln!("{}", USAGE);
+            return ExitCode::from(2);
+        }
+    };
+    match run(args) {
+        Ok(()) => ExitCode::SUCCESS,
+        Err(e) => {
+            eprintln!("akshar_import: {}", e);
+            ExitCode::FAILURE
+        }
+    }
+}
@@ -0,0 +1,351 @@
+// Keystroke-replay benchmark for the full suggestion pipeline: per-keystroke latency percentiles, allocations and throughput,
+// plus bulk transliteration throughput in MB/s
+// Run with: cargo run --release --bin replay_bench -- [--dictionary dictionary.bin] [--sessions sessions.txt] [--words N] [--stateless] [--bulk-mb N]
+// src/bin/replay_bench.rs
+use akshar_ime::bulk::transliterate_text_into;
+use akshar_ime::core::converter::RomanizationEngine;
+use akshar_ime::core::session::CompositionSession;
+use akshar_ime::import::DictionaryBuilder;
+use akshar_ime::persistence::load_from_disk;
+use akshar_ime::ImeEngine;
+use std::alloc::{GlobalAlloc, Layout, System};
+use std::path::PathBuf;
+use std::process::ExitCode;
+use std::sync::atomic::{AtomicU64, Ordering};
+use std::time::{Duration, Instant};
+
+const USAGE: &str = "usage: replay_bench [--dictionary <dictionary.bin>] [--sessions <sessions.txt>] [--words <N>] [--stateless] [--bulk-mb <N>]
+
+  --dictionary  replay against a saved user dictionary instead of synthetic ones
+  --sessions    recorded typing, one session per line of space-separated Roman
+                words; each word is typed key by key, then its top candidate
+                is confirmed (default: sessions sampled from the dictionary)
+  --words       words to replay when sampling sessions (default 5000)
+  --stateless   rank each prefix from scratch (get_ranked_suggestions) instead
+                of through a composition session like the IBus engine
+  --bulk-mb     size of the generated text bulk transliteration is timed on
+                (default 8; 0 skips it)";
+
+/// Synthetic dictionary sizes replayed when no dictionary is given.
+const DICTIONARY_SIZES: [usize; 3] = [10_000, 50_000, 200_000];
+const SYLLABLES: [&str; 24] = [
+    "ka", "kha", "ga", "cha", "ja", "ta", "da", "na", "pa", "ba", "ma", "ya",
+    "ra", "la", "wa", "sha", "sa", "ha", "ki", "ku", "ti", "ni", "ro", "me",
+];
+const CANDIDATES: usize = 8;
+/// Punctuation sprinkled between words of the bulk text, one mark per this many words.
+const BULK_PUNCTUATION: [&str; 4] = [", ", ". ", "? ", ".\n"];
+const BULK_WORDS_PER_MARK: u64 = 8;
+
+// --- Allocation counting ---
+// Every allocation in the process goes through this wrapper, so a measured
+// interval can report how many allocations and bytes it asked for.
+
+struct CountingAllocator;
+
+static ALLOCATIONS: AtomicU64 = AtomicU64::new(0);
+static ALLOCATED_BYTES: AtomicU64 = AtomicU64::new(0);
+
+unsafe impl GlobalAlloc for CountingAllocator {
+    unsafe fn alloc(&self, layout: Layout) -> *mut u8 {
+        ALLOCATIONS.fetch_add(1, Ordering::Relaxed);
+        ALLOCATED_BYTES.fetch_add(layout.size() as u64, Ordering::Relaxed);
+        System.alloc(layout)
+    }
+
+    unsafe fn dealloc(&self, ptr: *mut u8, layout: Layout) {
+        System.dealloc(ptr, layout)
+    }
+
+    unsafe fn realloc(&self, ptr: *mut u8, layout: Layout, new_size: usize) -> *mut u8 {
+        ALLOCATIONS.fetch_add(1, Ordering::Relaxed);
+        ALLOCATED_BYTES.fetch_add(new_size.saturating_sub(layout.size()) as u64, Ordering::Relaxed);
+        System.realloc(ptr, layout, new_size)
+    }
+}
+
+#[global_allocator]
+static GLOBAL: CountingAllocator = CountingAllocator;
+
+fn allocation_counters() -> (u64, u64) {
+    (ALLOCATIONS.load(Ordering::Relaxed), ALLOCATED_BYTES.load(Ordering::Relaxed))
+}
+
+/// Latencies and allocations of one kind of operation.
+#[derive(Default)]
+struct Samples {
+    latencies: Vec<Duration>,
+    allocations: u64,
+    bytes: u64,
+}
+
+impl Samples {
+    /// Times `op` and adds its latency and allocations.
+    fn measure<T>(&mut self, op: impl FnOnce() -> T) -> T {
+        let (allocations, bytes) = allocation_counters();
+        let start = Instant::now();
+        let result = std::hint::black_box(op());
+        let elapsed = start.elapsed();
+        let (allocations_after, bytes_after) = allocation_counters();
+        self.latencies.push(elapsed);
+        self.allocations += allocations_after - allocations;
+        self.bytes += bytes_after - bytes;
+        result
+    }
+
+    fn print(&mut self, name: &str) {
+        if self.latencies.is_empty() { return; }
+        self.latencies.sort_unstable();
+        let count = self.latencies.len();
+        let percentile = |q: f64| self.latencies[((count - 1) as f64 * q).round() as usize].as_secs_f64() * 1e6;
+        println!(
+            "{:<10} {:>8} {:>9.1} {:>9.1} {:>9.1} {:>9.1} {:>10.1} {:>10.0}",
+            name,
+            count,
+            percentile(0.50),
+            percentile(0.99),
+            percentile(0.999),
+            percentile(1.0),
+            self.allocations as f64 / count as f64,
+            self.bytes as f64 / count as f64,
+        );
+    }
+}
+
+/// Deterministic pseudo-random generator, so runs are comparable.
+struct Lcg(u64);
+
+impl Lcg {
+    fn next(&mut self) -> u64 {
+        self.0 = self.0.wrapping_mul(6364136223846793005).wrapping_add(1442695040888963407);
+        self.0 >> 33
+    }
+
+    /// Uniform in [0, 1).
+    fn next_f64(&mut self) -> f64 {
+        self.next() as f64 / (1u64 << 31) as f64
+    }
+}
+
+/// A dictionary of `words` romanized words with Zipf-like counts, built the
+/// way `akshar_import` seeds one. Returns the engine and the Roman keys by rank.
+fn synthetic_dictionary(words: usize) -> (ImeEngine, Vec<String>) {
+    let romanizer = RomanizationEngine::new();
+    let mut builder = DictionaryBuilder::new();
+    let mut rng = Lcg(42);
+    let mut keys = Vec::with_capacity(words);
+    for rank in 0..words {
+        let syllables = 1 + (rng.next() % 4) as usize;
+        let roman: String = (0..syllables).map(|_| SYLLABLES[(rng.next() % SYLLABLES.len() as u64) as usize]).collect();
+        let count = (1_000_000 / (rank as u64 + 1)).max(1);
+        builder.add_word(&roman, &romanizer.transliterate_primary(&roman), count);
+        keys.push(roman);
+    }
+    (builder.build(), keys)
+}
+
+/// Roman keys of a loaded dictionary, most frequent word first.
+fn dictionary_keys(engine: &ImeEngine) -> Vec<String> {
+    let mut words: Vec<_> = engine.trie.metadata_store.iter().filter(|word| word.variants().len() > 0).collect();
+    words.sort_unstable_by_key(|word| std::cmp::Reverse(word.frequency()));
+    words.into_iter().filter_map(|word| word.variants().min().map(str::to_string)).collect()
+}
+
+/// One session of `words` words drawn by rank with a log-uniform (Zipf-like)
+/// distribution, so common words recur as they do in real typing.
+fn sample_sessions(keys: &[String], words: usize) -> Vec<Vec<String>> {
+    if keys.is_empty() { return Vec::new(); }
+    let mut rng = Lcg(7);
+    let session = (0..words)
+        .map(|_| {
+            let rank = ((keys.len() as f64).powf(rng.next_f64()) - 1.0) as usize;
+            keys[rank.min(keys.len() - 1)].clone()
+        })
+        .collect();
+    vec![session]
+}
+
+/// Types every word of every session key by key, then confirms its top candidate.
+fn replay(engine: &mut ImeEngine, sessions: &[Vec<String>], stateless: bool) {
+    let mut keystrokes = Samples::default();
+    let mut commits = Samples::default();
+    let mut session = CompositionSession::new();
+    let mut prefix = String::new();
+    let start = Instant::now();
+
+    for words in sessions {
+        for word in words {
+            session.clear();
+            prefix.clear();
+            let mut top = None;
+            for c in word.chars() {
+                prefix.push(c);
+                let suggestions = keystrokes.measure(|| {
+                    if stateless {
+                        engine.get_ranked_suggestions(&prefix, CANDIDATES)
+                    } else {
+                        session.push_char(engine, c);
+                        engine.get_session_ranked_suggestions(&session, CANDIDATES)
+                    }
+                });
+                top = suggestions.into_iter().next();
+            }
+            if let Some(top) = top {
+                commits.measure(|| match stateless {
+                    true => engine.user_confirms(word, &top.devanagari),
+                    false => engine.user_confirms_in(&mut session, &top.devanagari),
+                });
+            }
+        }
+    }
+
+    let elapsed = start.elapsed();
+    let total = keystrokes.latencies.len() + commits.latencies.len();
+    println!(
+        "{:<10} {:>8} {:>9} {:>9} {:>9} {:>9} {:>10} {:>10}",
+        "op", "count", "p50 us", "p99 us", "p999 us", "max us", "allocs/op", "bytes/op"
+    );
+    keystrokes.print("keystroke");
+    commits.print("commit");
+    println!("throughput: {:.0} ops/s over {:.2?}", total as f64 / elapsed.as_secs_f64(), elapsed);
+}
+
+/// About `bytes` of running text: words sampled as `sample_sessions` samples
+/// them, separated by spaces and now and then by punctuation or a line break.
+fn bulk_text(keys: &[String], bytes: usize) -> String {
+    let mut text = String::with_capacity(bytes + 64);
+    if keys.is_empty() { return text; }
+    let mut rng = Lcg(11);
+    while text.len() < bytes {
+        let rank = ((keys.len() as f64).powf(rng.next_f64()) - 1.0) as usize;
+        text.push_str(&keys[rank.min(keys.len() - 1)]);
+        match rng.next() % BULK_WORDS_PER_MARK {
+            0 => text.push_str(BULK_PUNCTUATION[(rng.next() % BULK_PUNCTUATION.len() as u64) as usize]),
+            _ => text.push(' '),
+        }
+    }
+    text
+}
+
+/// Times bulk transliteration of `text` on one thread and on every core.
+fn bulk(engine: &ImeEngine, text: &str) {
+    let cores = std::thread::available_parallelism().map_or(1, |n| n.get());
+    let mut out = String::new();
+    let mut thread_counts = vec![1];
+    if cores > 1 {
+        thread_counts.push(cores);
+    }
+    for threads in thread_counts {
+        out.clear();
+        let start = Instant::now();
+        transliterate_text_into(engine, text, threads, &mut out);
+        let elapsed = start.elapsed();
+        println!(
+            "bulk:       {:.1} MB/s on {} thread(s), {:.1} MB in -> {:.1} MB out in {:.2?}",
+            text.len() as f64 / 1e6 / elapsed.as_secs_f64(),
+            threads,
+            text.len() as f64 / 1e6,
+            out.len() as f64 / 1e6,
+            elapsed
+        );
+    }
+}
+
+struct Args {
+    dictionary: Option<PathBuf>,
+    sessions: Option<PathBuf>,
+    words: usize,
+    stateless: bool,
+    bulk_mb: usize,
+}
+
+fn parse_args() -> Result<Args, String> {
+    let mut args = std::env::args().skip(1);
+    let mut parsed = Args { dictionary: None, sessions: None, words: 5_000, stateless: false, bulk_mb: 8 };
+    while let Some(arg) = args.next() {
+        match arg.as_str() {
+            "--dictionary" => parsed.dictionary = Some(args.next().ok_or("--dictionary needs a file")?.into()),
+            "--sessions" => parsed.sessions = Some(args.next().ok_or("--sessions needs a file")?.into()),
+            "--words" => {
+                let words = args.next().ok_or("--words needs a number")?;
+                parsed.words = words.parse().map_err(|_| format!("invalid word count '{}'", words))?;
+            }
+            "--stateless" => parsed.stateless = true,
+            "--bulk-mb" => {
+                let size = args.next().ok_or("--bulk-mb needs a number")?;
+                parsed.bulk_mb = size.parse().map_err(|_| format!("invalid size '{}'", size))?;
+            }
+            "--help" | "-h" => return Err(String::new()),
+            _ => return Err(format!("unexpected argument '{}'", arg)),
+        }
+    }
+    Ok(parsed)
+}
+
+fn run(args: Args) -> Result<(), Box<dyn std::error::Error>> {
+    let recorded: Option<Vec<Vec<String>>> = match &args.sessions {
+        Some(path) => Some(
+            std::fs::read_to_string(path)?
+                .lines()
+                .map(|line| line.split_whitespace().map(str::to_string).collect::<Vec<_>>())
+                .filter(|words| !words.is_empty())
+                .collect(),
+        ),
+        None => None,
+    };
+
+    // `None` stands for the dictionary given on the command line.
+    let sizes: Vec<Option<usize>> = match &args.dictionary {
+        Some(_) => vec![None],
+        None => DICTIONARY_SIZES.iter().copied().map(Some).collect(),
+    };
+    for size in sizes {
+        let start = Instant::now();
+        let (name, mut engine, keys) = match (size, &args.dictionary) {
+            (Some(words), _) => {
+                let (engine, keys) = synthetic_dictionary(words);
+                (format!("{} synthetic records", words), engine, keys)
+            }
+            (None, path) => {
+                let path = path.as_ref().ok_or("no dictionary")?;
+                let engine = load_from_disk(path)?;
+                let keys = dictionary_keys(&engine);
+                (path.display().to_string(), engine, keys)
+            }
+        };
+        println!("--- {}: {} words, loaded in {:.2?} ---", name, engine.trie.metadata_store.len(), start.elapsed());
+        let sampled;
+        let sessions = match &recorded {
+            Some(sessions) => sessions,
+            None => {
+                sampled = sample_sessions(&keys, args.words);
+                &sampled
+            }
+        };
+        replay(&mut engine, sessions, args.stateless);
+        if args.bulk_mb > 0 {
+            bulk(&engine, &bulk_text(&keys, args.bulk_mb * 1_000_000));
+        }
+    }
+    Ok(())
+}
+
+fn main() -> ExitCode {
+    let args = match parse_args() {
+        Ok(args) => args,
+        Err(message) => {
+            if !message.is_empty() {
+                eprintln!("replay_bench: {}", message);
+            }
+            eprintln!("{}", USAGE);
+            return ExitCode::from(2);
+        }
+    };
+    match run(args) {
+        Ok(()) => ExitCode::SUCCESS,
+        Err(e) => {
+            eprintln!("replay_bench: {}", e);
+            ExitCode::FAILURE
+        }
+    }
+}
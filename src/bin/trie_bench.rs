@@ -0,0 +1,78 @@
+// Benchmark for top-k prefix search: nodes expanded and time per query
+// Run with: cargo run --release --bin trie_bench
+// src/bin/trie_bench.rs
+use akshar_ime::core::trie::Trie;
+use std::time::Instant;
+
+const SYLLABLES: [&str; 24] = [
+    "ka", "kha", "ga", "cha", "ja", "ta", "da", "na", "pa", "ba", "ma", "ya",
+    "ra", "la", "wa", "sha", "sa", "ha", "ki", "ku", "ti", "ni", "ro", "me",
+];
+const PREFIXES: [&str; 6] = ["k", "ka", "kam", "s", "sha", "ra"];
+const K: usize = 8;
+const REPEATS: u32 = 200;
+
+/// Deterministic pseudo-random generator, so runs are comparable.
+struct Lcg(u64);
+
+impl Lcg {
+    fn next(&mut self) -> u64 {
+        self.0 = self.0.wrapping_mul(6364136223846793005).wrapping_add(1442695040888963407);
+        self.0 >> 33
+    }
+}
+
+/// A dictionary of `words` romanized words with Zipf-like frequencies.
+fn build_trie(words: usize) -> Trie {
+    let mut trie = Trie::new();
+    let mut rng = Lcg(42);
+    for rank in 0..words {
+        let syllables = 1 + (rng.next() % 4) as usize;
+        let roman: String = (0..syllables).map(|_| SYLLABLES[(rng.next() % SYLLABLES.len() as u64) as usize]).collect();
+        let word_id = trie.get_or_create_metadata(&format!("{}#{}", roman, rank));
+        let frequency = (1_000_000 / (rank as u64 + 1)).max(1);
+        *trie.metadata_store.frequency_mut(word_id) = frequency;
+        trie.insert(&roman, word_id);
+    }
+    trie
+}
+
+fn main() {
+    for words in [10_000, 100_000, 500_000] {
+        let trie = build_trie(words);
+        let frozen = trie.freeze();
+        println!("--- {} words, {} nodes, k = {} ---", words, frozen.node_count(), K);
+        println!("{:<8} {:>10} {:>12} {:>10} {:>12} {:>10}", "prefix", "subtree", "trie nodes", "trie us", "frozen nodes", "frozen us");
+        for prefix in PREFIXES {
+            let Some(frozen_node) = frozen.find_prefix(prefix) else { continue };
+            let trie_node = prefix.bytes().try_fold(Trie::ROOT, |node_idx, byte| trie.child(node_idx, byte));
+            let Some(trie_node) = trie_node else { continue };
+
+            // An exhaustive search expands every node of the subtree.
+            let (_, subtree) = frozen.top_k_with_visits(frozen_node, usize::MAX);
+            let (_, trie_visits) = trie.top_k_with_visits(trie_node, K);
+            let (_, frozen_visits) = frozen.top_k_with_visits(frozen_node, K);
+
+            let start = Instant::now();
+            for _ in 0..REPEATS {
+                std::hint::black_box(trie.get_top_k_from_node(trie_node, K));
+            }
+            let trie_time = start.elapsed() / REPEATS;
+            let start = Instant::now();
+            for _ in 0..REPEATS {
+                std::hint::black_box(frozen.get_top_k_from_node(frozen_node, K));
+            }
+            let frozen_time = start.elapsed() / REPEATS;
+
+            println!(
+                "{:<8} {:>10} {:>12} {:>10.2} {:>12} {:>10.2}",
+                prefix,
+                subtree,
+                trie_visits,
+                trie_time.as_secs_f64() * 1e6,
+                frozen_visits,
+                frozen_time.as_secs_f64() * 1e6,
+            );
+        }
+    }
+}
@@ -0,0 +1,124 @@
+// File: src/bulk.rs
+//
+// Bulk transliteration of whole documents. Text is tokenized into words (runs
+// of ASCII letters), symbols (ASCII digits and punctuation) and everything
+// else, which passes through unchanged. Each word becomes the dictionary's
+// best whole-word conversion after the words before it (see
+// `ImeEngine::transliterate_word`), each symbol its direct transliteration.
+//
+// Large inputs are split at line breaks, or failing that at whitespace, into
+// chunks converted on every core. Context restarts at every chunk, as it does
+// at every sentence, so splitting at line breaks changes nothing.
+use crate::core::context::ContextHistory;
+use crate::core::converter::transliterate_symbol;
+use crate::ImeEngine;
+
+/// Inputs shorter than this are converted on the calling thread.
+const PARALLEL_MIN_BYTES: usize = 64 * 1024;
+/// Smallest chunk handed to a thread of its own.
+const CHUNK_MIN_BYTES: usize = 32 * 1024;
+/// How far past a chunk's target end to look for a line break before settling
+/// for any whitespace.
+const LINE_SEARCH_BYTES: usize = 4 * 1024;
+
+/// Converts `text` on every available core.
+pub fn transliterate_text(engine: &ImeEngine, text: &str) -> String {
+    let mut out = String::new();
+    transliterate_text_into(engine, text, 0, &mut out);
+    out
+}
+
+/// Appends the conversion of `text` to `out`, on up to `threads` threads (0 for
+/// every core). The chunks are converted into buffers of their own and copied
+/// into `out` once, after reserving room for all of them.
+pub fn transliterate_text_into(engine: &ImeEngine, text: &str, threads: usize, out: &mut String) {
+    let chunks = transliterate_chunks(engine, text, threads);
+    out.reserve(chunks.iter().map(String::len).sum());
+    for chunk in &chunks {
+        out.push_str(chunk);
+    }
+}
+
+/// The conversion of `text`, chunk by chunk, in order.
+pub(crate) fn transliterate_chunks(engine: &ImeEngine, text: &str, threads: usize) -> Vec<String> {
+    let threads = match threads {
+        0 => std::thread::available_parallelism().map_or(1, |n| n.get()),
+        threads => threads,
+    };
+    let threads = threads.min(text.len() / CHUNK_MIN_BYTES).max(1);
+    if threads == 1 || text.len() < PARALLEL_MIN_BYTES {
+        return vec![transliterate_chunk(engine, text)];
+    }
+    let chunks = split_chunks(text, threads);
+    std::thread::scope(|scope| {
+        let handles: Vec<_> = chunks.iter().map(|&chunk| scope.spawn(move || transliterate_chunk(engine, chunk))).collect();
+        handles
+            .into_iter()
+            .map(|handle| handle.join().unwrap_or_else(|panic| std::panic::resume_unwind(panic)))
+            .collect()
+    })
+}
+
+/// Splits `text` into about `count` chunks of similar size, each ending just
+/// after a line break where one is near, and otherwise just after whitespace.
+fn split_chunks(text: &str, count: usize) -> Vec<&str> {
+    let bytes = text.as_bytes();
+    let target = text.len().div_ceil(count);
+    let mut chunks = Vec::with_capacity(count);
+    let mut start = 0;
+    while start < text.len() {
+        let from = start + target;
+        if from >= text.len() {
+            chunks.push(&text[start..]);
+            break;
+        }
+        let line_end = bytes[from..(from + LINE_SEARCH_BYTES).min(bytes.len())].iter().position(|&b| b == b'\n');
+        // ASCII bytes never occur inside a multi-byte character, so the byte
+        // after one is always a char boundary.
+        let end = line_end
+            .or_else(|| bytes[from..].iter().position(u8::is_ascii_whitespace))
+            .map_or(text.len(), |offset| from + offset + 1);
+        chunks.push(&text[start..end]);
+        start = end;
+    }
+    chunks
+}
+
+/// Converts one chunk in order, carrying the context from word to word.
+fn transliterate_chunk(engine: &ImeEngine, text: &str) -> String {
+    let bytes = text.as_bytes();
+    // Devanagari takes three bytes per character where Roman takes one or two.
+    let mut out = String::with_capacity(text.len() * 2);
+    let mut history = ContextHistory::new();
+    let mut i = 0;
+    while i < bytes.len() {
+        let b = bytes[i];
+        if b.is_ascii_alphabetic() {
+            let end = bytes[i..].iter().position(|b| !b.is_ascii_alphabetic()).map_or(bytes.len(), |len| i + len);
+            let word = engine.transliterate_word(&text[i..end], &history);
+            out.push_str(&word);
+            history.push(&word);
+            i = end;
+        } else if b.is_ascii() {
+            if ends_sentence(b) {
+                history.clear();
+            }
+            match transliterate_symbol(b as char) {
+                Some(symbol) => out.push_str(symbol),
+                None => out.push(b as char),
+            }
+            i += 1;
+        } else {
+            // Text that is not Roman, Devanagari included, is copied as it is.
+            let end = bytes[i..].iter().position(u8::is_ascii).map_or(bytes.len(), |len| i + len);
+            out.push_str(&text[i..end]);
+            history.clear();
+            i = end;
+        }
+    }
+    out
+}
+
+fn ends_sentence(b: u8) -> bool {
+    matches!(b, b'.' | b'?' | b'!' | b'|' | b'\n')
+}
@@ -1,14 +1,37 @@
 // File: src/c_api.rs
+use crate::bulk;
+use crate::core::converter::{transliterate_symbol, RomanizationScheme};
+use crate::core::engine::Suggestion;
+use crate::core::handle::{EngineHandle, WeakEngineHandle};
+use crate::core::session::CompositionSession;
+use crate::core::stats::{self, Stage};
+use crate::core::worker::{JobStatus, SuggestionWorker};
 use crate::ImeEngine;
 use std::ffi::{CStr, CString};
 use libc::c_char;
 use std::path::PathBuf;
 use std::ptr;
 use std::panic::{catch_unwind, AssertUnwindSafe};
+use std::sync::atomic::{AtomicU64, Ordering};
+use std::sync::{Arc, Mutex, OnceLock};
 
-static mut IME_ENGINE: *mut ImeEngine = ptr::null_mut();
+/// Opaque C type behind the pointers returned by `akshar_ime_engine_new`.
+#[repr(C)]
+pub struct AksharEngine {
+    _private: [u8; 0],
+}
+
+/// Engine behind the legacy global entry points (`akshar_ime_engine_init` and
+/// the calls without an engine argument).
+static GLOBAL_ENGINE: Mutex<Option<EngineHandle>> = Mutex::new(None);
+
+/// The process's engine over the user dictionary, while anyone holds it. One
+/// engine per dictionary: two would interleave journal records and overwrite
+/// each other's snapshots.
+static PROCESS_ENGINE: Mutex<Option<WeakEngineHandle>> = Mutex::new(None);
 
-fn get_dictionary_path() -> PathBuf {
+/// The user dictionary every engine loads, and the default target of `akshar_import`.
+pub fn get_dictionary_path() -> PathBuf {
     // NOTE: Changed to use dirs::config_dir() for better cross-platform support
     let mut path = dirs::config_dir().expect("Could not find a valid config directory");
     path.push("akshar-devanagari");
@@ -16,50 +39,358 @@ fn get_dictionary_path() -> PathBuf {
     path
 }
 
+/// System-wide lexicon in the mappable format. Mapping it is O(1), and every
+/// engine process on the machine shares its pages.
+const SYSTEM_LEXICON_PATH: &str = "/usr/share/akshar-devanagari/lexicon.akl";
+
+/// Desktops with at least this many cores rank long inputs with parallel stages.
+const PARALLEL_STAGES_MIN_CORES: usize = 4;
+
+fn load_engine() -> ImeEngine {
+    let dict_path = get_dictionary_path();
+    if let Some(parent) = dict_path.parent() {
+        let _ = std::fs::create_dir_all(parent);
+    }
+    let mut engine = ImeEngine::from_file_or_new(dict_path.to_str().unwrap_or(""));
+    let cores = std::thread::available_parallelism().map_or(1, |n| n.get());
+    engine.set_parallel_stages(cores >= PARALLEL_STAGES_MIN_CORES);
+    let lexicon_path = std::path::Path::new(SYSTEM_LEXICON_PATH);
+    if lexicon_path.exists() {
+        if let Err(e) = engine.attach_lexicon(lexicon_path) {
+            eprintln!("[Rust WARN] Could not map lexicon {}: {}", SYSTEM_LEXICON_PATH, e);
+        }
+    }
+    engine
+}
+
+/// A reference to the process's engine, loading it if none is open.
+fn process_engine() -> EngineHandle {
+    let mut open = PROCESS_ENGINE.lock().unwrap_or_else(|e| e.into_inner());
+    if let Some(handle) = open.as_ref().and_then(WeakEngineHandle::upgrade) {
+        return handle;
+    }
+    let handle = EngineHandle::new(load_engine());
+    *open = Some(handle.downgrade());
+    handle
+}
+
+fn global_engine() -> Option<EngineHandle> {
+    GLOBAL_ENGINE.lock().unwrap_or_else(|e| e.into_inner()).clone()
+}
+
+/// Borrows the handle behind a C pointer without taking over its reference.
+unsafe fn engine_ref(engine: *const AksharEngine) -> Option<std::mem::ManuallyDrop<EngineHandle>> {
+    if engine.is_null() { return None; }
+    Some(std::mem::ManuallyDrop::new(EngineHandle::from_raw(engine as *const libc::c_void)))
+}
+
+// --- Engine handles ---
+// Handles are reference-counted and safe to use from any thread. Every input
+// context may hold one and query it concurrently.
+
+/// Returns a reference to the process's engine, loading it on first use. Every
+/// call shares the one engine, as does `akshar_ime_engine_init`.
+#[no_mangle]
+pub extern "C" fn akshar_ime_engine_new() -> *const AksharEngine {
+    match catch_unwind(process_engine) {
+        Ok(handle) => handle.into_raw() as *const AksharEngine,
+        Err(_) => {
+            eprintln!("[Rust FATAL] A panic occurred during IME engine initialization.");
+            ptr::null()
+        }
+    }
+}
+
+/// Returns a new reference to `engine`; release each with `akshar_ime_engine_unref`.
+#[no_mangle]
+pub extern "C" fn akshar_ime_engine_ref(engine: *const AksharEngine) -> *const AksharEngine {
+    if engine.is_null() { return ptr::null(); }
+    unsafe { EngineHandle::clone_raw(engine as *const libc::c_void).into_raw() as *const AksharEngine }
+}
+
+/// Drops a reference. The last one saves the dictionary.
+#[no_mangle]
+pub extern "C" fn akshar_ime_engine_unref(engine: *const AksharEngine) {
+    if engine.is_null() { return; }
+    let _ = catch_unwind(|| unsafe { drop(EngineHandle::from_raw(engine as *const libc::c_void)) });
+}
+
+#[no_mangle]
+pub extern "C" fn akshar_ime_engine_fill_candidates(
+    engine: *const AksharEngine,
+    prefix: *const c_char,
+    max_count: u32,
+    buf: *mut u8,
+    buf_len: usize,
+) -> i32 {
+    let roman_prefix = unsafe { CStr::from_ptr(prefix) }.to_str().unwrap_or("");
+    catch_unwind(AssertUnwindSafe(|| {
+        match unsafe { engine_ref(engine) } {
+            Some(engine) => {
+                let suggestions = engine.get_ranked_suggestions(roman_prefix, max_count as usize);
+                write_candidates(&suggestions, buf, buf_len)
+            }
+            None => 0,
+        }
+    }))
+    .unwrap_or(0)
+}
+
+#[no_mangle]
+pub extern "C" fn akshar_ime_engine_confirm_word(
+    engine: *const AksharEngine,
+    roman: *const c_char,
+    devanagari: *const c_char,
+) {
+    let roman_str = unsafe { CStr::from_ptr(roman) }.to_str().unwrap_or("");
+    let devanagari_str = unsafe { CStr::from_ptr(devanagari) }.to_str().unwrap_or("");
+    let _ = catch_unwind(AssertUnwindSafe(|| {
+        if let Some(engine) = unsafe { engine_ref(engine) } {
+            engine.confirm(roman_str, devanagari_str);
+        }
+    }));
+}
+
+/// Transliterates `text_len` bytes of UTF-8 text (see `bulk::transliterate_text`)
+/// into `buf`, NUL-terminated, on every core. Like `snprintf`, returns the
+/// length of the whole conversion; the output was written only if that is less
+/// than `buf_len`, so a caller can retry with a larger buffer. Returns -1 if
+/// `engine` or `text` is NULL or the text is not valid UTF-8.
+#[no_mangle]
+pub extern "C" fn akshar_ime_engine_transliterate_text(
+    engine: *const AksharEngine,
+    text: *const c_char,
+    text_len: usize,
+    buf: *mut c_char,
+    buf_len: usize,
+) -> i64 {
+    if text.is_null() { return -1; }
+    let bytes = unsafe { std::slice::from_raw_parts(text as *const u8, text_len) };
+    let Ok(text) = std::str::from_utf8(bytes) else { return -1 };
+    catch_unwind(AssertUnwindSafe(|| {
+        let Some(engine) = (unsafe { engine_ref(engine) }) else { return -1 };
+        let chunks = engine.read(|engine| bulk::transliterate_chunks(engine, text, 0));
+        let total: usize = chunks.iter().map(String::len).sum();
+        if !buf.is_null() && total < buf_len {
+            let out = unsafe { std::slice::from_raw_parts_mut(buf as *mut u8, buf_len) };
+            let mut offset = 0;
+            for chunk in &chunks {
+                out[offset..offset + chunk.len()].copy_from_slice(chunk.as_bytes());
+                offset += chunk.len();
+            }
+            out[offset] = 0;
+        }
+        total as i64
+    }))
+    .unwrap_or(-1)
+}
+
+// --- Legacy global engine ---
+
 #[no_mangle]
 pub extern "C" fn akshar_ime_engine_init() {
     let result = catch_unwind(|| {
-        unsafe {
-            if !IME_ENGINE.is_null() { return; }
-            let dict_path = get_dictionary_path();
-            if let Some(parent) = dict_path.parent() {
-                let _ = std::fs::create_dir_all(parent);
-            }
-            let engine = ImeEngine::from_file_or_new(dict_path.to_str().unwrap_or(""));
-            IME_ENGINE = Box::into_raw(Box::new(engine));
+        let mut global = GLOBAL_ENGINE.lock().unwrap_or_else(|e| e.into_inner());
+        if global.is_none() {
+            *global = Some(process_engine());
         }
     });
     if result.is_err() {
         eprintln!("[Rust FATAL] A panic occurred during IME engine initialization.");
-        unsafe { IME_ENGINE = ptr::null_mut(); }
     }
 }
 
 #[no_mangle]
 pub extern "C" fn akshar_ime_engine_destroy() {
-    unsafe {
-        if IME_ENGINE.is_null() { return; }
-        let engine = Box::from_raw(IME_ENGINE);
-        let _ = engine.save_dictionary();
-        IME_ENGINE = ptr::null_mut();
-    }
+    // The dictionary is saved once the last reference, including any held by
+    // open sessions, is dropped.
+    let handle = GLOBAL_ENGINE.lock().unwrap_or_else(|e| e.into_inner()).take();
+    let _ = catch_unwind(AssertUnwindSafe(|| drop(handle)));
 }
 
-unsafe fn get_engine_mut<'a>() -> Option<&'a mut ImeEngine> { IME_ENGINE.as_mut() }
-unsafe fn get_engine<'a>() -> Option<&'a ImeEngine> { IME_ENGINE.as_ref() }
-
-
 #[no_mangle]
 pub extern "C" fn akshar_ime_get_suggestions(prefix: *const c_char) -> *mut c_char {
     let c_str = unsafe { CStr::from_ptr(prefix) };
     let roman_prefix = c_str.to_str().unwrap_or("");
     let result = catch_unwind(AssertUnwindSafe(|| {
-        unsafe {
-            if let Some(engine) = get_engine() {
-                let suggestions = engine.get_suggestions(roman_prefix, 8);
-                let json_suggestions: Vec<String> = suggestions.into_iter().map(|(s, _)| s).collect();
-                return serde_json::to_string(&json_suggestions).unwrap_or_else(|_| "[]".to_string());
-            }
+        if let Some(engine) = global_engine() {
+            return suggestions_to_json(engine.get_ranked_suggestions(roman_prefix, 8));
+        }
+        "[]".to_string()
+    }));
+    let json_string = result.unwrap_or_else(|_| "[]".to_string());
+    CString::new(json_string).unwrap().into_raw()
+}
+
+fn suggestions_to_json(suggestions: Vec<Suggestion>) -> String {
+    let json_suggestions: Vec<String> = suggestions.into_iter().map(|s| s.devanagari).collect();
+    serde_json::to_string(&json_suggestions).unwrap_or_else(|_| "[]".to_string())
+}
+
+// --- Binary candidate buffers ---
+// The candidate API writes into a caller-owned buffer instead of returning JSON,
+// so a keystroke costs no encode/decode and no allocation across the FFI.
+// The buffer is a sequence of records, each an `AksharCandidate` header followed
+// by `len` bytes of UTF-8, a NUL terminator, and zero padding to the next 8-byte
+// boundary. The buffer itself must be 8-byte aligned.
+
+/// Header of one record in a candidate buffer.
+#[repr(C)]
+pub struct AksharCandidate {
+    pub score: u64,
+    /// Length of the UTF-8 text in bytes, excluding the NUL terminator.
+    pub len: u32,
+    /// A `SuggestionSource` discriminant.
+    pub source: u8,
+    pub reserved: [u8; 3],
+}
+
+const CANDIDATE_ALIGN: usize = std::mem::align_of::<AksharCandidate>();
+
+/// Writes as many whole records as fit and returns how many were written.
+fn write_candidates(suggestions: &[Suggestion], buf: *mut u8, buf_len: usize) -> i32 {
+    if buf.is_null() { return 0; }
+    let out = unsafe { std::slice::from_raw_parts_mut(buf, buf_len) };
+    let header_len = std::mem::size_of::<AksharCandidate>();
+    let mut offset = 0;
+    let mut written = 0;
+
+    for suggestion in suggestions {
+        let text = suggestion.devanagari.as_bytes();
+        let record_len = (header_len + text.len() + 1 + CANDIDATE_ALIGN - 1) & !(CANDIDATE_ALIGN - 1);
+        if offset + record_len > out.len() { break; }
+
+        let header = AksharCandidate {
+            score: suggestion.score,
+            len: text.len() as u32,
+            source: suggestion.source as u8,
+            reserved: [0; 3],
+        };
+        unsafe { ptr::write_unaligned(out[offset..].as_mut_ptr() as *mut AksharCandidate, header); }
+
+        let body = &mut out[offset + header_len..offset + record_len];
+        body[..text.len()].copy_from_slice(text);
+        body[text.len()..].fill(0);
+
+        offset += record_len;
+        written += 1;
+    }
+    written
+}
+
+#[no_mangle]
+pub extern "C" fn akshar_ime_fill_candidates(prefix: *const c_char, max_count: u32, buf: *mut u8, buf_len: usize) -> i32 {
+    let roman_prefix = unsafe { CStr::from_ptr(prefix) }.to_str().unwrap_or("");
+    catch_unwind(AssertUnwindSafe(|| {
+        if let Some(engine) = global_engine() {
+            let suggestions = engine.get_ranked_suggestions(roman_prefix, max_count as usize);
+            return write_candidates(&suggestions, buf, buf_len);
+        }
+        0
+    }))
+    .unwrap_or(0)
+}
+
+// --- Composition sessions ---
+// A session carries the trie cursor and FST state of the word being typed, so
+// each keystroke only costs the delta. It holds a reference to the engine it was
+// opened on. The C side owns the returned pointer and must release it with
+// `akshar_ime_session_close`.
+
+pub struct AksharSession {
+    engine: EngineHandle,
+    session: CompositionSession,
+    /// Generation of the latest asynchronous request; shared with queued jobs so
+    /// they can tell whether they have been superseded.
+    generation: Arc<AtomicU64>,
+}
+
+impl AksharSession {
+    fn new(engine: EngineHandle, scheme: RomanizationScheme) -> Self {
+        Self { engine, session: CompositionSession::with_scheme(scheme), generation: Arc::new(AtomicU64::new(0)) }
+    }
+
+    /// Key of this session's jobs on the suggestion worker.
+    fn worker_key(&self) -> u64 {
+        self as *const Self as usize as u64
+    }
+
+    /// Supersedes the session's outstanding asynchronous request, if any.
+    fn cancel_requests(&self) {
+        self.generation.fetch_add(1, Ordering::AcqRel);
+        if let Some(Some(worker)) = SUGGESTION_WORKER.get() {
+            worker.cancel(self.worker_key());
+        }
+    }
+}
+
+/// Opens a session on `engine`, or returns NULL if it is NULL.
+#[no_mangle]
+pub extern "C" fn akshar_ime_engine_session_open(engine: *const AksharEngine) -> *mut AksharSession {
+    match unsafe { engine_ref(engine) } {
+        Some(engine) => Box::into_raw(Box::new(AksharSession::new((*engine).clone(), RomanizationScheme::Standard))),
+        None => ptr::null_mut(),
+    }
+}
+
+/// Opens a session on the global engine, or returns NULL before `akshar_ime_engine_init`.
+#[no_mangle]
+pub extern "C" fn akshar_ime_session_open() -> *mut AksharSession {
+    akshar_ime_session_open_with_scheme(RomanizationScheme::Standard as u32)
+}
+
+/// Opens a session on the global engine that transliterates with the
+/// `RomanizationScheme` numbered `scheme`. Sessions of every scheme share the
+/// engine's dictionary, so one process can serve several layouts. Returns NULL
+/// before `akshar_ime_engine_init` or for an unknown scheme.
+#[no_mangle]
+pub extern "C" fn akshar_ime_session_open_with_scheme(scheme: u32) -> *mut AksharSession {
+    match (global_engine(), RomanizationScheme::from_u32(scheme)) {
+        (Some(engine), Some(scheme)) => Box::into_raw(Box::new(AksharSession::new(engine, scheme))),
+        _ => ptr::null_mut(),
+    }
+}
+
+/// Closes a session. Its queued request is cancelled and a request already
+/// being ranked is delivered as cancelled, so no callback sees a result after this.
+#[no_mangle]
+pub extern "C" fn akshar_ime_session_close(session: *mut AksharSession) {
+    if !session.is_null() {
+        let _ = catch_unwind(|| unsafe {
+            Box::from_raw(session).cancel_requests();
+        });
+    }
+}
+
+#[no_mangle]
+pub extern "C" fn akshar_ime_session_push_char(session: *mut AksharSession, codepoint: u32) {
+    let Some(c) = char::from_u32(codepoint) else { return; };
+    let _ = catch_unwind(AssertUnwindSafe(|| {
+        if let Some(s) = unsafe { session.as_mut() } {
+            s.engine.push_char(&mut s.session, c);
+        }
+    }));
+}
+
+#[no_mangle]
+pub extern "C" fn akshar_ime_session_pop_char(session: *mut AksharSession) {
+    let _ = catch_unwind(AssertUnwindSafe(|| {
+        if let Some(s) = unsafe { session.as_mut() } {
+            s.engine.pop_char(&mut s.session);
+        }
+    }));
+}
+
+#[no_mangle]
+pub extern "C" fn akshar_ime_session_clear(session: *mut AksharSession) {
+    if let Some(s) = unsafe { session.as_mut() } { s.session.clear(); }
+}
+
+#[no_mangle]
+pub extern "C" fn akshar_ime_session_get_suggestions(session: *const AksharSession) -> *mut c_char {
+    let result = catch_unwind(AssertUnwindSafe(|| {
+        if let Some(s) = unsafe { session.as_ref() } {
+            return suggestions_to_json(s.engine.get_session_ranked_suggestions(&s.session, 8));
         }
         "[]".to_string()
     }));
@@ -67,18 +398,254 @@ pub extern "C" fn akshar_ime_get_suggestions(prefix: *const c_char) -> *mut c_ch
     CString::new(json_string).unwrap().into_raw()
 }
 
+#[no_mangle]
+pub extern "C" fn akshar_ime_session_fill_candidates(
+    session: *const AksharSession,
+    max_count: u32,
+    buf: *mut u8,
+    buf_len: usize,
+) -> i32 {
+    catch_unwind(AssertUnwindSafe(|| {
+        if let Some(s) = unsafe { session.as_ref() } {
+            let suggestions = s.engine.get_session_ranked_suggestions(&s.session, max_count as usize);
+            return write_candidates(&suggestions, buf, buf_len);
+        }
+        0
+    }))
+    .unwrap_or(0)
+}
+
+/// Commits the session's word as its top candidate: confirms it, clears the
+/// session and cancels its outstanding request. The text is written to `buf`
+/// NUL-terminated. Pass the `max_count` the candidates are requested with:
+/// which stages contribute depends on the count, so ranking with the same one
+/// commits the top of the list the user would be shown and shares its cache
+/// entry. Returns the text length in bytes, 0 if there is no candidate, or -1
+/// (committing nothing) if `buf` is too small.
+#[no_mangle]
+pub extern "C" fn akshar_ime_session_commit_top(
+    session: *mut AksharSession,
+    max_count: u32,
+    buf: *mut c_char,
+    buf_len: usize,
+) -> i32 {
+    catch_unwind(AssertUnwindSafe(|| {
+        let Some(s) = (unsafe { session.as_mut() }) else { return 0; };
+        let count = (max_count as usize).max(1);
+        let Some(top) = s.engine.get_session_ranked_suggestions(&s.session, count).into_iter().next() else {
+            return 0;
+        };
+        let written = write_text(&top.devanagari, buf, buf_len);
+        if written > 0 {
+            s.engine.confirm_in(&mut s.session, &top.devanagari);
+            s.cancel_requests();
+        }
+        written
+    }))
+    .unwrap_or(0)
+}
+
+/// Confirms the session's word as `devanagari`, e.g. a candidate picked from
+/// the lookup table, in the session's context, and clears the session for the
+/// next word. Later suggestions from this session are reranked after it.
+#[no_mangle]
+pub extern "C" fn akshar_ime_session_confirm_word(session: *mut AksharSession, devanagari: *const c_char) {
+    if devanagari.is_null() { return; }
+    let devanagari_str = unsafe { CStr::from_ptr(devanagari) }.to_str().unwrap_or("");
+    let _ = catch_unwind(AssertUnwindSafe(|| {
+        if let Some(s) = unsafe { session.as_mut() } {
+            s.engine.confirm_in(&mut s.session, devanagari_str);
+            s.cancel_requests();
+        }
+    }));
+}
+
+/// Fills `buf` like `akshar_ime_session_fill_candidates` with up to
+/// `max_count` predicted next words after the word the session committed
+/// last, for showing before the next word is typed. Cheap enough to call on
+/// the main loop right after a commit. Returns the number of records written.
+#[no_mangle]
+pub extern "C" fn akshar_ime_session_fill_predictions(
+    session: *const AksharSession,
+    max_count: u32,
+    buf: *mut u8,
+    buf_len: usize,
+) -> i32 {
+    catch_unwind(AssertUnwindSafe(|| {
+        if let Some(s) = unsafe { session.as_ref() } {
+            let predictions = s.engine.get_session_predictions(&s.session, max_count as usize);
+            return write_candidates(&predictions, buf, buf_len);
+        }
+        0
+    }))
+    .unwrap_or(0)
+}
+
+/// Confirms a prediction picked from the lookup table while the session is
+/// empty, and records it as the session's last word.
+#[no_mangle]
+pub extern "C" fn akshar_ime_session_accept_prediction(session: *mut AksharSession, devanagari: *const c_char) {
+    if devanagari.is_null() { return; }
+    let devanagari_str = unsafe { CStr::from_ptr(devanagari) }.to_str().unwrap_or("");
+    let _ = catch_unwind(AssertUnwindSafe(|| {
+        if let Some(s) = unsafe { session.as_mut() } {
+            s.engine.accept_prediction_in(&mut s.session, devanagari_str);
+        }
+    }));
+}
+
+/// Writes the Devanagari form of a single-key symbol (digit or punctuation
+/// mark) to `buf`, NUL-terminated, without ranking anything. Works before
+/// `akshar_ime_engine_init`. Returns the length in bytes, 0 if the key is not
+/// a symbol, or -1 if `buf` is too small.
+#[no_mangle]
+pub extern "C" fn akshar_ime_transliterate_symbol(codepoint: u32, buf: *mut c_char, buf_len: usize) -> i32 {
+    match char::from_u32(codepoint).and_then(transliterate_symbol) {
+        Some(text) => write_text(text, buf, buf_len),
+        None => 0,
+    }
+}
+
+/// Copies `text` and a NUL terminator into `buf`; -1 if it does not fit.
+fn write_text(text: &str, buf: *mut c_char, buf_len: usize) -> i32 {
+    let bytes = text.as_bytes();
+    if buf.is_null() || bytes.len() >= buf_len { return -1; }
+    let out = unsafe { std::slice::from_raw_parts_mut(buf as *mut u8, buf_len) };
+    out[..bytes.len()].copy_from_slice(bytes);
+    out[bytes.len()] = 0;
+    bytes.len() as i32
+}
+
+// --- Asynchronous candidates ---
+// Ranking runs on a background worker so the caller (the IBus main loop) only
+// pays for the session update and can echo the preedit at once. Each request
+// is numbered; a newer request from the same session supersedes an older one
+// that has not been delivered yet.
+
+/// Receives the candidates of one request, on the worker thread. `buf` holds
+/// `count` `AksharCandidate` records and is only valid during the call. A
+/// negative `count` means the request was superseded or cancelled and `buf`
+/// is NULL. Every request gets exactly one call, so `user_data` can be freed here.
+pub type AksharCandidatesCallback =
+    extern "C" fn(user_data: *mut libc::c_void, generation: u64, buf: *const u8, buf_len: usize, count: i32);
+
+const CANDIDATES_CANCELLED: i32 = -1;
+
+/// Moves the C caller's `user_data` to the worker thread; the C side promises
+/// the callback can be called from any thread.
+struct UserData(*mut libc::c_void);
+unsafe impl Send for UserData {}
+
+/// Shared worker for every session in the process, started on first use. `None`
+/// if the thread could not be started, in which case requests run inline.
+static SUGGESTION_WORKER: OnceLock<Option<SuggestionWorker>> = OnceLock::new();
+
+fn suggestion_worker() -> Option<&'static SuggestionWorker> {
+    SUGGESTION_WORKER
+        .get_or_init(|| match SuggestionWorker::spawn() {
+            Ok(worker) => Some(worker),
+            Err(e) => {
+                eprintln!("[Rust WARN] Could not start suggestion worker: {}", e);
+                None
+            }
+        })
+        .as_ref()
+}
+
+/// Encodes suggestions the way `write_candidates` does, into a buffer sized to fit them all.
+fn encode_candidates(suggestions: &[Suggestion]) -> (Vec<u64>, i32) {
+    let header_len = std::mem::size_of::<AksharCandidate>();
+    let total_len: usize = suggestions
+        .iter()
+        .map(|s| (header_len + s.devanagari.len() + 1 + CANDIDATE_ALIGN - 1) & !(CANDIDATE_ALIGN - 1))
+        .sum();
+    // u64 words give the buffer `AksharCandidate`'s alignment.
+    let mut words = vec![0u64; total_len / std::mem::size_of::<u64>()];
+    let count = write_candidates(suggestions, words.as_mut_ptr() as *mut u8, total_len);
+    (words, count)
+}
+
+/// Requests up to `max_count` candidates for the session's current input and
+/// returns the request's generation at once. `callback` later receives them,
+/// from the worker thread, unless a newer request or `akshar_ime_session_close`
+/// supersedes this one first. Returns 0, without calling back, if `session` is NULL.
+#[no_mangle]
+pub extern "C" fn akshar_ime_session_request_candidates(
+    session: *const AksharSession,
+    max_count: u32,
+    callback: AksharCandidatesCallback,
+    user_data: *mut libc::c_void,
+) -> u64 {
+    let Some(s) = (unsafe { session.as_ref() }) else { return 0; };
+    let generation = s.generation.fetch_add(1, Ordering::AcqRel) + 1;
+    let latest = Arc::clone(&s.generation);
+    let engine = s.engine.clone();
+    let snapshot = s.session.clone();
+    let user_data = UserData(user_data);
+
+    let job = move |status: JobStatus| {
+        let user_data = user_data;
+        let is_current = || latest.load(Ordering::Acquire) == generation;
+        if status == JobStatus::Run && is_current() {
+            let ranked = catch_unwind(AssertUnwindSafe(|| {
+                encode_candidates(&engine.get_snapshot_ranked_suggestions(snapshot, max_count as usize))
+            }));
+            // Ranking may have outlived the request; only the latest one is delivered.
+            if let (Ok((words, count)), true) = (ranked, is_current()) {
+                let buf_len = words.len() * std::mem::size_of::<u64>();
+                callback(user_data.0, generation, words.as_ptr() as *const u8, buf_len, count);
+                return;
+            }
+        }
+        callback(user_data.0, generation, ptr::null(), 0, CANDIDATES_CANCELLED);
+    };
+
+    match suggestion_worker() {
+        Some(worker) => worker.submit(s.worker_key(), Box::new(job)),
+        None => job(JobStatus::Run),
+    }
+    generation
+}
+
+/// Confirms on the global engine. The word is queued and published in a batch,
+/// so this never waits for a concurrent suggestion query.
 #[no_mangle]
 pub extern "C" fn akshar_ime_confirm_word(roman: *const c_char, devanagari: *const c_char) {
     let roman_str = unsafe { CStr::from_ptr(roman) }.to_str().unwrap_or("");
     let devanagari_str = unsafe { CStr::from_ptr(devanagari) }.to_str().unwrap_or("");
     if !roman_str.is_empty() && !devanagari_str.is_empty() {
         let _ = catch_unwind(AssertUnwindSafe(|| {
-            unsafe { if let Some(engine) = get_engine_mut() { engine.user_confirms(roman_str, devanagari_str); } }
+            if let Some(engine) = global_engine() { engine.confirm(roman_str, devanagari_str); }
         }));
     }
 }
 
+// --- Latency statistics ---
+// Process-wide, so they cover every engine and session.
+
+/// Per-stage latency histograms as a JSON object keyed by stage name, each with
+/// `count`, `mean_us`, `p50_us`, `p99_us`, `p999_us` and `max_us`. Stages that
+/// have not run are left out; without the `stats` feature the object is empty.
+/// Release the string with `akshar_ime_free_string`.
+#[no_mangle]
+pub extern "C" fn akshar_ime_get_stats() -> *mut c_char {
+    let json = catch_unwind(stats::to_json).unwrap_or_else(|_| "{}".to_string());
+    CString::new(json).unwrap().into_raw()
+}
+
+#[no_mangle]
+pub extern "C" fn akshar_ime_reset_stats() {
+    stats::reset();
+}
+
+/// Records the time from a candidate request to its candidates being shown,
+/// which only the caller can measure.
+#[no_mangle]
+pub extern "C" fn akshar_ime_record_round_trip(nanos: u64) {
+    stats::record(Stage::RoundTrip, nanos);
+}
+
 #[no_mangle]
 pub extern "C" fn akshar_ime_free_string(s: *mut c_char) {
     if !s.is_null() { unsafe { let _ = CString::from_raw(s); } }
-}
\ No newline at end of file
+}
@@ -0,0 +1,197 @@
+// File: src/core/cache.rs
+// A bounded LRU cache of ranked suggestions. Typing, backspacing and retyping
+// revisit the same prefixes over and over, and the IBus engine asks for the
+// same prefix again when it commits, so most queries are repeats.
+
+use crate::core::context::ContextKey;
+use crate::core::converter::RomanizationScheme;
+use crate::core::engine::Suggestion;
+use std::collections::hash_map::DefaultHasher;
+use std::collections::HashMap;
+use std::hash::{Hash, Hasher};
+
+/// Default memory budget of the cache.
+pub const DEFAULT_CACHE_BYTES: usize = 256 * 1024;
+
+/// Bookkeeping charged per entry on top of its strings: the slot, its map entry
+/// and the vector header.
+const ENTRY_OVERHEAD: usize = 96;
+
+const NIL: usize = usize::MAX;
+
+/// Counters of a `SuggestionCache`, for tuning its budget.
+#[derive(Debug, Clone, Copy, Default, PartialEq, Eq)]
+pub struct CacheStats {
+    pub hits: u64,
+    pub misses: u64,
+    pub entries: usize,
+    pub bytes: usize,
+}
+
+struct Entry {
+    prefix: String,
+    context: ContextKey,
+    scheme: RomanizationScheme,
+    /// The count the suggestions were ranked for.
+    count: usize,
+    suggestions: Vec<Suggestion>,
+    bytes: usize,
+    /// Neighbours in recency order, or `NIL`.
+    newer: usize,
+    older: usize,
+}
+
+/// Ranked suggestions keyed on (prefix, preceding words, romanization scheme), evicted least recently
+/// used first once their estimated size exceeds the budget. A request for fewer
+/// candidates than an entry was ranked for is answered with the first ones of
+/// that list, which is the list the user was just shown.
+pub struct SuggestionCache {
+    /// Key hash -> slot. A colliding key simply replaces the entry.
+    index: HashMap<u64, usize>,
+    slots: Vec<Entry>,
+    free: Vec<usize>,
+    newest: usize,
+    oldest: usize,
+    bytes: usize,
+    capacity_bytes: usize,
+    hits: u64,
+    misses: u64,
+}
+
+impl SuggestionCache {
+    pub fn new(capacity_bytes: usize) -> Self {
+        Self {
+            index: HashMap::new(),
+            slots: Vec::new(),
+            free: Vec::new(),
+            newest: NIL,
+            oldest: NIL,
+            bytes: 0,
+            capacity_bytes,
+            hits: 0,
+            misses: 0,
+        }
+    }
+
+    pub fn get(&mut self, prefix: &str, context: ContextKey, scheme: RomanizationScheme, count: usize) -> Option<Vec<Suggestion>> {
+        let slot = self.index.get(&key_hash(prefix, context, scheme)).copied().filter(|&slot| {
+            let entry = &self.slots[slot];
+            entry.prefix == prefix && entry.context == context && entry.scheme == scheme && entry.count >= count
+        });
+        let Some(slot) = slot else {
+            self.misses += 1;
+            return None;
+        };
+        self.hits += 1;
+        self.unlink(slot);
+        self.push_newest(slot);
+        let suggestions = &self.slots[slot].suggestions;
+        Some(suggestions[..count.min(suggestions.len())].to_vec())
+    }
+
+    pub fn insert(&mut self, prefix: &str, context: ContextKey, scheme: RomanizationScheme, count: usize, suggestions: &[Suggestion]) {
+        let bytes = ENTRY_OVERHEAD
+            + prefix.len()
+            + suggestions.iter().map(|s| std::mem::size_of::<Suggestion>() + s.devanagari.len()).sum::<usize>();
+        if bytes > self.capacity_bytes { return; }
+
+        let hash = key_hash(prefix, context, scheme);
+        if let Some(slot) = self.index.remove(&hash) {
+            self.release(slot);
+        }
+        while self.bytes + bytes > self.capacity_bytes && self.oldest != NIL {
+            self.evict(self.oldest);
+        }
+
+        let entry = Entry {
+            prefix: prefix.to_string(),
+            context,
+            scheme,
+            count,
+            suggestions: suggestions.to_vec(),
+            bytes,
+            newer: NIL,
+            older: NIL,
+        };
+        let slot = match self.free.pop() {
+            Some(slot) => {
+                self.slots[slot] = entry;
+                slot
+            }
+            None => {
+                self.slots.push(entry);
+                self.slots.len() - 1
+            }
+        };
+        self.bytes += bytes;
+        self.index.insert(hash, slot);
+        self.push_newest(slot);
+    }
+
+    /// Drops every entry for which `stale(prefix, context, suggestions)` holds.
+    pub fn invalidate(&mut self, stale: impl Fn(&str, ContextKey, &[Suggestion]) -> bool) {
+        let mut slot = self.newest;
+        while slot != NIL {
+            let entry = &self.slots[slot];
+            let older = entry.older;
+            if stale(&entry.prefix, entry.context, &entry.suggestions) {
+                self.evict(slot);
+            }
+            slot = older;
+        }
+    }
+
+    pub fn clear(&mut self) {
+        *self = Self { hits: self.hits, misses: self.misses, ..Self::new(self.capacity_bytes) };
+    }
+
+    pub fn stats(&self) -> CacheStats {
+        CacheStats { hits: self.hits, misses: self.misses, entries: self.index.len(), bytes: self.bytes }
+    }
+
+    fn evict(&mut self, slot: usize) {
+        let entry = &self.slots[slot];
+        self.index.remove(&key_hash(&entry.prefix, entry.context, entry.scheme));
+        self.release(slot);
+    }
+
+    /// Unlinks a slot whose index entry is already gone and frees its memory.
+    fn release(&mut self, slot: usize) {
+        self.unlink(slot);
+        let entry = &mut self.slots[slot];
+        self.bytes -= entry.bytes;
+        entry.prefix = String::new();
+        entry.suggestions = Vec::new();
+        self.free.push(slot);
+    }
+
+    fn unlink(&mut self, slot: usize) {
+        let (newer, older) = (self.slots[slot].newer, self.slots[slot].older);
+        match newer {
+            NIL => self.newest = older,
+            newer => self.slots[newer].older = older,
+        }
+        match older {
+            NIL => self.oldest = newer,
+            older => self.slots[older].newer = newer,
+        }
+    }
+
+    fn push_newest(&mut self, slot: usize) {
+        self.slots[slot].newer = NIL;
+        self.slots[slot].older = self.newest;
+        match self.newest {
+            NIL => self.oldest = slot,
+            newest => self.slots[newest].newer = slot,
+        }
+        self.newest = slot;
+    }
+}
+
+fn key_hash(prefix: &str, context: ContextKey, scheme: RomanizationScheme) -> u64 {
+    let mut hasher = DefaultHasher::new();
+    prefix.hash(&mut hasher);
+    context.hash(&mut hasher);
+    scheme.hash(&mut hasher);
+    hasher.finish()
+}
@@ -0,0 +1,144 @@
+// File: src/core/compaction.rs
+// Frequency decay and dictionary compaction. Learned frequencies only ever
+// grow, and every word, variant and n-gram ever confirmed stays in the trie,
+// the fuzzy index and the context tables. Compaction periodically decays all
+// counts, evicts the words that decayed away, renumbers the survivors densely
+// and rebuilds the indexes from them, so memory, snapshot size and load time
+// stay bounded by recent use.
+//
+// A compaction is split so that its cost stays off the engine lock:
+// `ImeEngine::prepare_compaction` copies what it needs (cheap), `build` does
+// the work on any thread, and `ImeEngine::install_compaction` swaps the result
+// in and replays the confirmations made in between.
+use crate::core::context::ContextModel;
+use crate::core::metadata::MetadataStore;
+use crate::core::trie::Trie;
+use crate::core::types::WordId;
+use crate::fuzzy::symspell::SymSpell;
+
+/// When and how hard the user dictionary is compacted. Ages are counted in
+/// confirmations rather than wall time, so an idle dictionary does not decay.
+#[derive(Debug, Clone, Copy, PartialEq)]
+pub struct CompactionConfig {
+    /// Confirmations between compactions; 0 disables compaction.
+    pub interval: u64,
+    /// Confirmations after which a count has decayed to half; 0 disables decay.
+    pub half_life: u64,
+    /// Most learned words kept, the most frequent first; 0 for no limit.
+    pub max_words: usize,
+}
+
+impl Default for CompactionConfig {
+    fn default() -> Self {
+        Self { interval: 5_000, half_life: 50_000, max_words: 100_000 }
+    }
+}
+
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub struct CompactionSummary {
+    pub words_kept: usize,
+    pub words_evicted: usize,
+}
+
+/// Result of a compaction, ready to be installed.
+pub struct CompactedState {
+    pub(crate) trie: Trie,
+    pub(crate) symspell: SymSpell,
+    pub(crate) context_model: ContextModel,
+    pub(crate) summary: CompactionSummary,
+}
+
+/// What a compaction reads, copied out of the engine.
+pub struct CompactionInput {
+    pub(crate) metadata_store: MetadataStore,
+    /// (Roman key, WordId) of every word the trie leads to.
+    pub(crate) keys: Vec<(String, WordId)>,
+    pub(crate) context_model: ContextModel,
+    pub(crate) max_edit_distance: usize,
+    pub(crate) config: CompactionConfig,
+    /// Confirmations since the previous compaction, the age the counts decay by.
+    pub(crate) elapsed: u64,
+    /// Seeds the rounding of decayed counts, so a run can be reproduced.
+    pub(crate) seed: u64,
+}
+
+impl CompactionInput {
+    /// Decays, evicts and renumbers, then rebuilds the trie, the fuzzy index and
+    /// the context tables. O(n log n) in the number of words and n-grams.
+    pub fn build(self) -> CompactedState {
+        let factor = decay_factor(self.elapsed, self.config.half_life);
+        let word_count = self.metadata_store.len();
+
+        // --- Stage 1: Decay and choose survivors ---
+        let frequencies: Vec<u64> = self
+            .metadata_store
+            .frequencies()
+            .iter()
+            .enumerate()
+            .map(|(word_id, &frequency)| decay_count(frequency, factor, self.seed ^ word_id as u64))
+            .collect();
+        let limit = match self.config.max_words {
+            0 => usize::MAX,
+            max_words => max_words,
+        };
+        let mut survivors: Vec<WordId> = (0..word_count).filter(|&id| frequencies[id] > 0).collect();
+        if survivors.len() > limit {
+            survivors.select_nth_unstable_by_key(limit - 1, |&id| (std::cmp::Reverse(frequencies[id]), id));
+            survivors.truncate(limit);
+            survivors.sort_unstable();
+        }
+
+        // --- Stage 2: Renumber, keeping the survivors in their old order ---
+        let mut remap: Vec<Option<WordId>> = vec![None; word_count];
+        for (new_id, &old_id) in survivors.iter().enumerate() {
+            remap[old_id] = Some(new_id);
+        }
+        let mut metadata_store = MetadataStore::new();
+        for &old_id in &survivors {
+            let word = self.metadata_store.get(old_id).expect("survivors are word ids");
+            let new_id = metadata_store.push(word.devanagari(), frequencies[old_id]);
+            for variant in word.variants() {
+                metadata_store.add_variant(new_id, variant);
+            }
+        }
+
+        // --- Stage 3: Rebuild ---
+        // A Roman key keeps leading to its current word if that word survives.
+        let mut keys: Vec<(String, WordId)> = self
+            .keys
+            .into_iter()
+            .filter_map(|(key, old_id)| Some((key, remap[old_id]?)))
+            .collect();
+        keys.sort_unstable();
+        let trie = Trie::from_words(metadata_store, &keys);
+        let symspell = SymSpell::from_trie(&trie, self.max_edit_distance);
+        let context_model = self.context_model.compacted(|old_id| remap.get(old_id).copied().flatten(), factor, self.seed);
+
+        let summary = CompactionSummary { words_kept: survivors.len(), words_evicted: word_count - survivors.len() };
+        CompactedState { trie, symspell, context_model, summary }
+    }
+}
+
+/// Multiplier that ages a count by `elapsed` confirmations.
+fn decay_factor(elapsed: u64, half_life: u64) -> f64 {
+    if half_life == 0 { return 1.0; }
+    0.5f64.powf(elapsed as f64 / half_life as f64)
+}
+
+/// `count * factor`, rounded up or down at random in proportion to the
+/// fraction, so that small counts decay at the configured rate on average
+/// instead of sticking (rounding to nearest) or dying at once (flooring).
+pub(crate) fn decay_count(count: u64, factor: f64, seed: u64) -> u64 {
+    if factor >= 1.0 { return count; }
+    let scaled = count as f64 * factor;
+    let whole = scaled.floor();
+    let threshold = ((scaled - whole) * (1u64 << 53) as f64) as u64;
+    whole as u64 + ((mix(seed) >> 11) < threshold) as u64
+}
+
+/// SplitMix64 finalizer: a well-spread hash of `x`.
+fn mix(mut x: u64) -> u64 {
+    x = (x ^ (x >> 30)).wrapping_mul(0xbf58_476d_1ce4_e5b9);
+    x = (x ^ (x >> 27)).wrapping_mul(0x94d0_49bb_1331_11eb);
+    x ^ (x >> 31)
+}
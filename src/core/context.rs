@@ -1,14 +1,291 @@
 // File: src/core/context.rs
+use crate::core::compaction::decay_count;
+use crate::core::trie::Trie;
 use crate::core::types::WordId;
 use serde::{Deserialize, Serialize};
 use std::collections::{HashMap, VecDeque};
+use std::hash::Hash;
 
+/// Weight of a stupid-backoff step from trigram to bigram evidence.
+const BACKOFF_WEIGHT: f64 = 0.4;
+
+/// Score points per bit of context evidence at probability 1. A word that always
+/// followed a context seen once gains 10 points, seen 3 times 20, 7 times 30.
+const BOOST_SCALE: f64 = 10.0;
+
+/// Increments buffered before they are merged into the sorted arrays.
+const MERGE_THRESHOLD: usize = 1024;
+
+/// Entries a table may hold before its rarest n-grams are pruned. At 8-14 bytes
+/// an entry this bounds each table to about 2 MB.
+const MAX_NGRAMS: usize = 1 << 17;
+
+/// Counts are stored in 16 bits. When one would pass this, every count of the
+/// model is halved, which also ages out n-grams that were only seen once.
+const MAX_COUNT: u32 = u16::MAX as u32;
+
+/// The words a prediction conditions on: (word before the previous, previous).
+pub type ContextKey = (Option<WordId>, Option<WordId>);
+
+/// Most likely next words kept per word, enough to fill a lookup table.
+pub const SUCCESSORS: usize = 8;
+
+/// Words a `ContextHistory` keeps: as many as a `ContextKey` holds.
+const HISTORY_WORDS: usize = 2;
+
+/// The words confirmed last in one input context, such as one window, so that
+/// typing elsewhere does not change its predictions. Words are kept by their
+/// Devanagari form: a history outlives compactions, which renumber words.
+#[derive(Debug, Clone, Default, PartialEq, Eq)]
+pub struct ContextHistory {
+    words: VecDeque<String>,
+}
+
+impl ContextHistory {
+    pub fn new() -> Self {
+        Self::default()
+    }
+
+    pub fn push(&mut self, devanagari: &str) {
+        if self.words.len() == HISTORY_WORDS {
+            self.words.pop_front();
+        }
+        self.words.push_back(devanagari.to_string());
+    }
+
+    pub fn clear(&mut self) {
+        self.words.clear();
+    }
+
+    pub fn is_empty(&self) -> bool {
+        self.words.is_empty()
+    }
+
+    /// The remembered words, oldest first.
+    pub fn words(&self) -> impl Iterator<Item = &str> {
+        self.words.iter().map(String::as_str)
+    }
+}
+
+/// N-gram counts in two sorted parallel arrays, looked up by binary search, plus
+/// a small map of increments not merged yet. The arrays carry no per-entry
+/// allocation and can be written out or mapped as they are.
+#[derive(Debug, Clone, Serialize, Deserialize)]
+struct NgramTable<K: Ord + Hash> {
+    keys: Vec<K>,
+    counts: Vec<u16>,
+    pending: HashMap<K, u32>,
+}
+
+impl<K: Ord + Hash + Copy> NgramTable<K> {
+    fn new() -> Self {
+        Self { keys: Vec::new(), counts: Vec::new(), pending: HashMap::new() }
+    }
+
+    fn len(&self) -> usize {
+        self.keys.len() + self.pending.len()
+    }
+
+    fn get(&self, key: &K) -> u32 {
+        let stored = self.keys.binary_search(key).map_or(0, |i| self.counts[i] as u32);
+        stored + self.pending.get(key).copied().unwrap_or(0)
+    }
+
+    /// Adds one occurrence and returns the new count, and whether entries were
+    /// pruned. Pending increments are merged, and the table pruned if it is
+    /// full, once enough of them have built up.
+    fn increment(&mut self, key: K) -> (u32, bool) {
+        *self.pending.entry(key).or_insert(0) += 1;
+        let count = self.get(&key);
+        let mut pruned = false;
+        if self.pending.len() >= MERGE_THRESHOLD {
+            self.merge();
+            pruned = self.prune();
+        }
+        (count, pruned)
+    }
+
+    /// Appends entries in key order after all stored ones, dropping zero counts.
+    fn extend_sorted(&mut self, entries: impl IntoIterator<Item = (K, u64)>) {
+        for (key, count) in entries.into_iter().filter(|&(_, count)| count > 0) {
+            self.keys.push(key);
+            self.counts.push(count.min(MAX_COUNT as u64) as u16);
+        }
+    }
+
+    fn merge(&mut self) {
+        if self.pending.is_empty() { return; }
+        let mut pending: Vec<(K, u32)> = self.pending.drain().collect();
+        pending.sort_unstable_by(|a, b| a.0.cmp(&b.0));
+
+        let mut keys = Vec::with_capacity(self.keys.len() + pending.len());
+        let mut counts = Vec::with_capacity(keys.capacity());
+        let mut stored = self.keys.iter().copied().zip(self.counts.iter().map(|&c| c as u32)).peekable();
+        let mut pending = pending.into_iter().peekable();
+        loop {
+            let (key, count) = match (stored.peek(), pending.peek()) {
+                (Some(a), Some(b)) if a.0 == b.0 => {
+                    let (key, count) = stored.next().unwrap();
+                    (key, count + pending.next().unwrap().1)
+                }
+                (Some(a), Some(b)) if a.0 < b.0 => stored.next().unwrap(),
+                (Some(_), None) => stored.next().unwrap(),
+                (_, Some(_)) => pending.next().unwrap(),
+                (None, None) => break,
+            };
+            keys.push(key);
+            counts.push(count.min(MAX_COUNT) as u16);
+        }
+        self.keys = keys;
+        self.counts = counts;
+    }
+
+    /// Drops the rarest entries, raising the cutoff until a quarter of the
+    /// capacity is free again. Returns whether anything was dropped.
+    fn prune(&mut self) -> bool {
+        if self.keys.len() <= MAX_NGRAMS { return false; }
+        let target = MAX_NGRAMS / 4 * 3;
+        let mut floor = 1;
+        while self.keys.len() > target {
+            self.retain(|count| count > floor);
+            floor += 1;
+        }
+        true
+    }
+
+    /// Renumbers keys with `remap` and decays counts by `factor`, dropping the
+    /// entries whose key is gone or whose count decayed to zero.
+    fn compacted(mut self, remap: impl Fn(&K) -> Option<K>, factor: f64, seed: u64) -> Self {
+        self.merge();
+        let mut entries: Vec<(K, u64)> = self
+            .keys
+            .iter()
+            .zip(&self.counts)
+            .enumerate()
+            .filter_map(|(i, (key, &count))| {
+                let count = decay_count(count as u64, factor, seed.wrapping_add(i as u64));
+                Some((remap(key)?, count))
+            })
+            .collect();
+        entries.sort_unstable_by(|a, b| a.0.cmp(&b.0));
+        let mut table = Self::new();
+        table.extend_sorted(entries);
+        table
+    }
+
+    /// Every entry in key order. Only complete once pending increments are merged.
+    fn stored(&self) -> impl Iterator<Item = (K, u16)> + '_ {
+        self.keys.iter().copied().zip(self.counts.iter().copied())
+    }
+
+    fn halve(&mut self) {
+        self.merge();
+        self.counts.iter_mut().for_each(|count| *count /= 2);
+        self.retain(|count| count > 0);
+    }
+
+    fn retain(&mut self, keep: impl Fn(u16) -> bool) {
+        let mut kept = 0;
+        for i in 0..self.keys.len() {
+            if keep(self.counts[i]) {
+                self.keys[kept] = self.keys[i];
+                self.counts[kept] = self.counts[i];
+                kept += 1;
+            }
+        }
+        self.keys.truncate(kept);
+        self.counts.truncate(kept);
+    }
+}
+
+/// The `SUCCESSORS` words seen most often right after one word, most frequent
+/// first, with their bigram counts. Fixed-size, so a word's list costs no
+/// allocation of its own and reading it is a copy.
+#[derive(Debug, Clone, Copy, Default)]
+struct Successors {
+    len: u8,
+    words: [u32; SUCCESSORS],
+    counts: [u16; SUCCESSORS],
+}
+
+impl Successors {
+    /// Records that `word` now follows with `count`. Counts only grow between
+    /// rebuilds, so a word that is not listed can only enter by passing the
+    /// last one: O(SUCCESSORS).
+    fn update(&mut self, word: u32, count: u16) {
+        let len = self.len as usize;
+        let mut i = match self.words[..len].iter().position(|&w| w == word) {
+            Some(i) => i,
+            None if len < SUCCESSORS => {
+                self.len += 1;
+                len
+            }
+            None if count > self.counts[len - 1] => len - 1,
+            None => return,
+        };
+        self.words[i] = word;
+        self.counts[i] = count;
+        while i > 0 && self.counts[i - 1] < count {
+            self.words.swap(i - 1, i);
+            self.counts.swap(i - 1, i);
+            i -= 1;
+        }
+    }
+
+    fn iter(&self) -> impl Iterator<Item = (u32, u16)> + '_ {
+        let len = self.len as usize;
+        self.words[..len].iter().copied().zip(self.counts[..len].iter().copied())
+    }
+}
+
+/// A trigram model with stupid-backoff smoothing over the confirmed words.
+///
+/// The unigram term is left out: the trie already scores every candidate by its
+/// frequency, so the model only contributes what the preceding words add to it.
+///
+/// Next to the counts it keeps each word's most frequent successors, updated
+/// with every bigram count, so next-word predictions are read, not searched for.
 #[derive(Debug, Clone, Serialize, Deserialize)]
+#[serde(from = "StoredContextModel")]
 pub struct ContextModel {
     window_size: usize,
     history: VecDeque<WordId>,
-    /// Maps (prev_word_id, current_word_id) -> frequency
-    bigrams: HashMap<(WordId, WordId), u64>,
+    /// How often each word was followed by another: the bigram denominators.
+    contexts: NgramTable<u32>,
+    bigrams: NgramTable<(u32, u32)>,
+    trigrams: NgramTable<(u32, u32, u32)>,
+    /// Bumped whenever counts are halved or pruned, which can change any boost.
+    #[serde(skip)]
+    epoch: u64,
+    /// Derived from `bigrams`; rebuilt on load and whenever counts are rescaled.
+    #[serde(skip)]
+    successors: HashMap<u32, Successors>,
+}
+
+/// Snapshot layout of a `ContextModel`: everything but the derived state.
+#[derive(Deserialize)]
+struct StoredContextModel {
+    window_size: usize,
+    history: VecDeque<WordId>,
+    contexts: NgramTable<u32>,
+    bigrams: NgramTable<(u32, u32)>,
+    trigrams: NgramTable<(u32, u32, u32)>,
+}
+
+impl From<StoredContextModel> for ContextModel {
+    fn from(stored: StoredContextModel) -> Self {
+        let mut model = Self {
+            window_size: stored.window_size,
+            history: stored.history,
+            contexts: stored.contexts,
+            bigrams: stored.bigrams,
+            trigrams: stored.trigrams,
+            epoch: 0,
+            successors: HashMap::new(),
+        };
+        model.rebuild_successors();
+        model
+    }
 }
 
 impl ContextModel {
@@ -16,15 +293,109 @@ impl ContextModel {
         Self {
             window_size,
             history: VecDeque::with_capacity(window_size),
-            bigrams: HashMap::new(),
+            contexts: NgramTable::new(),
+            bigrams: NgramTable::new(),
+            trigrams: NgramTable::new(),
+            epoch: 0,
+            successors: HashMap::new(),
+        }
+    }
+
+    /// Builds a model from raw bigram counts, as kept by older snapshots or
+    /// gathered by a corpus import. Counts too large for 16 bits are scaled down
+    /// together, as repeated halving would, so their ratios survive.
+    pub(crate) fn from_bigrams(
+        window_size: usize,
+        history: VecDeque<WordId>,
+        bigrams: impl IntoIterator<Item = ((WordId, WordId), u64)>,
+    ) -> Self {
+        let mut counts: Vec<((u32, u32), u64)> = bigrams
+            .into_iter()
+            .filter_map(|((prev_word_id, word_id), count)| Some(((narrow(prev_word_id)?, narrow(word_id)?), count)))
+            .collect();
+        counts.sort_unstable_by_key(|&(key, _)| key);
+        counts.dedup_by(|next, kept| {
+            let same = next.0 == kept.0;
+            if same { kept.1 += next.1; }
+            same
+        });
+
+        // Sorted by previous word, so each context's bigrams are adjacent.
+        let mut contexts: Vec<(u32, u64)> = Vec::new();
+        for &((prev, _), count) in &counts {
+            match contexts.last_mut() {
+                Some((last, total)) if *last == prev => *total += count,
+                _ => contexts.push((prev, count)),
+            }
         }
+        let largest = contexts.iter().map(|&(_, total)| total).max().unwrap_or(0);
+        let divisor = largest.div_ceil(MAX_COUNT as u64).max(1);
+
+        let mut model = Self::new(window_size);
+        model.history = history;
+        model.contexts.extend_sorted(contexts.into_iter().map(|(key, count)| (key, count / divisor)));
+        model.bigrams.extend_sorted(counts.into_iter().map(|(key, count)| (key, count / divisor)));
+        model.contexts.prune();
+        model.bigrams.prune();
+        model.rebuild_successors();
+        model
+    }
+
+    /// The model with every count decayed by `factor` and every word renumbered
+    /// by `remap`, for compaction. N-grams of evicted words are dropped.
+    pub(crate) fn compacted(self, remap: impl Fn(WordId) -> Option<WordId>, factor: f64, seed: u64) -> Self {
+        let id = |key: u32| remap(key as WordId).and_then(narrow);
+        let mut model = Self {
+            window_size: self.window_size,
+            history: self.history.iter().filter_map(|&word_id| remap(word_id)).collect(),
+            contexts: self.contexts.compacted(|&prev| id(prev), factor, seed),
+            bigrams: self.bigrams.compacted(|&(prev, word)| Some((id(prev)?, id(word)?)), factor, seed ^ 1),
+            trigrams: self
+                .trigrams
+                .compacted(|&(older, prev, word)| Some((id(older)?, id(prev)?, id(word)?)), factor, seed ^ 2),
+            epoch: self.epoch + 1,
+            successors: HashMap::new(),
+        };
+        model.rebuild_successors();
+        model
     }
 
-    /// Adds a confirmed word to the context history and updates bigram counts.
-    /// O(1) amortized complexity.
+    pub fn window_size(&self) -> usize {
+        self.window_size
+    }
+
+    /// Adds a confirmed word to the context history and updates the n-gram
+    /// counts: O(log n), plus a merge of the sorted arrays once every
+    /// `MERGE_THRESHOLD` distinct new n-grams.
     pub fn add_word(&mut self, word_id: WordId) {
-        if let Some(&prev_word_id) = self.history.back() {
-            *self.bigrams.entry((prev_word_id, word_id)).or_insert(0) += 1;
+        self.add_word_after(self.context(), word_id);
+    }
+
+    /// `add_word` for a word confirmed after `context` in some input context.
+    /// The model's own history, which sessionless queries use, still takes the
+    /// word, since it follows whatever was confirmed last anywhere.
+    pub fn add_word_after(&mut self, context: ContextKey, word_id: WordId) {
+        let (older, previous) = context;
+        if let (Some(word), Some(prev)) = (narrow(word_id), previous.and_then(narrow)) {
+            let (context_count, contexts_pruned) = self.contexts.increment(prev);
+            let (bigram_count, bigrams_pruned) = self.bigrams.increment((prev, word));
+            let (trigram_count, trigrams_pruned) = match older.and_then(narrow) {
+                Some(older) => self.trigrams.increment((older, prev, word)),
+                None => (0, false),
+            };
+            let mut rescaled = contexts_pruned || bigrams_pruned || trigrams_pruned;
+            if context_count.max(bigram_count).max(trigram_count) >= MAX_COUNT {
+                self.contexts.halve();
+                self.bigrams.halve();
+                self.trigrams.halve();
+                rescaled = true;
+            }
+            if rescaled {
+                self.epoch += 1;
+                self.rebuild_successors();
+            } else {
+                self.successors.entry(prev).or_default().update(word, bigram_count.min(MAX_COUNT) as u16);
+            }
         }
 
         if self.history.len() == self.window_size {
@@ -33,20 +404,106 @@ impl ContextModel {
         self.history.push_back(word_id);
     }
 
-    /// Re-ranks a list of suggestions based on the current context.
-    /// Suggestions that form common bigrams with the previous word get a score boost.
-    pub fn rerank_suggestions(&self, suggestions: &mut Vec<(WordId, u64)>) {
-        if let Some(&prev_word_id) = self.history.back() {
-            for (word_id, score) in suggestions.iter_mut() {
-                if let Some(&bigram_count) = self.bigrams.get(&(prev_word_id, *word_id)) {
-                    // Simple boost: add a factor of the bigram count.
-                    // A more advanced model might use logarithms or smoothed probabilities.
-                    let boost = (bigram_count as f64).log2() * 10.0;
-                    *score += boost as u64;
-                }
+    /// The most recently confirmed word.
+    pub fn previous_word(&self) -> Option<WordId> {
+        self.history.back().copied()
+    }
+
+    /// The words the boost conditions on. Only these are part of a cache key.
+    pub fn context(&self) -> ContextKey {
+        let len = self.history.len();
+        let older = if self.window_size >= 3 && len >= 2 { self.history.get(len - 2).copied() } else { None };
+        (older, self.history.back().copied())
+    }
+
+    /// `context` for the words of `history`, looked up in `trie`. Words no
+    /// longer learned (evicted by compaction) give no context.
+    pub fn context_of(&self, history: &ContextHistory, trie: &Trie) -> ContextKey {
+        let words = &history.words;
+        let word_id = |i: usize| words.get(i).and_then(|word| trie.find_word_id_by_devanagari(word));
+        let len = words.len();
+        let older = if self.window_size >= 3 && len >= 2 { word_id(len - 2) } else { None };
+        (older, len.checked_sub(1).and_then(word_id))
+    }
+
+    /// The words seen most often right after `word_id`, most frequent first,
+    /// with their bigram counts. O(1): the list is kept up to date as words are
+    /// added, so this is what next-word predictions read.
+    pub fn successors(&self, word_id: WordId) -> impl Iterator<Item = (WordId, u64)> + '_ {
+        narrow(word_id)
+            .and_then(|prev| self.successors.get(&prev))
+            .into_iter()
+            .flat_map(|successors| successors.iter())
+            .map(|(word, count)| (word as WordId, count as u64))
+    }
+
+    /// Recomputes every successor list from the bigram counts, after they were
+    /// rescaled, pruned, renumbered or loaded. O(n log SUCCESSORS) in the bigrams.
+    fn rebuild_successors(&mut self) {
+        self.bigrams.merge();
+        self.successors.clear();
+        // Sorted by previous word, so each word's successors are adjacent.
+        let mut stored = self.bigrams.stored().peekable();
+        let mut group: Vec<(u16, u32)> = Vec::new();
+        while let Some(((prev, word), count)) = stored.next() {
+            group.push((count, word));
+            if stored.peek().is_some_and(|&((next, _), _)| next == prev) { continue; }
+            let take = group.len().min(SUCCESSORS);
+            if group.len() > take {
+                group.select_nth_unstable_by_key(take - 1, |&(count, word)| (std::cmp::Reverse(count), word));
+            }
+            group[..take].sort_unstable_by_key(|&(count, word)| (std::cmp::Reverse(count), word));
+            let list = self.successors.entry(prev).or_default();
+            for &(count, word) in &group[..take] {
+                list.update(word, count);
+            }
+            group.clear();
+        }
+    }
+
+    /// Changes whenever counts were rescaled or pruned after the last call.
+    pub fn epoch(&self) -> u64 {
+        self.epoch
+    }
+
+    /// Number of stored n-grams of every order, for monitoring memory use.
+    pub fn ngram_count(&self) -> usize {
+        self.contexts.len() + self.bigrams.len() + self.trigrams.len()
+    }
+
+    /// Score boost of `word_id` in the current context: the backed-off
+    /// probability of the word after its context, scaled by how much evidence
+    /// the context has. O(log n).
+    pub fn boost(&self, word_id: WordId) -> u64 {
+        self.boost_after(self.context(), word_id)
+    }
+
+    /// `boost` after an explicit context, such as one session's.
+    pub fn boost_after(&self, context: ContextKey, word_id: WordId) -> u64 {
+        let (older, previous) = context;
+        let (Some(word), Some(prev)) = (narrow(word_id), previous.and_then(narrow)) else { return 0 };
+
+        if let Some(older) = older.and_then(narrow) {
+            let trigram = self.trigrams.get(&(older, prev, word));
+            if trigram > 0 {
+                // Pruning may have dropped the bigram while keeping the trigram.
+                let context = self.bigrams.get(&(older, prev)).max(trigram);
+                return scaled(trigram as f64 / context as f64, context);
             }
-            // Re-sort the suggestions based on the new boosted scores
-            suggestions.sort_by_key(|&(_, score)| std::cmp::Reverse(score));
         }
+        let bigram = self.bigrams.get(&(prev, word));
+        if bigram == 0 { return 0; }
+        let context = self.contexts.get(&prev).max(bigram);
+        let weight = if older.is_some() { BACKOFF_WEIGHT } else { 1.0 };
+        scaled(weight * bigram as f64 / context as f64, context)
     }
-}
\ No newline at end of file
+}
+
+fn scaled(probability: f64, context_count: u32) -> u64 {
+    (probability * BOOST_SCALE * (1.0 + context_count as f64).log2()) as u64
+}
+
+/// N-grams key on 32-bit ids; a word beyond that range never gets a boost.
+fn narrow(word_id: WordId) -> Option<u32> {
+    u32::try_from(word_id).ok()
+}
@@ -1,5 +1,6 @@
 // File: src/core/converter.rs
-use std::collections::{HashMap, HashSet};
+use std::collections::HashMap;
+use std::sync::OnceLock;
 
 // =================================================================================
 // ARCHITECTURAL OVERHAUL: SYLLABLE-AWARE FINITE STATE TRANSDUCER (FST)
@@ -10,10 +11,11 @@ use std::collections::{HashMap, HashSet};
 // =================================================================================
 
 /// Represents the current state of the syllable being constructed by the FST.
-#[derive(Debug, PartialEq, Eq, Clone, Copy)]
+#[derive(Debug, PartialEq, Eq, Clone, Copy, Default)]
 enum State {
     /// At the beginning of a word, or after a vowel or symbol.
     /// Ready to start a new syllable.
+    #[default]
     Start,
     /// A consonant has been produced and is awaiting a vowel.
     /// The internal buffer currently ends with a virama (halanta).
@@ -23,31 +25,274 @@ enum State {
 }
 
 /// Result of matching a token, carrying the appropriate Devanagari representation(s).
-#[derive(Debug)]
+#[derive(Debug, Clone, Copy)]
 enum MatchResult<'a> {
     Symbol(&'a str),
     Consonant(&'a str),
     Vowel { full: &'a str, matra: &'a str },
 }
 
-/// Categorizes a matched Roman token to guide the FST's state transitions.
-#[derive(Debug, PartialEq, Eq)]
-enum MapKind {
-    Symbol,
-    Vowel,
-    Consonant,
+const HALANTA: &str = "\u{094d}";
+
+/// Punctuation, digits and special marks. Capital aliases cover caps-lock typing.
+const SYMBOLS: &[(&str, &str)] = &[
+    // Punctuation
+    (".", "।"),
+    ("..", "।।"),
+    ("...", "..."),
+    ("?", "?"),
+    ("!", "!"),
+    (",", ","),
+    (";", ";"),
+    (":", ":"),
+    // Special symbols
+    ("OM", "ॐ"),
+    ("Om", "ॐ"),
+    ("AUM", "ॐ"),
+    ("'", "ऽ"),
+    ("@", "ॐ"),
+    // Devanagari digits
+    ("0", "०"),
+    ("1", "१"),
+    ("2", "२"),
+    ("3", "३"),
+    ("4", "४"),
+    ("5", "५"),
+    ("6", "६"),
+    ("7", "७"),
+    ("8", "८"),
+    ("9", "९"),
+    // Additional marks
+    ("|", "।"),
+    ("||", "।।"),
+    ("_", "\u{094D}"), // Explicit virama
+    // New: Capital aliases for common punctuation/symbols (for caps-lock typing)
+    ("?", "?"),
+    ("!", "!"), // Already case-insensitive
+];
+
+/// Direct transliteration of a single-key symbol (a digit or punctuation mark),
+/// for committing it without running the suggestion pipeline. Returns `None`
+/// for keys that are not a symbol on their own.
+pub fn transliterate_symbol(c: char) -> Option<&'static str> {
+    static TABLE: OnceLock<[Option<&'static str>; 128]> = OnceLock::new();
+    let table = TABLE.get_or_init(|| {
+        let mut table = [None; 128];
+        for &(token, devan) in SYMBOLS {
+            if let [byte] = token.as_bytes() {
+                table[*byte as usize] = Some(devan);
+            }
+        }
+        table
+    });
+    table.get(c as usize).copied().flatten()
+}
+
+/// State 0 is the root and never a transition target, so it doubles as "none".
+const NO_STATE: u16 = 0;
+const NO_MATCH: u16 = u16::MAX;
+
+/// Every Roman token compiled into one byte-level trie with dense rows over
+/// ASCII (all tokens are ASCII). Finding the longest token at a position is a
+/// single forward scan: no hashing and no substring slicing.
+struct TokenAutomaton {
+    transitions: Vec<[u16; 128]>,
+    /// Per state, the index into `matches` of the token ending there, or `NO_MATCH`.
+    accepts: Vec<u16>,
+    matches: Vec<MatchResult<'static>>,
+}
+
+impl TokenAutomaton {
+    /// Compiles the tables. A token present in several tables keeps the
+    /// precedence of the old lookup order: symbol, then consonant, then vowel.
+    fn new(
+        consonants: &HashMap<&'static str, &'static str>,
+        vowels: &HashMap<&'static str, (&'static str, &'static str)>,
+        symbols: &HashMap<&'static str, &'static str>,
+    ) -> Self {
+        let mut automaton = Self {
+            transitions: vec![[NO_STATE; 128]],
+            accepts: vec![NO_MATCH],
+            matches: Vec::new(),
+        };
+        for (token, &(full, matra)) in vowels {
+            automaton.insert(token, MatchResult::Vowel { full, matra });
+        }
+        for (token, &devan) in consonants {
+            automaton.insert(token, MatchResult::Consonant(devan));
+        }
+        for (token, &devan) in symbols {
+            automaton.insert(token, MatchResult::Symbol(devan));
+        }
+        automaton
+    }
+
+    fn insert(&mut self, token: &str, result: MatchResult<'static>) {
+        let mut state = 0;
+        for &byte in token.as_bytes() {
+            assert!(byte.is_ascii(), "transliteration tokens must be ASCII");
+            let next = self.transitions[state][byte as usize];
+            state = if next == NO_STATE {
+                let new_state = self.transitions.len();
+                self.transitions.push([NO_STATE; 128]);
+                self.accepts.push(NO_MATCH);
+                self.transitions[state][byte as usize] = new_state as u16;
+                new_state
+            } else {
+                next as usize
+            };
+        }
+        if self.accepts[state] == NO_MATCH {
+            self.accepts[state] = self.matches.len() as u16;
+            self.matches.push(result);
+        } else {
+            self.matches[self.accepts[state] as usize] = result;
+        }
+    }
+
+    /// Every token that is a prefix of `input`, shortest first.
+    fn all_matches(&self, input: &[u8], out: &mut Vec<(usize, MatchResult<'static>)>) {
+        let mut state = 0;
+        for (i, &byte) in input.iter().enumerate() {
+            if !byte.is_ascii() {
+                break;
+            }
+            let next = self.transitions[state][byte as usize];
+            if next == NO_STATE {
+                break;
+            }
+            state = next as usize;
+            if self.accepts[state] != NO_MATCH {
+                out.push((i + 1, self.matches[self.accepts[state] as usize]));
+            }
+        }
+    }
+
+    /// The longest token at the start of `input`: its byte length and match.
+    fn longest_match(&self, input: &[u8]) -> Option<(usize, MatchResult<'static>)> {
+        let mut state = 0;
+        let mut best = None;
+        for (i, &byte) in input.iter().enumerate() {
+            if !byte.is_ascii() {
+                break;
+            }
+            let next = self.transitions[state][byte as usize];
+            if next == NO_STATE {
+                break;
+            }
+            state = next as usize;
+            if self.accepts[state] != NO_MATCH {
+                best = Some((i + 1, self.matches[self.accepts[state] as usize]));
+            }
+        }
+        best
+    }
+}
+
+/// A resumable snapshot of the FST, taken just before a token is consumed.
+/// A token may strip the halanta the output ended with, so that fact is kept
+/// alongside the length to rebuild the output exactly on rollback.
+#[derive(Debug, Clone, Copy)]
+struct Checkpoint {
+    input_pos: usize,
+    output_len: usize,
+    trailing_halanta: bool,
+    state: State,
+}
+
+/// Transliteration state for a composition that grows and shrinks one character
+/// at a time. The FST is resumed from the last checkpoint whose lookahead window
+/// could have been affected by the edit, so a keystroke costs O(max_token_len)
+/// instead of a rerun over the whole input.
+#[derive(Debug, Clone, Default)]
+pub struct IncrementalTransliteration {
+    input: String,
+    output: String,
+    checkpoints: Vec<Checkpoint>,
+    consumed: usize,
+    state: State,
+}
+
+impl IncrementalTransliteration {
+    pub fn new() -> Self {
+        Self::default()
+    }
+
+    /// The Roman input composed so far.
+    pub fn roman(&self) -> &str {
+        &self.input
+    }
+
+    /// The primary transliteration of the current input, with schwa deletion applied.
+    /// Equivalent to `RomanizationEngine::transliterate_primary(self.roman())`.
+    pub fn primary(&self) -> &str {
+        self.output.strip_suffix(HALANTA).unwrap_or(&self.output)
+    }
+
+    pub fn is_empty(&self) -> bool {
+        self.input.is_empty()
+    }
+
+    pub fn clear(&mut self) {
+        self.input.clear();
+        self.output.clear();
+        self.checkpoints.clear();
+        self.consumed = 0;
+        self.state = State::Start;
+    }
+}
+
+/// A variant of the romanization table, chosen per input method layout.
+/// The discriminants are part of the C API.
+#[derive(Debug, Clone, Copy, PartialEq, Eq, Hash, Default)]
+#[repr(u32)]
+pub enum RomanizationScheme {
+    /// The full table, nuqta consonants included.
+    #[default]
+    Standard = 0,
+    /// Nepali orthography, which has no nuqta: the keys that type a nuqta
+    /// consonant in the standard table type the plain consonant instead.
+    Nepali = 1,
+}
+
+impl RomanizationScheme {
+    pub const ALL: [RomanizationScheme; 2] = [RomanizationScheme::Standard, RomanizationScheme::Nepali];
+
+    pub fn from_u32(value: u32) -> Option<Self> {
+        Self::ALL.get(value as usize).copied()
+    }
+
+    /// Consonant tokens that map differently from the standard table.
+    fn consonant_overrides(self) -> &'static [(&'static str, &'static str)] {
+        match self {
+            RomanizationScheme::Standard => &[],
+            RomanizationScheme::Nepali => &[
+                ("q", "क"),
+                ("Q", "क"),
+                ("K", "ख"),
+                ("G", "ग"),
+                ("z", "ज"),
+                ("Z", "झ"),
+                ("Rh", "ढ"),
+                ("Rf", "ड"),
+                ("F", "फ"),
+            ],
+        }
+    }
 }
 
 pub struct RomanizationEngine {
-    consonants: HashMap<&'static str, &'static str>,
-    vowels: HashMap<&'static str, (&'static str, &'static str)>, // (Full Vowel, Matra)
-    symbols: HashMap<&'static str, &'static str>,
+    automaton: TokenAutomaton,
     max_token_len: usize,
 }
 
 impl RomanizationEngine {
     pub fn new() -> Self {
-        let consonants: HashMap<_, _> = [
+        Self::with_scheme(RomanizationScheme::Standard)
+    }
+
+    pub fn with_scheme(scheme: RomanizationScheme) -> Self {
+        let mut consonants: HashMap<_, _> = [
             // Standard consonants (prioritize common)
             ("k", "क"),
             ("kh", "ख"),
@@ -129,6 +374,7 @@ impl RomanizationEngine {
         .iter()
         .cloned()
         .collect();
+        consonants.extend(scheme.consonant_overrides().iter().copied());
 
         let vowels: HashMap<_, _> = [
             // Standard vowels
@@ -188,45 +434,7 @@ impl RomanizationEngine {
         .cloned()
         .collect();
 
-        // Symbols (unchanged, but added capital aliases where logical)
-        let symbols: HashMap<_, _> = [
-            // Punctuation
-            (".", "।"),
-            ("..", "।।"),
-            ("...", "..."),
-            ("?", "?"),
-            ("!", "!"),
-            (",", ","),
-            (";", ";"),
-            (":", ":"),
-            // Special symbols
-            ("OM", "ॐ"),
-            ("Om", "ॐ"),
-            ("AUM", "ॐ"),
-            ("'", "ऽ"),
-            ("@", "ॐ"),
-            // Devanagari digits
-            ("0", "०"),
-            ("1", "१"),
-            ("2", "२"),
-            ("3", "३"),
-            ("4", "४"),
-            ("5", "५"),
-            ("6", "६"),
-            ("7", "७"),
-            ("8", "८"),
-            ("9", "९"),
-            // Additional marks
-            ("|", "।"),
-            ("||", "।।"),
-            ("_", "\u{094D}"), // Explicit virama
-            // New: Capital aliases for common punctuation/symbols (for caps-lock typing)
-            ("?", "?"),
-            ("!", "!"), // Already case-insensitive
-        ]
-        .iter()
-        .cloned()
-        .collect();
+        let symbols: HashMap<_, _> = SYMBOLS.iter().cloned().collect();
 
         // max_token_len (recompute as before)
         let max_token_len = consonants
@@ -237,10 +445,10 @@ impl RomanizationEngine {
             .max()
             .unwrap_or(4);
 
+        let automaton = TokenAutomaton::new(&consonants, &vowels, &symbols);
+
         Self {
-            consonants,
-            vowels,
-            symbols,
+            automaton,
             max_token_len,
         }
     }
@@ -251,263 +459,451 @@ impl RomanizationEngine {
             return String::new();
         }
         // By default, apply schwa deletion at the end of words (e.g., "ram" -> "राम").
-        self.transliterate_base(roman, true)
+        let mut result = String::with_capacity(roman.len() * 3);
+        self.transliterate_into(roman, &mut result);
+        result
     }
 
-    /// Generates a list of likely candidates to handle phonetic ambiguity.
-    pub fn generate_candidates(&self, roman: &str) -> Vec<String> {
-        if roman.is_empty() {
-            return vec![];
+    /// Appends the primary transliteration of `roman` to `out`. Runs in time linear
+    /// in the input and allocates nothing once `out` has room for the result.
+    pub fn transliterate_into(&self, roman: &str, out: &mut String) {
+        let start = out.len();
+        let mut state = State::Start;
+        let mut input = roman;
+        while !input.is_empty() {
+            let (consumed, next_state) = self.step(input, state, out);
+            state = next_state;
+            input = &input[consumed..];
         }
-            if let Some(dev_symbol) = self.symbols.get(roman) {
-                return vec![dev_symbol.to_string()];
+        if out.len() > start && out.ends_with(HALANTA) {
+            out.truncate(out.len() - HALANTA.len());
         }
+    }
 
-        let primary = self.transliterate_primary(roman);
-        let mut candidates = HashSet::new();
-        candidates.insert(primary.clone());
-        // Heuristic: For ambiguous splits, generate combined rare form
-        let ambiguous_patterns = vec![
-            ("ny", "ञ"),
-            ("ri", "ऋ"),
-            ("rri", "ऋ"),
-            ("tt", "ट"),
-            ("dd", "ड"),
-            ("nn", "ण"),
-            ("na", "ण"),
-            ("ddh", "ढ"),
-            ("dh", "ढ"),
-            ("th", "ठ"), // Added more from common ambiguities
-            ("gy", "ज्ञ"),
-            ("tr", "त्र"),
-            ("sh", "श"),
-            ("ph", "फ"),
-            ("ch", "च"), // For split vs. combined
-        ];
-        for (pattern, combined) in ambiguous_patterns {
-            if roman.contains(pattern) {
-                let variant_roman = roman.replace(pattern, &format!("^{}", pattern));
-                let variant = self.transliterate_primary(
-                    &variant_roman.replace(&format!("^{}", pattern), pattern),
-                );
-                let variant = variant.replace(pattern, combined);
-                if variant != primary {
-                    candidates.insert(variant);
-                }
+    /// Generates a list of likely candidates to handle phonetic ambiguity, the
+    /// primary transliteration first.
+    pub fn generate_candidates(&self, roman: &str) -> Vec<String> {
+        self.generate_ranked_candidates(roman, MAX_LITERAL_CANDIDATES)
+            .into_iter()
+            .map(|(candidate, _)| candidate)
+            .collect()
+    }
+
+    /// Enumerates the `k` cheapest distinct outputs of the segmentation lattice for
+    /// `roman`, with their path costs. The lattice is built once: every ambiguous
+    /// split, alternate form, vowel promotion and final-halanta choice is an edge,
+    /// and a k-best pass over (position, FST state) nodes ranks all variants for
+    /// roughly the cost of one transliteration. Cost 0 is `transliterate_primary`.
+    pub fn generate_ranked_candidates(&self, roman: &str, k: usize) -> Vec<(String, u32)> {
+        if roman.is_empty() || k == 0 {
+            return vec![];
+        }
+        if let Some((len, MatchResult::Symbol(devan))) = self.automaton.longest_match(roman.as_bytes()) {
+            if len == roman.len() {
+                return vec![(devan.to_string(), 0)];
             }
         }
 
-        // Heuristic 1: Handle final 'a' ambiguity (e.g., "rama" -> "राम" vs "रामा").
-        // The primary transliteration assumes schwa deletion. This variant preserves the 'a'.
-        if roman.ends_with('a') && !roman.ends_with("aa") {
-            let variant = self.transliterate_base(roman, false);
-            if variant != primary {
-                candidates.insert(variant);
+        // Distinct paths can spell the same output, so keep some spare per node.
+        let beam = (k + 2).min(u8::MAX as usize);
+        let n = roman.len();
+        let mut lattice = Lattice::new((n + 1) * NODE_STATES, beam);
+        lattice.insert(node_state(State::Start, false), LatticeEntry {
+            cost: 0,
+            back: None,
+            emission: Emission::NONE,
+        });
+
+        let mut matches = Vec::new();
+        let mut alternates = Vec::new();
+        let mut edges = Vec::new();
+        let mut from_costs = Vec::new();
+        for pos in 0..n {
+            let base = pos * NODE_STATES;
+            if (base..base + NODE_STATES).all(|node| lattice.entries(node).is_empty()) {
+                continue;
             }
-        }
+            let input = &roman[pos..];
+            matches.clear();
+            self.automaton.all_matches(input.as_bytes(), &mut matches);
+            alternates.clear();
+            alternates.extend(ALTERNATE_FORMS.iter().filter(|(pattern, _)| input.starts_with(pattern)));
 
-        // MODIFICATION 3: Added a new, robust heuristic for medial vowel promotion.
-        // This handles cases like "lagyo" by creating a candidate from "laagyo" -> "लाग्यो".
-        let mut temp_input = roman;
-        let mut prefix = String::with_capacity(roman.len());
-        while !temp_input.is_empty() {
-            if let Some((token, _, kind)) = self.match_longest(temp_input) {
-                prefix.push_str(token);
-                if kind == MapKind::Consonant {
-                    let remaining = &temp_input[token.len()..];
-                    // Check for a consonant followed by a single 'a'
-                    if remaining.starts_with('a') && !remaining.starts_with("aa") {
-                        let mut promoted_roman = prefix.clone();
-                        promoted_roman.push('a'); // Promote 'a' to 'aa'
-                        promoted_roman.push_str(remaining);
-
-                        let variant = self.transliterate_primary(&promoted_roman);
-                        if variant != primary {
-                            candidates.insert(variant);
+            for node in 0..NODE_STATES {
+                let from = base + node;
+                if lattice.entries(from).is_empty() {
+                    continue;
+                }
+                let (state, trailing_halanta) = decode_node_state(node);
+                edges.clear();
+                lattice_edges(input, state, trailing_halanta, &matches, &alternates, &mut edges);
+
+                from_costs.clear();
+                from_costs.extend(lattice.entries(from).iter().map(|entry| entry.cost));
+                for edge in &edges {
+                    let next_halanta = edge.emission.trailing_halanta(trailing_halanta);
+                    let to = (pos + edge.len) * NODE_STATES + node_state(edge.next_state, next_halanta);
+                    for (rank, &cost) in from_costs.iter().enumerate() {
+                        let cost = cost + edge.cost;
+                        if cost > MAX_PATH_COST {
+                            break;
                         }
-                        // Only promote the first occurrence to avoid generating too many candidates
-                        break;
+                        let entry = LatticeEntry {
+                            cost,
+                            back: Some((from as u32, rank as u8)),
+                            emission: edge.emission,
+                        };
+                        lattice.insert(to, entry);
                     }
                 }
-                temp_input = &temp_input[token.len()..];
-            } else {
-                // Unmatchable character, advance by one to prevent infinite loop
-                prefix.push(temp_input.chars().next().unwrap());
-                temp_input = &temp_input[1..];
             }
         }
 
-        // Heuristic 2: Split final 'ai' as 'aa' + 'i' (e.g., "malai" -> "मलाइ")
-        if roman.ends_with("ai") && roman.len() > 2 {
-            let stem = &roman[..roman.len() - 2];
-            let stem_with_aa = format!("{}aa", stem);
-            let mut variant = self.transliterate_primary(&stem_with_aa);
-            if let Some((full_i, _)) = self.vowels.get("i") {
-                variant.push_str(full_i);
-                if variant != primary {
-                    candidates.insert(variant);
+        // Final edges: drop a trailing halanta (schwa deletion) or keep it.
+        let mut finals: Vec<(u32, usize, usize, bool)> = Vec::new();
+        for node in 0..NODE_STATES {
+            let at = n * NODE_STATES + node;
+            let (_, trailing_halanta) = decode_node_state(node);
+            for (rank, entry) in lattice.entries(at).iter().enumerate() {
+                finals.push((entry.cost, at, rank, trailing_halanta));
+                if trailing_halanta && entry.cost + KEEP_HALANTA_PENALTY <= MAX_PATH_COST {
+                    finals.push((entry.cost + KEEP_HALANTA_PENALTY, at, rank, false));
                 }
             }
         }
+        finals.sort_by_key(|&(cost, ..)| cost);
 
-        // Heuristic 3: Split final 'au' as 'aa' + 'u' (e.g., "aau" -> "आउ")
-        if roman.ends_with("au") && roman.len() > 2 {
-            let stem = &roman[..roman.len() - 2];
-            if !stem.is_empty() {
-                let stem_with_aa = format!("{}aa", stem);
-                let mut variant = self.transliterate_primary(&stem_with_aa);
-                if let Some((full_u, _)) = self.vowels.get("u") {
-                    variant.push_str(full_u);
-                    if variant != primary {
-                        candidates.insert(variant);
-                    }
-                }
+        let mut candidates: Vec<(String, u32)> = Vec::with_capacity(k);
+        let mut path = Vec::new();
+        for (cost, at, rank, strip_final) in finals {
+            path.clear();
+            let mut cursor = Some((at as u32, rank as u8));
+            while let Some((node, rank)) = cursor {
+                let entry = &lattice.entries(node as usize)[rank as usize];
+                path.push(entry.emission);
+                cursor = entry.back;
             }
-        }
-
-        // Heuristic 4: Special case for words starting with vowel sequences
-        if roman.starts_with("aa") && roman.len() > 2 {
-            let rest = &roman[2..];
-            if let Some((full_vowel, _)) = self.vowels.get(rest) {
-                if let Some((aa_full, _)) = self.vowels.get("aa") {
-                    let variant = format!("{}{}", aa_full, full_vowel);
-                    if variant != primary {
-                        candidates.insert(variant);
-                    }
+            let mut output = String::with_capacity(n * 3);
+            for emission in path.iter().rev() {
+                emission.apply(&mut output);
+            }
+            if strip_final {
+                output.truncate(output.len() - HALANTA.len());
+            }
+            if !candidates.iter().any(|(existing, _)| *existing == output) {
+                candidates.push((output, cost));
+                if candidates.len() == k {
+                    break;
                 }
             }
         }
+        candidates
+    }
 
-        // Heuristic 5: Try splitting at last vowel position
-        if let Some(last_vowel_pos) = self.find_last_vowel_boundary(roman) {
-            if last_vowel_pos > 0 && last_vowel_pos < roman.len() {
-                let (stem, vowel_part) = roman.split_at(last_vowel_pos);
-                if self.vowels.contains_key(vowel_part) {
-                    let stem_nepali = self.transliterate_primary(stem);
-                    if let Some((full_vowel, _)) = self.vowels.get(vowel_part) {
-                        let variant = format!("{}{}", stem_nepali, full_vowel);
-                        if variant != primary {
-                            candidates.insert(variant);
-                        }
-                    }
+    /// Appends one character to an incremental transliteration and resumes the FST.
+    pub fn push_char(&self, st: &mut IncrementalTransliteration, c: char) {
+        let changed_at = st.input.len();
+        st.input.push(c);
+        self.resume(st, changed_at);
+    }
+
+    /// Removes the last character of an incremental transliteration and resumes the FST.
+    pub fn pop_char(&self, st: &mut IncrementalTransliteration) -> Option<char> {
+        let c = st.input.pop()?;
+        let changed_at = st.input.len();
+        self.resume(st, changed_at);
+        Some(c)
+    }
+
+    /// Rewinds to the earliest token whose lookahead window reached `changed_at`
+    /// and re-runs the FST from there to the end of the input.
+    fn resume(&self, st: &mut IncrementalTransliteration, changed_at: usize) {
+        let keep = st
+            .checkpoints
+            .iter()
+            .position(|cp| cp.input_pos + self.max_token_len > changed_at)
+            .unwrap_or(st.checkpoints.len());
+
+        let (mut pos, mut state) = match st.checkpoints.get(keep) {
+            Some(cp) => {
+                if cp.trailing_halanta {
+                    st.output.truncate(cp.output_len - HALANTA.len());
+                    st.output.push_str(HALANTA);
+                } else {
+                    st.output.truncate(cp.output_len);
                 }
+                (cp.input_pos, cp.state)
             }
-        }
+            None => (st.consumed, st.state),
+        };
+        st.checkpoints.truncate(keep);
 
-        let mut result = vec![primary];
-        for cand in candidates {
-            if !result.contains(&cand) {
-                result.push(cand);
-            }
+        while pos < st.input.len() {
+            st.checkpoints.push(Checkpoint {
+                input_pos: pos,
+                output_len: st.output.len(),
+                trailing_halanta: st.output.ends_with(HALANTA),
+                state,
+            });
+            let (consumed, next_state) = self.step(&st.input[pos..], state, &mut st.output);
+            state = next_state;
+            pos += consumed;
         }
-        result
+        st.consumed = pos;
+        st.state = state;
     }
 
-    /// Helper to find the last position where a vowel sequence could be split
-    fn find_last_vowel_boundary(&self, roman: &str) -> Option<usize> {
-        for i in (1..roman.len()).rev() {
-            let potential_vowel = &roman[i..];
-            if self.vowels.contains_key(potential_vowel) {
-                return Some(i);
+    /// Consumes a single token from the front of `input`, appending its Devanagari
+    /// form to `result`. Returns the number of bytes consumed and the next FST state.
+    fn step(&self, input: &str, state: State, result: &mut String) -> (usize, State) {
+        let trailing_halanta = result.ends_with(HALANTA);
+        let (consumed, emission, next_state) = match self.automaton.longest_match(input.as_bytes()) {
+            Some((len, match_result)) => {
+                let (emission, next_state) = transition(state, trailing_halanta, &input[..len], match_result);
+                (len, emission, next_state)
+            }
+            None => {
+                let (emission, len) = passthrough(input, trailing_halanta);
+                (len, emission, State::Start)
             }
+        };
+        emission.apply(result);
+        (consumed, next_state)
+    }
+}
+
+/// How one token rewrites the output: optionally drop the trailing halanta, then
+/// append up to two pieces.
+#[derive(Debug, Clone, Copy)]
+struct Emission<'a> {
+    strip_halanta: bool,
+    pieces: [&'a str; 2],
+}
+
+impl<'a> Emission<'a> {
+    const NONE: Emission<'static> = Emission { strip_halanta: false, pieces: ["", ""] };
+
+    fn push(strip_halanta: bool, first: &'a str, second: &'a str) -> Self {
+        Self { strip_halanta, pieces: [first, second] }
+    }
+
+    fn apply(&self, out: &mut String) {
+        if self.strip_halanta {
+            out.truncate(out.len() - HALANTA.len());
+        }
+        for piece in self.pieces {
+            out.push_str(piece);
         }
-        None
     }
 
-    /// The core FST-based transliteration logic.
-    fn transliterate_base(&self, roman: &str, force_schwa_deletion: bool) -> String {
-        let mut result = String::with_capacity(roman.len() * 3);
-        let mut state = State::Start;
-        const HALANTA: &str = "\u{094d}";
-        let mut input = roman;
+    /// Whether the output ends with a halanta after this emission, given whether
+    /// it did before. A stripped halanta uncovers the consonant it followed.
+    fn trailing_halanta(&self, before: bool) -> bool {
+        match self.pieces.iter().rev().find(|piece| !piece.is_empty()) {
+            Some(piece) => piece.ends_with(HALANTA),
+            None => before && !self.strip_halanta,
+        }
+    }
+}
 
-        while !input.is_empty() {
-            let chunk = &input[..input.len().min(self.max_token_len)];
-
-            if let Some((token, match_result, _kind)) = self.match_longest(chunk) {
-                match state {
-                    State::Start | State::Syllable => match match_result {
-                            MatchResult::Consonant(devan) => {
-                                result.push_str(devan);
-                            result.push_str(HALANTA);
-                            state = State::Halanta;
-                        }
-                        MatchResult::Vowel { full, .. } => {
-                            result.push_str(full);
-                            state = State::Syllable;
-                        }
-                            MatchResult::Symbol(devan) => {
-                                result.push_str(devan);
-                            state = State::Start;
-                        }
-                    },
-                    State::Halanta => match match_result {
-                            MatchResult::Consonant(devan) => {
-                            // MODIFICATION 2: Add special grammatical rules for ya-phala and rakar.
-                            // When 'y' or 'r' follow a consonant, they form a special conjunct
-                            // without adding another halanta. This correctly forms 'ग्य' or 'प्र'.
-                            if token == "y" || token == "r" {
-                              result.push_str(devan); // e.g., 'ग्' + 'य' -> 'ग्य'
-                                                         // State remains Halanta, as the conjunct is still awaiting a vowel.
-                            } else {
-                                result.push_str(devan);
-                                result.push_str(HALANTA);
-                                // State remains Halanta, building a standard conjunct like 'क्त्'.
-                            }
-                        }
-                        MatchResult::Vowel { matra, .. } => {
-                            if result.ends_with(HALANTA) {
-                                result.truncate(result.len() - HALANTA.len());
-                            }
-                            if !matra.is_empty() {
-                                result.push_str(matra);
-                            }
-                            state = State::Syllable;
-                        }
-                            MatchResult::Symbol(devan) => {
-                                if result.ends_with(HALANTA) {
-                                    result.truncate(result.len() - HALANTA.len());
-                                }
-                                result.push_str(devan);
-                            state = State::Start;
-                        }
-                    },
-                }
-                input = &input[token.len()..];
-            } else {
-                if result.ends_with(HALANTA) {
-                    result.truncate(result.len() - HALANTA.len());
+/// The FST transition for a matched token. `trailing_halanta` is whether the
+/// output currently ends with a halanta, which vowels and symbols after a
+/// consonant remove.
+fn transition<'a>(
+    state: State,
+    trailing_halanta: bool,
+    token: &str,
+    match_result: MatchResult<'a>,
+) -> (Emission<'a>, State) {
+    match state {
+        State::Start | State::Syllable => match match_result {
+            MatchResult::Consonant(devan) => (Emission::push(false, devan, HALANTA), State::Halanta),
+            MatchResult::Vowel { full, .. } => (Emission::push(false, full, ""), State::Syllable),
+            MatchResult::Symbol(devan) => (Emission::push(false, devan, ""), State::Start),
+        },
+        State::Halanta => match match_result {
+            MatchResult::Consonant(devan) => {
+                // MODIFICATION 2: Add special grammatical rules for ya-phala and rakar.
+                // When 'y' or 'r' follow a consonant, they form a special conjunct
+                // without adding another halanta. This correctly forms 'ग्य' or 'प्र'.
+                // Either way the state remains Halanta, as the conjunct (or a
+                // standard one like 'क्त्') is still awaiting a vowel.
+                if token == "y" || token == "r" {
+                    (Emission::push(false, devan, ""), State::Halanta)
+                } else {
+                    (Emission::push(false, devan, HALANTA), State::Halanta)
                 }
-                let next_char = input.chars().next().unwrap();
-                result.push(next_char);
-                state = State::Start;
-                input = &input[next_char.len_utf8()..];
             }
-        }
+            MatchResult::Vowel { matra, .. } => (Emission::push(trailing_halanta, matra, ""), State::Syllable),
+            MatchResult::Symbol(devan) => (Emission::push(trailing_halanta, devan, ""), State::Start),
+        },
+    }
+}
 
-        if force_schwa_deletion && result.ends_with(HALANTA) {
-            result.truncate(result.len() - HALANTA.len());
-        }
+/// An unmatched character is copied through, closing any open conjunct.
+/// Returns the emission and the character's byte length.
+fn passthrough(input: &str, trailing_halanta: bool) -> (Emission<'_>, usize) {
+    let len = input.chars().next().map_or(1, char::len_utf8);
+    (Emission::push(trailing_halanta, &input[..len], ""), len)
+}
 
-        result
+// --- Candidate lattice ---
+
+/// Penalties for lattice edges that leave the deterministic FST path. Only the
+/// primary transliteration costs 0.
+const VOWEL_SPLIT_PENALTY: u32 = 2;
+const CONSONANT_SPLIT_PENALTY: u32 = 4;
+const ALTERNATE_FORM_PENALTY: u32 = 2;
+const VOWEL_PROMOTION_PENALTY: u32 = 2;
+const INDEPENDENT_VOWEL_PENALTY: u32 = 3;
+const KEEP_HALANTA_PENALTY: u32 = 4;
+/// Paths costing more than this are too far-fetched to offer.
+const MAX_PATH_COST: u32 = 6;
+pub const MAX_LITERAL_CANDIDATES: usize = 8;
+
+const LONG_A: MatchResult<'static> = MatchResult::Vowel { full: "आ", matra: "ा" };
+
+/// Combined letters a common Roman spelling may also mean (e.g. "sh" for ष as
+/// well as श). Each is an extra edge beside whatever the tables match.
+const ALTERNATE_FORMS: &[(&str, MatchResult<'static>)] = &[
+    ("ny", MatchResult::Consonant("ञ")),
+    ("ri", MatchResult::Vowel { full: "ऋ", matra: "ृ" }),
+    ("tt", MatchResult::Consonant("ट")),
+    ("tth", MatchResult::Consonant("ठ")),
+    ("th", MatchResult::Consonant("ठ")),
+    ("dd", MatchResult::Consonant("ड")),
+    ("ddh", MatchResult::Consonant("ढ")),
+    ("dh", MatchResult::Consonant("ढ")),
+    ("nn", MatchResult::Consonant("ण")),
+    ("gy", MatchResult::Consonant("ज्ञ")),
+    ("tr", MatchResult::Consonant("त्र")),
+    ("sh", MatchResult::Consonant("ष")),
+    ("ch", MatchResult::Consonant("छ")),
+];
+
+/// FST state crossed with whether the output ends with a halanta; together they
+/// determine every transition, so they are the lattice node at each position.
+const NODE_STATES: usize = 6;
+
+fn node_state(state: State, trailing_halanta: bool) -> usize {
+    let state = match state {
+        State::Start => 0,
+        State::Halanta => 1,
+        State::Syllable => 2,
+    };
+    state * 2 + usize::from(trailing_halanta)
+}
+
+fn decode_node_state(node: usize) -> (State, bool) {
+    let state = match node / 2 {
+        0 => State::Start,
+        1 => State::Halanta,
+        _ => State::Syllable,
+    };
+    (state, node % 2 == 1)
+}
+
+#[derive(Debug, Clone, Copy)]
+struct LatticeEdge<'a> {
+    len: usize,
+    cost: u32,
+    emission: Emission<'a>,
+    next_state: State,
+}
+
+/// One of the k best paths into a node: its cost, the (node, rank) it extends,
+/// and the emission of the edge taken.
+#[derive(Debug, Clone, Copy)]
+struct LatticeEntry<'a> {
+    cost: u32,
+    back: Option<(u32, u8)>,
+    emission: Emission<'a>,
+}
+
+/// The k best paths into every node, in one flat allocation of `beam` slots
+/// per node.
+struct Lattice<'a> {
+    slots: Vec<LatticeEntry<'a>>,
+    lens: Vec<u8>,
+    beam: usize,
+}
+
+impl<'a> Lattice<'a> {
+    fn new(nodes: usize, beam: usize) -> Self {
+        let empty = LatticeEntry { cost: 0, back: None, emission: Emission::NONE };
+        Self { slots: vec![empty; nodes * beam], lens: vec![0; nodes], beam }
     }
 
-    /// Implements Longest Prefix Match (LPM) and categorizes the match.
-    fn match_longest<'a>(&'a self, slice: &'a str) -> Option<(&'a str, MatchResult<'a>, MapKind)> {
-        for len in (1..=slice.len()).rev() {
-            let token = &slice[0..len];
+    /// The paths into `node`, cheapest first.
+    fn entries(&self, node: usize) -> &[LatticeEntry<'a>] {
+        &self.slots[node * self.beam..node * self.beam + self.lens[node] as usize]
+    }
 
-            if let Some(val) = self.symbols.get(token) {
-                return Some((token, MatchResult::Symbol(*val), MapKind::Symbol));
-            }
-            if let Some(val) = self.consonants.get(token) {
-                return Some((token, MatchResult::Consonant(*val), MapKind::Consonant));
-            }
-            if let Some((full, matra)) = self.vowels.get(token) {
-                return Some((token, MatchResult::Vowel { full, matra }, MapKind::Vowel));
+    /// Keeps the node's paths sorted by cost and drops the most expensive once
+    /// the beam is full. Equal costs keep insertion order, so the primary path
+    /// stays first.
+    fn insert(&mut self, node: usize, entry: LatticeEntry<'a>) {
+        let len = self.lens[node] as usize;
+        let slots = &mut self.slots[node * self.beam..(node + 1) * self.beam];
+        let at = slots[..len].partition_point(|existing| existing.cost <= entry.cost);
+        if at == self.beam {
+            return;
+        }
+        let new_len = (len + 1).min(self.beam);
+        slots.copy_within(at..new_len - 1, at + 1);
+        slots[at] = entry;
+        self.lens[node] = new_len as u8;
+    }
+}
+
+/// Every edge leaving the node (`state`, `trailing_halanta`) at the start of
+/// `input`. `matches` lists the table tokens at this position, shortest first,
+/// and `alternates` the alternate forms that apply here.
+fn lattice_edges<'a>(
+    input: &'a str,
+    state: State,
+    trailing_halanta: bool,
+    matches: &[(usize, MatchResult<'static>)],
+    alternates: &[&(&str, MatchResult<'static>)],
+    edges: &mut Vec<LatticeEdge<'a>>,
+) {
+    let Some(&(longest, _)) = matches.last() else {
+        let (emission, len) = passthrough(input, trailing_halanta);
+        edges.push(LatticeEdge { len, cost: 0, emission, next_state: State::Start });
+        return;
+    };
+
+    for &(len, match_result) in matches {
+        let token = &input[..len];
+        let cost = match (len == longest, match_result) {
+            (true, _) => 0,
+            (false, MatchResult::Vowel { .. }) => VOWEL_SPLIT_PENALTY,
+            (false, _) => CONSONANT_SPLIT_PENALTY,
+        };
+        let (emission, next_state) = transition(state, trailing_halanta, token, match_result);
+        edges.push(LatticeEdge { len, cost, emission, next_state });
+
+        if let (State::Halanta, MatchResult::Vowel { full, .. }) = (state, match_result) {
+            if token == "a" {
+                // Medial or final 'a' meant as 'aa' (e.g. "lagyo" -> "लाग्यो").
+                let (emission, next_state) = transition(state, trailing_halanta, "aa", LONG_A);
+                edges.push(LatticeEdge { len, cost: cost + VOWEL_PROMOTION_PENALTY, emission, next_state });
+            } else {
+                // The consonant keeps its inherent 'a' and the vowel stands alone.
+                let emission = Emission::push(trailing_halanta, full, "");
+                edges.push(LatticeEdge {
+                    len,
+                    cost: cost + INDEPENDENT_VOWEL_PENALTY,
+                    emission,
+                    next_state: State::Syllable,
+                });
             }
         }
-        None
+    }
+
+    for &&(pattern, match_result) in alternates {
+        let (emission, next_state) = transition(state, trailing_halanta, pattern, match_result);
+        edges.push(LatticeEdge { len: pattern.len(), cost: ALTERNATE_FORM_PENALTY, emission, next_state });
     }
 }
 
@@ -516,3 +912,97 @@ impl Default for RomanizationEngine {
         Self::new()
     }
 }
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    const INPUTS: &[&str] = &[
+        "rama", "lagyo", "malai", "gau", "aau", "nyano", "shanti", "tathya", "kath", "chalo", "gyan", "kanchan",
+        "namaste", "bhasha", "kripa", "chha", "tatta", "pani", "kitab", "aaja", "bhai", "hariyo", "dherai",
+    ];
+
+    fn ranked(roman: &str) -> Vec<(String, u32)> {
+        RomanizationEngine::new().generate_ranked_candidates(roman, MAX_LITERAL_CANDIDATES)
+    }
+
+    #[test]
+    fn variants_of_the_old_heuristics_are_still_produced() {
+        let cases = [
+            // A final 'a' kept as 'aa'.
+            ("kripa", "क्रिपा"),
+            ("aaja", "आजा"),
+            ("chha", "छा"),
+            // Medial vowel promotion.
+            ("lagyo", "लाग्यो"),
+            ("namaste", "नामस्ते"),
+            ("kitab", "किताब"),
+            ("pani", "पानि"),
+            // 'ai' and 'au' split as 'aa' plus an independent vowel.
+            ("malai", "मलाइ"),
+            ("dherai", "धेराइ"),
+            ("bhai", "भाइ"),
+            ("gau", "गाउ"),
+            // Ambiguous letter combinations.
+            ("nyano", "ञनो"),
+            ("kath", "कठ"),
+            ("tatta", "तट"),
+            ("chalo", "छलो"),
+            ("gyan", "ज्ञन"),
+            ("hariyo", "हऋयो"),
+            // "sh" also means ष; श is already the primary reading.
+            ("shanti", "षन्ति"),
+            ("bhasha", "भष"),
+        ];
+        for (roman, variant) in cases {
+            let candidates = ranked(roman);
+            assert!(candidates.iter().any(|(candidate, _)| candidate == variant), "{} -> {:?}", roman, candidates);
+        }
+    }
+
+    #[test]
+    fn candidates_come_out_in_path_cost_order() {
+        let cases: &[(&str, &[(&str, u32)])] = &[
+            ("kath", &[
+                ("कथ", 0), ("काथ", 2), ("कठ", 2), ("कथ्", 4),
+                ("काठ", 4), ("कत्ह", 4), ("काथ्", 6), ("कठ्", 6),
+            ]),
+            ("gau", &[("गौ", 0), ("गउ", 2), ("गऔ", 3), ("गाउ", 4)]),
+            ("aaja", &[("आज", 0), ("अअज", 2), ("आजा", 2), ("अअजा", 4)]),
+            ("malai", &[
+                ("मलै", 0), ("मालै", 2), ("मलइ", 2), ("मलऐ", 3),
+                ("मालइ", 4), ("मलाइ", 4), ("मालऐ", 5), ("मालाइ", 6),
+            ]),
+        ];
+        for &(roman, expected) in cases {
+            let expected: Vec<(String, u32)> = expected.iter().map(|&(text, cost)| (text.to_string(), cost)).collect();
+            assert_eq!(ranked(roman), expected, "{}", roman);
+        }
+    }
+
+    #[test]
+    fn candidates_start_with_the_primary_and_stay_within_the_cap() {
+        let engine = RomanizationEngine::new();
+        for roman in INPUTS {
+            let candidates = ranked(roman);
+            assert_eq!(candidates[0], (engine.transliterate_primary(roman), 0), "{}", roman);
+            assert!(candidates.len() <= MAX_LITERAL_CANDIDATES, "{}", roman);
+            assert!(candidates.windows(2).all(|pair| pair[0].1 <= pair[1].1), "{}", roman);
+            assert!(candidates.iter().all(|&(_, cost)| cost <= MAX_PATH_COST), "{}", roman);
+            let mut texts: Vec<&str> = candidates.iter().map(|(text, _)| text.as_str()).collect();
+            texts.sort_unstable();
+            texts.dedup();
+            assert_eq!(texts.len(), candidates.len(), "{}", roman);
+
+            // A smaller budget returns the cheapest of the same candidates.
+            for k in 1..MAX_LITERAL_CANDIDATES {
+                let fewer = engine.generate_ranked_candidates(roman, k);
+                assert_eq!(fewer[..], candidates[..k.min(candidates.len())], "{} with k = {}", roman, k);
+            }
+            assert_eq!(engine.generate_candidates(roman).len(), candidates.len(), "{}", roman);
+        }
+        assert_eq!(ranked("shanti").len(), MAX_LITERAL_CANDIDATES);
+        assert_eq!(ranked("?"), vec![("?".to_string(), 0)]);
+        assert!(ranked("").is_empty());
+    }
+}
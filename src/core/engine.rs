@@ -1,35 +1,205 @@
 // File: src/core/engine.rs
 use crate::core::{
-    context::ContextModel, converter::RomanizationEngine,
+    cache::{CacheStats, SuggestionCache, DEFAULT_CACHE_BYTES},
+    compaction::{CompactedState, CompactionConfig, CompactionInput, CompactionSummary},
+    context::{ContextHistory, ContextKey, ContextModel},
+    converter::{RomanizationEngine, RomanizationScheme}, pool::StagePool, session::CompositionSession,
+    stats::{self, Stage},
     trie::Trie, types::WordId,
 };
-use crate::fuzzy::symspell::SymSpell;
-use crate::learning::{LearningEngine, WordConfirmation};
-use crate::persistence::{load_from_disk, save_to_disk};
+use crate::fuzzy::symspell::{within_distance, FuzzyMatch, SymSpell};
+use crate::journal::{journal_path, Journal};
+use crate::learning::{LearnedWord, LearningEngine, WordConfirmation};
+use crate::lexicon::MappedLexicon;
+use crate::persistence::{encode_snapshot, load_from_disk_lazy, save_to_disk, SectionLoad, WarmSections};
+use crate::lexicon::fnv1a64;
+use std::borrow::Cow;
+use std::cell::RefCell;
 use std::collections::HashMap;
 use std::path::Path;
+use std::sync::{Mutex, MutexGuard, OnceLock};
 
 const CONTEXT_WINDOW_SIZE: usize = 3;
-const MAX_EDIT_DISTANCE: usize = 2;
+pub const MAX_EDIT_DISTANCE: usize = 2;
+
+/// Journaled confirmations after which the snapshot is rewritten and the journal truncated.
+const SNAPSHOT_INTERVAL: usize = 500;
+
+/// Inputs at least this long run their stages on the stage pool when parallel
+/// stages are enabled. Shorter ones finish faster than a thread handoff.
+const PARALLEL_MIN_INPUT_LEN: usize = 6;
 
 const LITERAL_BASE_SCORE: u64 = 1;
 const PRIMARY_LITERAL_SCORE: u64 = 2;
 
+/// Fuzzy matches rank just below an exact prefix match of the same frequency, and
+/// each further edit costs one more point.
+fn fuzzy_score(frequency: u64, distance: usize) -> u64 {
+    frequency.saturating_sub(1 + distance as u64)
+}
+
+/// The stage that produced a candidate. When two stages propose the same word,
+/// the higher-ranked source wins. The discriminants are part of the C API.
 #[derive(Debug, PartialEq, Eq, PartialOrd, Ord, Clone, Copy)]
-enum SuggestionSource {
-    Literal,
-    PrimaryLiteral,
-    Fuzzy,
-    Trie,
+#[repr(u8)]
+pub enum SuggestionSource {
+    Literal = 0,
+    PrimaryLiteral = 1,
+    Fuzzy = 2,
+    Trie = 3,
+    /// A predicted next word, offered before anything is typed. Never merged
+    /// with the other sources.
+    Prediction = 4,
+}
+
+/// Type of the exact prefix matches from the trie and the lexicon (stage 1).
+type PrefixMatches = (Vec<(WordId, u64)>, Vec<(WordId, u64)>);
+
+/// Outputs of stages 1-4 before they are merged. The fuzzy and literal stages
+/// are `None` when they were not run ahead of time; the merge then runs them
+/// only if it still needs them.
+struct StageOutputs<'a> {
+    prefix_matches: PrefixMatches,
+    primary_devanagari: Cow<'a, str>,
+    fuzzy: Option<Vec<FuzzyMatch>>,
+    lexicon_fuzzy: Option<Vec<FuzzyMatch>>,
+    literals: Option<Vec<(String, u32)>>,
+    /// Runs stage 4 if it was not run ahead of time.
+    romanizer: &'a RomanizationEngine,
+}
+
+/// The text of a candidate during the merge, named rather than owned.
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+enum CandidateText {
+    Word(WordId),
+    LexiconWord(WordId),
+    Primary,
+    /// Index into the literal variants of stage 4.
+    Literal(usize),
+}
+
+#[derive(Debug, Clone, Copy)]
+struct Candidate {
+    text: CandidateText,
+    /// FNV-1a of the text, compared before the text itself.
+    hash: u64,
+    score: u64,
+    source: SuggestionSource,
+    /// Position of the first proposal; breaks score ties in the final sort.
+    order: u32,
+}
+
+/// Merge buffers of `rank_suggestions`. Queries run on several threads under a
+/// shared lock, so each thread keeps its own, grown once to the largest merge.
+#[derive(Default)]
+struct MergeScratch {
+    candidates: Vec<Candidate>,
+    /// Text hash -> index of the first candidate with that hash, so that adding
+    /// a candidate finds its duplicate in O(1) instead of scanning the list.
+    by_hash: HashMap<u64, usize>,
+}
+
+impl MergeScratch {
+    fn clear(&mut self) {
+        self.candidates.clear();
+        self.by_hash.clear();
+    }
+}
+
+thread_local! {
+    static MERGE_SCRATCH: RefCell<MergeScratch> = RefCell::new(MergeScratch::default());
+}
+
+/// Resolves candidate texts against the engine and the outputs of one query.
+struct CandidateTexts<'a> {
+    engine: &'a ImeEngine,
+    primary: &'a str,
+    literals: &'a [(String, u32)],
+}
+
+impl CandidateTexts<'_> {
+    fn get(&self, text: CandidateText) -> &str {
+        match text {
+            CandidateText::Word(word_id) => self.engine.trie.metadata_store.devanagari(word_id),
+            CandidateText::LexiconWord(word_id) => {
+                self.engine.lexicon.as_ref().and_then(|lexicon| lexicon.devanagari(word_id)).unwrap_or("")
+            }
+            CandidateText::Primary => self.primary,
+            CandidateText::Literal(i) => &self.literals[i].0,
+        }
+    }
+
+    /// Adds a candidate, or merges it into the one with the same text: a
+    /// higher-ranked source takes over, and the same source keeps the best score.
+    fn add(&self, scratch: &mut MergeScratch, text: CandidateText, score: u64, source: SuggestionSource) {
+        let value = self.get(text);
+        let hash = fnv1a64(value.as_bytes());
+        let MergeScratch { candidates, by_hash } = scratch;
+        let existing = match by_hash.get(&hash) {
+            Some(&idx) if self.get(candidates[idx].text) == value => Some(idx),
+            // Another text with the same hash: only colliding candidates are compared.
+            Some(_) => candidates.iter().position(|c| c.hash == hash && self.get(c.text) == value),
+            None => None,
+        };
+        match existing.map(|idx| &mut candidates[idx]) {
+            Some(existing) if source > existing.source => {
+                existing.text = text;
+                existing.score = score;
+                existing.source = source;
+            }
+            Some(existing) if source == existing.source => existing.score = existing.score.max(score),
+            Some(_) => {}
+            None => {
+                let order = candidates.len();
+                by_hash.entry(hash).or_insert(order);
+                candidates.push(Candidate { text, hash, score, source, order: order as u32 });
+            }
+        }
+    }
+}
+
+/// A ranked candidate together with the stage that produced it.
+#[derive(Debug, Clone, PartialEq, Eq)]
+pub struct Suggestion {
+    pub devanagari: String,
+    pub score: u64,
+    pub source: SuggestionSource,
 }
 
 pub struct ImeEngine {
     pub trie: Trie,
     pub context_model: ContextModel,
+    /// The romanizer of `RomanizationScheme::Standard`.
     pub romanizer: RomanizationEngine,
+    /// Romanizers of the other schemes, built when a session first needs one.
+    scheme_romanizers: [OnceLock<RomanizationEngine>; RomanizationScheme::ALL.len()],
     pub symspell: SymSpell,
+    /// Optional read-only dictionary, queried in place from a memory-mapped file.
+    pub lexicon: Option<MappedLexicon>,
     learning_engine: LearningEngine,
     dictionary_path: Option<String>,
+    journal: Option<Journal>,
+    /// Sequence number of the last confirmation applied to this state.
+    journal_seq: u64,
+    confirmations_since_snapshot: usize,
+    /// A snapshot is owed regardless of the count, as after a compaction.
+    snapshot_requested: bool,
+    /// Whether long inputs run their independent stages concurrently.
+    parallel_stages: bool,
+    /// Recent results. Queries take `&self`, so it has its own lock.
+    suggestion_cache: Mutex<SuggestionCache>,
+    compaction: CompactionConfig,
+    /// `journal_seq` at the last compaction, or the interval boundary before it.
+    last_compaction_seq: u64,
+    /// Bumped whenever trie or lexicon node indices change meaning, so that
+    /// sessions know to re-descend their cursors.
+    cursor_generation: u64,
+    /// The fuzzy index and context model, still decoding after a lazy load.
+    /// Until they arrive, queries skip the fuzzy stage and rerank without context.
+    warmup: Option<SectionLoad>,
+    /// Confirmations learned into the trie while warming, to be added to the
+    /// fuzzy index and context model once those arrive.
+    deferred_index: Vec<(WordConfirmation, LearnedWord)>,
 }
 
 impl ImeEngine {
@@ -38,109 +208,816 @@ impl ImeEngine {
             trie: Trie::new(),
             context_model: ContextModel::new(CONTEXT_WINDOW_SIZE),
             romanizer: RomanizationEngine::new(),
+            scheme_romanizers: Default::default(),
             symspell: SymSpell::new(MAX_EDIT_DISTANCE),
+            lexicon: None,
             learning_engine: LearningEngine::new(),
             dictionary_path: None,
+            journal: None,
+            journal_seq: 0,
+            confirmations_since_snapshot: 0,
+            snapshot_requested: false,
+            parallel_stages: false,
+            suggestion_cache: Mutex::new(SuggestionCache::new(DEFAULT_CACHE_BYTES)),
+            compaction: CompactionConfig::default(),
+            last_compaction_seq: 0,
+            cursor_generation: 0,
+            warmup: None,
+            deferred_index: Vec::new(),
         }
     }
 
+    /// Loads the snapshot at `path`, replays any journaled confirmations it does not
+    /// cover yet, and keeps journaling new confirmations next to it. Returns once
+    /// the trie is loaded; see `finish_warmup` for the rest.
+    ///
+    /// A dictionary that another engine already has open is loaded as it is,
+    /// but nothing learned here is saved to it.
     pub fn from_file_or_new(path: &str) -> Self {
-        let mut engine = load_from_disk(Path::new(path)).unwrap_or_else(|_| Self::new());
+        let load = || load_from_disk_lazy(Path::new(path)).unwrap_or_else(|_| Self::new());
+        if path.is_empty() {
+            let mut engine = load();
+            engine.dictionary_path = Some(path.to_string());
+            return engine;
+        }
+
+        // The journal's lock is taken before the snapshot is read, so that the
+        // engine that held it has finished writing.
+        let journal = match Journal::open(&journal_path(Path::new(path))) {
+            Ok(journal) => Some(journal),
+            Err(e) if e.kind() == std::io::ErrorKind::WouldBlock => {
+                eprintln!("[Rust WARN] {} is open in another engine; learning will not be saved", path);
+                return load();
+            }
+            Err(e) => {
+                eprintln!("[Rust WARN] Could not open journal for {}: {}", path, e);
+                None
+            }
+        };
+        let mut engine = load();
         engine.dictionary_path = Some(path.to_string());
+        if let Some((journal, records)) = journal {
+            for (seq, confirmation) in records {
+                if seq > engine.journal_seq {
+                    engine.learn(&confirmation);
+                    engine.journal_seq = seq;
+                    engine.confirmations_since_snapshot += 1;
+                }
+            }
+            engine.journal = Some(journal);
+        }
         engine
     }
 
+    /// Takes over the rest of a loaded snapshot: installed now if it is
+    /// decoded already, or when `finish_warmup` is called.
+    pub(crate) fn start_warmup(&mut self, rest: Result<WarmSections, SectionLoad>) {
+        match rest {
+            Ok(sections) => self.install_warm_sections(sections),
+            Err(thread) => self.warmup = Some(thread),
+        }
+    }
+
+    /// Whether the fuzzy index and context model are still loading.
+    pub fn is_warming(&self) -> bool {
+        self.warmup.is_some()
+    }
+
+    /// Whether `finish_warmup` would return without waiting.
+    pub fn warmup_finished(&self) -> bool {
+        self.warmup.as_ref().map_or(true, |thread| thread.is_finished())
+    }
+
+    /// Waits for the background decode of a lazy load, installs its sections and
+    /// indexes the confirmations learned meanwhile. If decoding failed, the
+    /// fuzzy index is rebuilt from the trie and the context model starts empty.
+    /// Does nothing once the engine is warm.
+    pub fn finish_warmup(&mut self) {
+        let Some(thread) = self.warmup.take() else { return };
+        let sections = thread.join().unwrap_or_else(|_| Err("warm-up thread panicked".to_string()));
+        let decoded = match sections {
+            Ok(sections) => {
+                self.install_warm_sections(sections);
+                true
+            }
+            Err(e) => {
+                eprintln!("[Rust WARN] Could not load fuzzy index and context model, rebuilding: {}", e);
+                false
+            }
+        };
+        for (confirmation, learned) in std::mem::take(&mut self.deferred_index) {
+            self.learning_engine.index_word(&self.trie, &mut self.context_model, &mut self.symspell, &confirmation, learned);
+        }
+        if !decoded {
+            self.symspell = SymSpell::from_trie(&self.trie, MAX_EDIT_DISTANCE);
+        }
+        // Results ranked while warming ran without the fuzzy stage.
+        self.suggestion_cache.get_mut().unwrap_or_else(|e| e.into_inner()).clear();
+    }
+
+    fn install_warm_sections(&mut self, (context_model, symspell): WarmSections) {
+        self.context_model = context_model;
+        self.symspell = symspell;
+    }
+
+    pub fn journal_seq(&self) -> u64 {
+        self.journal_seq
+    }
+
+    pub(crate) fn set_journal_seq(&mut self, seq: u64) {
+        self.journal_seq = seq;
+        self.align_compaction();
+    }
+
+    pub(crate) fn cursor_generation(&self) -> u64 {
+        self.cursor_generation
+    }
+
+    /// Maps a lexicon file written by `lexicon::write_lexicon`. This costs O(1) in
+    /// the size of the lexicon; pages are faulted in as queries touch them.
+    pub fn attach_lexicon(&mut self, path: &Path) -> Result<(), std::io::Error> {
+        self.lexicon = Some(MappedLexicon::open(path)?);
+        self.cursor_generation += 1;
+        self.cache().clear();
+        Ok(())
+    }
+
+    /// Replaces the decay and compaction policy.
+    pub fn set_compaction_config(&mut self, config: CompactionConfig) {
+        self.compaction = config;
+        self.align_compaction();
+    }
+
+    /// The snapshot does not record when the last compaction ran; counting from
+    /// the interval boundary at or before the current sequence number keeps
+    /// compactions on schedule across restarts.
+    fn align_compaction(&mut self) {
+        let interval = self.compaction.interval.max(1);
+        self.last_compaction_seq = self.journal_seq - self.journal_seq % interval;
+    }
+
+    /// Whether enough confirmations have been made since the last compaction.
+    /// `EngineHandle` then compacts in the background; other callers use `compact`.
+    pub fn compaction_due(&self) -> bool {
+        self.compaction.interval > 0 && self.journal_seq >= self.last_compaction_seq + self.compaction.interval
+    }
+
+    /// Copies what a compaction reads and restarts the interval. O(n) copying;
+    /// the expensive part is `CompactionInput::build`, which needs no engine.
+    pub fn prepare_compaction(&mut self) -> CompactionInput {
+        self.finish_warmup();
+        let trie = &self.trie;
+        let keys = trie
+            .metadata_store
+            .iter()
+            .flat_map(|word| {
+                word.variants()
+                    .filter(move |variant| trie.word_at(variant) == Some(word.id()))
+                    .map(move |variant| (variant.to_string(), word.id()))
+            })
+            .collect();
+        let elapsed = self.journal_seq - self.last_compaction_seq;
+        self.last_compaction_seq = self.journal_seq;
+        CompactionInput {
+            metadata_store: trie.metadata_store.clone(),
+            keys,
+            context_model: self.context_model.clone(),
+            max_edit_distance: self.symspell.max_edit_distance(),
+            config: self.compaction,
+            elapsed,
+            seed: self.journal_seq,
+        }
+    }
+
+    /// Swaps in a compacted state and applies `replay`, the confirmations made
+    /// since `prepare_compaction` (they are journaled already). A snapshot is
+    /// then due, so that the next start loads the compacted dictionary.
+    pub fn install_compaction(&mut self, state: CompactedState, replay: &[WordConfirmation]) -> CompactionSummary {
+        self.trie = state.trie;
+        self.symspell = state.symspell;
+        self.context_model = state.context_model;
+        self.cursor_generation += 1;
+        self.suggestion_cache.get_mut().unwrap_or_else(|e| e.into_inner()).clear();
+        for confirmation in replay {
+            self.learn(confirmation);
+        }
+        self.snapshot_requested = true;
+        state.summary
+    }
+
+    /// Decays, evicts and rebuilds in place.
+    pub fn compact(&mut self) -> CompactionSummary {
+        let state = self.prepare_compaction().build();
+        let summary = self.install_compaction(state, &[]);
+        self.snapshot_if_due();
+        summary
+    }
+
+    /// Replaces the suggestion cache with an empty one of `capacity_bytes`; 0 disables it.
+    pub fn set_cache_capacity(&mut self, capacity_bytes: usize) {
+        *self.cache() = SuggestionCache::new(capacity_bytes);
+    }
+
+    pub fn cache_stats(&self) -> CacheStats {
+        self.cache().stats()
+    }
+
+    fn cache(&self) -> MutexGuard<'_, SuggestionCache> {
+        self.suggestion_cache.lock().unwrap_or_else(|e| e.into_inner())
+    }
+
+    /// Answers from the cache, or ranks with `compute` and remembers the result.
+    /// Results depend on the preceding words through the context reranking, and
+    /// on the scheme through the transliteration stages, so both are part of the key.
+    fn cached(
+        &self,
+        prefix: &str,
+        context: ContextKey,
+        scheme: RomanizationScheme,
+        count: usize,
+        compute: impl FnOnce() -> Vec<Suggestion>,
+    ) -> Vec<Suggestion> {
+        let _timer = stats::timer(Stage::Query);
+        if let Some(suggestions) = self.cache().get(prefix, context, scheme, count) {
+            return suggestions;
+        }
+        let suggestions = {
+            let _timer = stats::timer(Stage::Rank);
+            compute()
+        };
+        self.cache().insert(prefix, context, scheme, count, &suggestions);
+        suggestions
+    }
+
+    /// The romanizer of a layout's scheme. Every scheme shares the dictionary;
+    /// only the transliteration of what is typed differs.
+    pub fn romanizer_for(&self, scheme: RomanizationScheme) -> &RomanizationEngine {
+        match scheme {
+            RomanizationScheme::Standard => &self.romanizer,
+            scheme => self.scheme_romanizers[scheme as usize].get_or_init(|| RomanizationEngine::with_scheme(scheme)),
+        }
+    }
+
+    /// Runs the trie, fuzzy, primary and literal stages of long inputs side by
+    /// side on the shared stage pool, so their latency is that of the slowest
+    /// stage rather than the sum. The fuzzy and literal stages then run even
+    /// when the merge ends up not needing them, so this pays off on multi-core
+    /// machines only. Results are the same in both modes, except that the
+    /// literal lattice is searched with the widest beam the merge could need.
+    pub fn set_parallel_stages(&mut self, enabled: bool) {
+        self.parallel_stages = enabled;
+    }
+
     pub fn get_suggestions(&self, prefix: &str, count: usize) -> Vec<(String, u64)> {
+        Self::without_sources(self.get_ranked_suggestions(prefix, count))
+    }
+
+    /// Same as `get_suggestions`, but keeps the producing stage of each candidate.
+    pub fn get_ranked_suggestions(&self, prefix: &str, count: usize) -> Vec<Suggestion> {
         if prefix.is_empty() { return vec![]; }
+        let context = self.context_model.context();
+        self.cached(prefix, context, RomanizationScheme::Standard, count, || self.rank_prefix(prefix, context, count))
+    }
 
-        let mut candidates: HashMap<String, (u64, SuggestionSource)> = HashMap::new();
-
-        // Helper closure to manage candidate insertion logic.
-        let add_candidate = |devanagari: String, score: u64, source: SuggestionSource, current_candidates: &mut HashMap<String, (u64, SuggestionSource)>| {
-            current_candidates.entry(devanagari)
-                .and_modify(|(existing_score, existing_source)| {
-                    if source > *existing_source {
-                        *existing_score = score;
-                        *existing_source = source;
-                    } else if source == *existing_source && score > *existing_score {
-                        *existing_score = score;
-                    }
-                })
-                .or_insert((score, source));
+    fn rank_prefix(&self, prefix: &str, context: ContextKey, count: usize) -> Vec<Suggestion> {
+
+        let prefix_matches = || {
+            let trie_suggestions = self.trie.get_top_k_suggestions(prefix, count);
+            let lexicon_suggestions = self
+                .lexicon
+                .as_ref()
+                .map_or_else(Vec::new, |lexicon| lexicon.trie().get_top_k_suggestions(prefix, count));
+            (trie_suggestions, lexicon_suggestions)
+        };
+        let primary = || Cow::Owned(self.romanizer.transliterate_primary(prefix));
+        let stages = self.run_stages(prefix, prefix_matches, primary, &self.romanizer, count);
+        self.rank_suggestions(prefix, stages, context, count)
+    }
+
+    /// Same as `get_suggestions`, but reuses the trie cursor and FST state that the
+    /// session has maintained across keystrokes instead of recomputing them.
+    pub fn get_session_suggestions(&self, session: &CompositionSession, count: usize) -> Vec<(String, u64)> {
+        Self::without_sources(self.get_session_ranked_suggestions(session, count))
+    }
+
+    /// Reranks in the session's own context: the words committed through it.
+    pub fn get_session_ranked_suggestions(&self, session: &CompositionSession, count: usize) -> Vec<Suggestion> {
+        if session.is_empty() { return vec![]; }
+        let context = self.context_model.context_of(session.history(), &self.trie);
+        if !session.is_synced(self) {
+            // Its cursors point into a trie this engine no longer has.
+            let mut session = session.clone();
+            session.refresh(self);
+            return self.cached(session.roman(), context, session.scheme(), count, || self.rank_session(&session, context, count));
+        }
+        self.cached(session.roman(), context, session.scheme(), count, || self.rank_session(session, context, count))
+    }
+
+    /// Up to `count` likely next words after the word confirmed last anywhere,
+    /// most likely first, scored by how often they followed it. O(count): they
+    /// are read from the context model's successor lists, not ranked.
+    pub fn get_predictions(&self, count: usize) -> Vec<Suggestion> {
+        self.predictions_after(self.context_model.previous_word(), count)
+    }
+
+    /// `get_predictions` after the word committed last in the session, for
+    /// showing the moment a word is committed and before the next is typed.
+    pub fn get_session_predictions(&self, session: &CompositionSession, count: usize) -> Vec<Suggestion> {
+        self.predictions_after(self.context_model.context_of(session.history(), &self.trie).1, count)
+    }
+
+    fn predictions_after(&self, previous_word: Option<WordId>, count: usize) -> Vec<Suggestion> {
+        // The context model is not loaded until warm-up finishes.
+        let Some(previous_word) = previous_word.filter(|_| !self.is_warming()) else { return vec![] };
+        self.context_model
+            .successors(previous_word)
+            .filter_map(|(word_id, score)| {
+                let devanagari = self.trie.metadata_store.get(word_id)?.devanagari().to_string();
+                Some(Suggestion { devanagari, score, source: SuggestionSource::Prediction })
+            })
+            .take(count)
+            .collect()
+    }
+
+    /// A Roman spelling the user has typed `devanagari` with, for confirming a
+    /// word that was picked without being typed, such as a prediction.
+    pub fn roman_key(&self, devanagari: &str) -> Option<String> {
+        let word_id = self.trie.find_word_id_by_devanagari(devanagari)?;
+        self.trie.metadata_store.variants(word_id).min().map(str::to_string)
+    }
+
+    fn rank_session(&self, session: &CompositionSession, context: ContextKey, count: usize) -> Vec<Suggestion> {
+
+        let prefix_matches = || {
+            let trie_suggestions = session
+                .trie_node()
+                .map_or_else(Vec::new, |node_idx| self.trie.get_top_k_from_node(node_idx, count));
+            let lexicon_suggestions = match (&self.lexicon, session.lexicon_node()) {
+                (Some(lexicon), Some(node_idx)) => lexicon.trie().get_top_k_from_node(node_idx, count),
+                _ => Vec::new(),
+            };
+            (trie_suggestions, lexicon_suggestions)
+        };
+        let romanizer = self.romanizer_for(session.scheme());
+        let stages = self.run_stages(session.roman(), prefix_matches, || Cow::Borrowed(session.primary()), romanizer, count);
+        self.rank_suggestions(session.roman(), stages, context, count)
+    }
+
+    fn without_sources(suggestions: Vec<Suggestion>) -> Vec<(String, u64)> {
+        suggestions.into_iter().map(|s| (s.devanagari, s.score)).collect()
+    }
+
+    /// Computes the inputs of the merge. In sequential mode only the exact
+    /// matches and the primary transliteration are computed up front.
+    fn run_stages<'a>(
+        &self,
+        prefix: &str,
+        prefix_matches: impl FnOnce() -> PrefixMatches + Send,
+        primary: impl FnOnce() -> Cow<'a, str> + Send,
+        romanizer: &'a RomanizationEngine,
+        count: usize,
+    ) -> StageOutputs<'a> {
+        let prefix_matches = move || {
+            let _timer = stats::timer(Stage::Trie);
+            prefix_matches()
+        };
+        let primary = move || {
+            let _timer = stats::timer(Stage::Primary);
+            primary()
+        };
+        let pool = match self.parallel_stages && prefix.len() >= PARALLEL_MIN_INPUT_LEN {
+            true => StagePool::shared(),
+            false => None,
+        };
+        let Some(pool) = pool else {
+            return StageOutputs {
+                prefix_matches: prefix_matches(),
+                primary_devanagari: primary(),
+                fuzzy: None,
+                lexicon_fuzzy: None,
+                literals: None,
+                romanizer,
+            };
         };
 
+        let (mut prefix_matches, mut primary) = (Some(prefix_matches), Some(primary));
+        let mut exact = None;
+        let mut primary_devanagari = None;
+        let mut fuzzy = None;
+        let mut lexicon_fuzzy = None;
+        let mut literals = None;
+        pool.run(&mut [
+            &mut || {
+                exact = prefix_matches.take().map(|f| f());
+                primary_devanagari = primary.take().map(|f| f());
+            },
+            &mut || fuzzy = Some(self.fuzzy_matches(prefix, count)),
+            &mut || lexicon_fuzzy = self.lexicon.as_ref().map(|lexicon| self.lexicon_fuzzy_matches(lexicon, prefix, count)),
+            // Stage 4 never asks for more than `count + 1` variants.
+            &mut || literals = Some(self.literal_candidates(romanizer, prefix, count + 1)),
+        ]);
+        StageOutputs {
+            prefix_matches: exact.unwrap_or_default(),
+            primary_devanagari: primary_devanagari.unwrap_or_default(),
+            fuzzy,
+            lexicon_fuzzy,
+            literals,
+            romanizer,
+        }
+    }
+
+    fn fuzzy_matches(&self, prefix: &str, count: usize) -> Vec<FuzzyMatch> {
+        if self.is_warming() { return Vec::new(); }
+        let _timer = stats::timer(Stage::Fuzzy);
+        self.symspell.lookup_top_k(prefix, count, |id| {
+            self.trie.metadata_store.get(id).map_or(0, |word| word.frequency())
+        })
+    }
+
+    fn lexicon_fuzzy_matches(&self, lexicon: &MappedLexicon, prefix: &str, count: usize) -> Vec<FuzzyMatch> {
+        let _timer = stats::timer(Stage::Fuzzy);
+        lexicon.fuzzy_lookup_top_k(prefix, count)
+    }
+
+    /// The whole-word conversion of `roman` after the words in `history`: the
+    /// learned or lexicon word the key spells exactly, scored as ranking scores
+    /// it (both layers' counts plus the context boost), or else the primary
+    /// transliteration. Unlike a suggestion query it never completes a prefix
+    /// or guesses a fuzzy match, and it bypasses the cache, so that bulk
+    /// conversion on many threads does not contend on it.
+    pub fn transliterate_word(&self, roman: &str, history: &ContextHistory) -> Cow<'_, str> {
+        let context = self.context_model.context_of(history, &self.trie);
+        let boost = |devanagari: &str| {
+            self.trie.find_word_id_by_devanagari(devanagari).map_or(0, |word_id| self.context_model.boost_after(context, word_id))
+        };
+        let learned = self.trie.word_at(roman).map(|word_id| {
+            let devanagari = self.trie.metadata_store.devanagari(word_id);
+            let score = self.trie.metadata_store.frequency(word_id) + self.lexicon_frequency(devanagari);
+            (score + boost(devanagari), devanagari)
+        });
+        let listed = self.lexicon.as_ref().and_then(|lexicon| {
+            let word_id = lexicon.trie().word_at(roman)?;
+            let devanagari = lexicon.devanagari(word_id)?;
+            let score = lexicon.frequency(word_id) + self.learned_frequency(devanagari);
+            Some((score + boost(devanagari), devanagari))
+        });
+        match (learned, listed) {
+            (Some(a), Some(b)) => Cow::Borrowed(if b.0 > a.0 { b.1 } else { a.1 }),
+            (Some((_, devanagari)), None) | (None, Some((_, devanagari))) => Cow::Borrowed(devanagari),
+            (None, None) => Cow::Owned(self.romanizer.transliterate_primary(roman)),
+        }
+    }
+
+    /// The system lexicon's count for a word, 0 without a lexicon. The user
+    /// dictionary is an overlay on the lexicon: for a lexicon word it holds only
+    /// what the user added (the learned count, variants and bigrams), and the
+    /// two layers are summed at query time.
+    fn lexicon_frequency(&self, devanagari: &str) -> u64 {
+        let Some(lexicon) = &self.lexicon else { return 0 };
+        lexicon.find_word_id(devanagari).map_or(0, |word_id| lexicon.frequency(word_id))
+    }
+
+    /// The user dictionary's learned count for a word, 0 if it has none.
+    fn learned_frequency(&self, devanagari: &str) -> u64 {
+        self.trie
+            .find_word_id_by_devanagari(devanagari)
+            .map_or(0, |word_id| self.trie.metadata_store.frequency(word_id))
+    }
+
+    fn literal_candidates(&self, romanizer: &RomanizationEngine, prefix: &str, count: usize) -> Vec<(String, u32)> {
+        let _timer = stats::timer(Stage::Literal);
+        romanizer.generate_ranked_candidates(prefix, count)
+    }
+
+    fn rank_suggestions(&self, prefix: &str, stages: StageOutputs<'_>, context: ContextKey, count: usize) -> Vec<Suggestion> {
+        MERGE_SCRATCH.with(|scratch| {
+            let mut scratch = scratch.borrow_mut();
+            scratch.clear();
+            self.merge_candidates(prefix, stages, context, count, &mut scratch)
+        })
+    }
+
+    /// Merges the stage outputs in `scratch` and materializes the top `count`.
+    /// No candidate text is copied until the final list is built.
+    fn merge_candidates(
+        &self,
+        prefix: &str,
+        stages: StageOutputs<'_>,
+        context: ContextKey,
+        count: usize,
+        scratch: &mut MergeScratch,
+    ) -> Vec<Suggestion> {
+        let StageOutputs { prefix_matches: (trie_suggestions, lexicon_suggestions), primary_devanagari, .. } = stages;
+        let mut texts = CandidateTexts { engine: self, primary: &primary_devanagari, literals: &[] };
+
         // --- Stage 1: Trie Search ---
-        let trie_suggestions = self.trie.get_top_k_suggestions(prefix, count);
+        // With a lexicon, a word in both layers scores the sum of its counts, so
+        // it gets the same score whichever layer proposes it.
         for (word_id, score) in trie_suggestions {
-            if let Some(metadata) = self.trie.metadata_store.get(word_id) {
-                add_candidate(metadata.devanagari.clone(), score, SuggestionSource::Trie, &mut candidates);
+            if let Some(word) = self.trie.metadata_store.get(word_id) {
+                let score = score + self.lexicon_frequency(word.devanagari());
+                texts.add(scratch, CandidateText::Word(word_id), score, SuggestionSource::Trie);
+            }
+        }
+        if let Some(lexicon) = &self.lexicon {
+            for (word_id, score) in lexicon_suggestions {
+                if let Some(devanagari) = lexicon.devanagari(word_id) {
+                    let score = score + self.learned_frequency(devanagari);
+                    texts.add(scratch, CandidateText::LexiconWord(word_id), score, SuggestionSource::Trie);
+                }
             }
         }
 
-        // --- BORROW CHECKER FIX IS HERE ---
-        // The original code had a long-lived closure that caused a borrow conflict.
-        // This new structure separates the fuzzy search logic, ensuring borrows do not overlap.
         // --- Stage 2: Fuzzy Search ---
-        if candidates.len() < count {
-            let fuzzy_matches = self.symspell.lookup(prefix);
-            for word_id in fuzzy_matches {
-                if let Some(metadata) = self.trie.metadata_store.get(word_id) {
-                    let score = metadata.frequency.saturating_sub(1);
-                    add_candidate(metadata.devanagari.clone(), score, SuggestionSource::Fuzzy, &mut candidates);
+        if scratch.candidates.len() < count {
+            let fuzzy_matches = stages.fuzzy.unwrap_or_else(|| self.fuzzy_matches(prefix, count));
+            for m in fuzzy_matches {
+                if let Some(word) = self.trie.metadata_store.get(m.word_id) {
+                    let frequency = word.frequency() + self.lexicon_frequency(word.devanagari());
+                    texts.add(scratch, CandidateText::Word(m.word_id), fuzzy_score(frequency, m.distance), SuggestionSource::Fuzzy);
+                }
+            }
+        }
+        if scratch.candidates.len() < count {
+            if let Some(lexicon) = &self.lexicon {
+                let fuzzy_matches = stages.lexicon_fuzzy.unwrap_or_else(|| self.lexicon_fuzzy_matches(lexicon, prefix, count));
+                for m in fuzzy_matches {
+                    if let Some(devanagari) = lexicon.devanagari(m.word_id) {
+                        let frequency = lexicon.frequency(m.word_id) + self.learned_frequency(devanagari);
+                        texts.add(scratch, CandidateText::LexiconWord(m.word_id), fuzzy_score(frequency, m.distance), SuggestionSource::Fuzzy);
+                    }
                 }
             }
         }
-        
+
         // --- Stage 3: Primary Rule-Based Transliteration ---
-    let primary_devanagari = self.romanizer.transliterate_primary(prefix);
-    add_candidate(primary_devanagari, PRIMARY_LITERAL_SCORE, SuggestionSource::PrimaryLiteral, &mut candidates);
+        texts.add(scratch, CandidateText::Primary, PRIMARY_LITERAL_SCORE, SuggestionSource::PrimaryLiteral);
 
         // --- Stage 4: Other Literal FSM Candidates ---
-        let literal_candidates = self.romanizer.generate_candidates(prefix);
-        for devanagari in literal_candidates {
-            add_candidate(devanagari, LITERAL_BASE_SCORE, SuggestionSource::Literal, &mut candidates);
+        // The lattice ranks its variants, so only the best ones that still fit are asked for.
+        let remaining = count.saturating_sub(scratch.candidates.len()).max(1);
+        let mut literal_candidates = stages
+            .literals
+            .unwrap_or_else(|| self.literal_candidates(stages.romanizer, prefix, remaining + 1));
+        literal_candidates.truncate(remaining + 1);
+        texts.literals = &literal_candidates;
+        for i in 0..literal_candidates.len() {
+            texts.add(scratch, CandidateText::Literal(i), LITERAL_BASE_SCORE, SuggestionSource::Literal);
         }
 
-        // --- Stage 5: Conversion, Contextual Re-ranking, and Final Sort ---
-        let mut all_suggestions: Vec<(String, u64)> = candidates
-            .into_iter()
-            .map(|(s, (score, _))| (s, score))
-            .collect();
+        // --- Stage 5: Contextual Re-ranking and Final Sort ---
+        // Every candidate that is a learned word gets its context boost in place.
+        let _timer = stats::timer(Stage::Rerank);
+        let candidates = &mut scratch.candidates;
+        for candidate in candidates.iter_mut() {
+            let word_id = match candidate.text {
+                CandidateText::Word(word_id) => Some(word_id),
+                text => self.trie.find_word_id_by_devanagari(texts.get(text)),
+            };
+            if let Some(word_id) = word_id {
+                candidate.score += self.context_model.boost_after(context, word_id);
+            }
+        }
 
-        let mut suggestions_with_ids: Vec<(WordId, u64)> = all_suggestions.iter()
-            .filter_map(|(dev, score)| {
-                self.trie.find_word_id_by_devanagari(dev).map(|id| (id, *score))
-            })
-            .collect();
+        candidates.sort_unstable_by_key(|c| (std::cmp::Reverse(c.score), c.order));
+        candidates
+            .iter()
+            .take(count)
+            .map(|c| Suggestion { devanagari: texts.get(c.text).to_string(), score: c.score, source: c.source })
+            .collect()
+    }
 
-        self.context_model.rerank_suggestions(&mut suggestions_with_ids);
+    pub fn user_confirms(&mut self, roman: &str, devanagari: &str) {
+        let confirmation = WordConfirmation { roman: roman.to_string(), devanagari: devanagari.to_string(), context: None };
+        self.apply_confirmation(&confirmation);
+        self.snapshot_if_due();
+    }
 
-        for (id, new_score) in suggestions_with_ids {
-            if let Some(dev_word) = self.trie.metadata_store.get(id).map(|m| &m.devanagari) {
-                 if let Some(entry) = all_suggestions.iter_mut().find(|(s, _)| s == dev_word) {
-                    entry.1 = new_score;
-                }
+    /// Confirms the session's word as `devanagari` in the session's context,
+    /// and records it there.
+    pub fn user_confirms_in(&mut self, session: &mut CompositionSession, devanagari: &str) {
+        if session.is_empty() || devanagari.is_empty() { return; }
+        let confirmation = WordConfirmation {
+            roman: session.roman().to_string(),
+            devanagari: devanagari.to_string(),
+            context: Some(session.history().clone()),
+        };
+        self.apply_confirmation(&confirmation);
+        self.snapshot_if_due();
+        session.commit(devanagari);
+    }
+
+    /// Confirms a predicted word picked while the session was empty, in the
+    /// session's context, and records it there.
+    pub fn accept_prediction_in(&mut self, session: &mut CompositionSession, devanagari: &str) {
+        if !session.is_empty() || devanagari.is_empty() { return; }
+        if let Some(roman) = self.roman_key(devanagari) {
+            let confirmation = WordConfirmation { roman, devanagari: devanagari.to_string(), context: Some(session.history().clone()) };
+            self.apply_confirmation(&confirmation);
+            self.snapshot_if_due();
+        }
+        session.commit(devanagari);
+    }
+
+    /// Learns and journals a confirmation, in the input context it carries.
+    /// Leaves a snapshot that falls due to the caller (see `take_snapshot_due`).
+    pub fn apply_confirmation(&mut self, confirmation: &WordConfirmation) {
+        if confirmation.roman.is_empty() || confirmation.devanagari.is_empty() { return; }
+        self.learn(confirmation);
+        self.journal_seq += 1;
+
+        if let Some(journal) = &self.journal {
+            journal.append(self.journal_seq, confirmation);
+            self.confirmations_since_snapshot += 1;
+        }
+    }
+
+    /// Whether a journal snapshot is due, restarting the count if so. Never
+    /// while warming, since the snapshot needs every section.
+    pub fn take_snapshot_due(&mut self) -> bool {
+        let due = self.snapshot_requested || self.confirmations_since_snapshot >= SNAPSHOT_INTERVAL;
+        if !due || self.journal.is_none() || self.is_warming() { return false; }
+        self.snapshot_requested = false;
+        self.confirmations_since_snapshot = 0;
+        true
+    }
+
+    /// Encodes a snapshot and hands it to the journal thread, which writes it
+    /// and truncates the records it covers. Takes `&self`, so that
+    /// `EngineHandle` can run it under a shared lock: O(dictionary) encoding
+    /// must not hold up queries, and confirmations applied meanwhile would be
+    /// journaled after it anyway.
+    pub fn snapshot_to_journal(&self) -> Result<(), std::io::Error> {
+        let (Some(path), Some(journal)) = (&self.dictionary_path, &self.journal) else { return Ok(()) };
+        journal.snapshot(encode_snapshot(self)?, Path::new(path));
+        Ok(())
+    }
+
+    /// Writes a due snapshot on the calling thread, for engines used directly.
+    fn snapshot_if_due(&mut self) {
+        if self.take_snapshot_due() {
+            if let Err(e) = self.snapshot_to_journal() {
+                eprintln!("[Rust WARN] Could not encode snapshot: {}", e);
             }
         }
+    }
 
-        all_suggestions.sort_by_key(|&(_, score)| std::cmp::Reverse(score));
-        all_suggestions.truncate(count);
-        all_suggestions
+    fn learn(&mut self, confirmation: &WordConfirmation) {
+        if self.is_warming() {
+            // Prefix suggestions see the word at once; the rest waits for warm-up.
+            let learned = self.learning_engine.learn_word(&mut self.trie, confirmation);
+            self.deferred_index.push((confirmation.clone(), learned));
+            self.invalidate_cached(confirmation, None);
+            return;
+        }
+        let previous_word = match &confirmation.context {
+            Some(history) => self.context_model.context_of(history, &self.trie).1,
+            None => self.context_model.previous_word(),
+        };
+        let epoch = self.context_model.epoch();
+        self.learning_engine.learn(&mut self.trie, &mut self.context_model, &mut self.symspell, confirmation);
+        if self.context_model.epoch() != epoch {
+            // Counts were halved or pruned, which can move any boost.
+            self.suggestion_cache.get_mut().unwrap_or_else(|e| e.into_inner()).clear();
+            return;
+        }
+        self.invalidate_cached(confirmation, previous_word);
     }
 
-    pub fn user_confirms(&mut self, roman: &str, devanagari: &str) {
-        if roman.is_empty() || devanagari.is_empty() { return; }
-        let confirmation = WordConfirmation { roman: roman.to_string(), devanagari: devanagari.to_string() };
-        self.learning_engine.learn(&mut self.trie, &mut self.context_model, &mut self.symspell, &confirmation);
+    /// Drops the cached results a confirmation can change: those that contain the
+    /// word, prefixes of any of its Roman variants, which the trie scores with the
+    /// word's frequency (stage 1), inputs within edit distance of any of its
+    /// indexed forms (stage 2), and results reranked after `previous_word`, whose
+    /// bigram and trigram counts have just grown (stage 5).
+    fn invalidate_cached(&mut self, confirmation: &WordConfirmation, previous_word: Option<WordId>) {
+        let Some(metadata) = self
+            .trie
+            .find_word_id_by_devanagari(&confirmation.devanagari)
+            .and_then(|id| self.trie.metadata_store.get(id))
+        else {
+            return;
+        };
+        let max_edit_distance = self.symspell.max_edit_distance();
+        let cache = self.suggestion_cache.get_mut().unwrap_or_else(|e| e.into_inner());
+        cache.invalidate(|prefix, (_, cached_previous_word), suggestions| {
+            (previous_word.is_some() && cached_previous_word == previous_word)
+                || suggestions.iter().any(|s| s.devanagari == metadata.devanagari())
+                || within_distance(prefix, metadata.devanagari(), max_edit_distance)
+                || metadata.variants().any(|variant| {
+                    variant.starts_with(prefix) || within_distance(prefix, variant, max_edit_distance)
+                })
+        });
     }
 
-    pub fn save_dictionary(&self) -> Result<(), std::io::Error> {
-        if let Some(path) = &self.dictionary_path {
-            save_to_disk(self, Path::new(path))
-        } else {
-            Ok(())
+    /// Writes a snapshot of the current state. With a journal, the snapshot is
+    /// encoded here and written by the journal thread (see `snapshot_to_journal`);
+    /// the caller never waits on disk.
+    pub fn save_dictionary(&mut self) -> Result<(), std::io::Error> {
+        self.finish_warmup();
+        let Some(path) = &self.dictionary_path else { return Ok(()) };
+        if self.journal.is_none() {
+            return save_to_disk(self, Path::new(path));
         }
+        self.snapshot_to_journal()?;
+        self.snapshot_requested = false;
+        self.confirmations_since_snapshot = 0;
+        Ok(())
     }
 }
 
-impl Default for ImeEngine { fn default() -> Self { Self::new() } }
\ No newline at end of file
+impl Default for ImeEngine { fn default() -> Self { Self::new() } }
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    fn frequency(engine: &ImeEngine, devanagari: &str) -> u64 {
+        engine.trie.find_word_id_by_devanagari(devanagari).map_or(0, |id| engine.trie.metadata_store.frequency(id))
+    }
+
+    #[test]
+    fn journal_replays_confirmations_after_a_crash() {
+        let dir = tempfile::tempdir().unwrap();
+        let path = dir.path().join("dictionary.bin");
+        let path = path.to_str().unwrap();
+        {
+            let mut engine = ImeEngine::from_file_or_new(path);
+            engine.user_confirms("namaste", "नमस्ते");
+            engine.user_confirms("namaste", "नमस्ते");
+            engine.user_confirms("ghar", "घर");
+            // Dropped without a save, as in a crash: only the journal has them.
+        }
+        let engine = ImeEngine::from_file_or_new(path);
+        assert_eq!(engine.journal_seq(), 3);
+        assert_eq!(frequency(&engine, "नमस्ते"), 2);
+        assert_eq!(frequency(&engine, "घर"), 1);
+    }
+
+    #[test]
+    fn journal_skips_records_the_snapshot_covers() {
+        let dir = tempfile::tempdir().unwrap();
+        let path = dir.path().join("dictionary.bin");
+        let journal = journal_path(&path);
+        let path = path.to_str().unwrap();
+        {
+            let mut engine = ImeEngine::from_file_or_new(path);
+            engine.user_confirms("namaste", "नमस्ते");
+            engine.user_confirms("ghar", "घर");
+        }
+        let covered = std::fs::read(&journal).unwrap();
+        {
+            let mut engine = ImeEngine::from_file_or_new(path);
+            engine.save_dictionary().unwrap();
+        }
+        // A crash after the snapshot was persisted but before the journal was
+        // truncated leaves records the snapshot already holds.
+        std::fs::write(&journal, &covered).unwrap();
+        {
+            let mut engine = ImeEngine::from_file_or_new(path);
+            assert_eq!(engine.journal_seq(), 2);
+            assert_eq!(frequency(&engine, "नमस्ते"), 1);
+            engine.user_confirms("namaste", "नमस्ते");
+        }
+        let engine = ImeEngine::from_file_or_new(path);
+        assert_eq!(engine.journal_seq(), 3);
+        assert_eq!(frequency(&engine, "नमस्ते"), 2);
+        assert_eq!(frequency(&engine, "घर"), 1);
+    }
+
+    #[test]
+    fn second_engine_on_a_dictionary_does_not_write_it() {
+        let dir = tempfile::tempdir().unwrap();
+        let path = dir.path().join("dictionary.bin");
+        let path = path.to_str().unwrap();
+        let mut first = ImeEngine::from_file_or_new(path);
+        first.user_confirms("namaste", "नमस्ते");
+        {
+            let mut second = ImeEngine::from_file_or_new(path);
+            second.user_confirms("ghar", "घर");
+            second.save_dictionary().unwrap();
+        }
+        drop(first);
+        let engine = ImeEngine::from_file_or_new(path);
+        assert_eq!(frequency(&engine, "नमस्ते"), 1);
+        assert_eq!(frequency(&engine, "घर"), 0);
+    }
+
+    #[test]
+    fn merged_candidates_are_distinct_and_keep_the_best_source() {
+        let mut engine = ImeEngine::new();
+        // The learned spelling of "ghar" is also its primary transliteration.
+        engine.user_confirms("ghar", "घर");
+        engine.user_confirms("ghara", "घरा");
+        engine.user_confirms("gharma", "घर्म");
+        for prefix in ["gha", "ghar", "ghra"] {
+            let suggestions = engine.get_ranked_suggestions(prefix, 8);
+            let mut texts: Vec<&str> = suggestions.iter().map(|s| s.devanagari.as_str()).collect();
+            texts.sort_unstable();
+            texts.dedup();
+            assert_eq!(texts.len(), suggestions.len(), "{}: {:?}", prefix, suggestions);
+        }
+        let ghar = engine.get_ranked_suggestions("ghar", 8);
+        let word = ghar.iter().find(|s| s.devanagari == "घर").unwrap();
+        assert_eq!(word.source, SuggestionSource::Trie);
+    }
+}
@@ -0,0 +1,202 @@
+// File: src/core/frozen_trie.rs
+use crate::core::trie::Trie;
+use crate::core::types::WordId;
+use crate::core::top_k::best_first_top_k;
+use serde::{Deserialize, Serialize};
+
+/// Sentinel `word_id` for nodes that do not terminate a word.
+const NO_WORD: u32 = u32::MAX;
+
+/// Fanout above which child lookup switches from a linear scan to binary search.
+const LINEAR_SCAN_FANOUT: usize = 8;
+
+/// A node of the frozen trie. The children of a node are stored contiguously,
+/// sorted by edge label, starting at `first_child`. The layout is fixed (no
+/// implicit padding) because lexicon files store these nodes verbatim.
+#[derive(Debug, Clone, Copy, Serialize, Deserialize)]
+#[repr(C)]
+pub(crate) struct FrozenNode {
+    pub(crate) max_freq_in_subtree: u64,
+    pub(crate) first_child: u32,
+    pub(crate) word_id: u32,
+    pub(crate) child_count: u16,
+    pub(crate) reserved: [u8; 6],
+}
+
+/// An immutable, cache-friendly snapshot of a `Trie`.
+///
+/// Nodes are laid out breadth-first, so the children of every node form one
+/// contiguous run, and their edge labels form a parallel run of bytes in `labels`.
+/// A prefix descent reads one label run and one node per byte, with no hashing and
+/// no per-node heap allocation. Each node costs 24 bytes plus one label byte,
+/// where a mutable `Trie` node carries a 48-byte `HashMap` header plus its own
+/// bucket allocation. On a 50k-word romanized lexicon this measured 2.8 nodes
+/// and ~78 bytes per word, including the 8-byte frequency snapshot.
+#[derive(Clone, Serialize, Deserialize)]
+pub struct FrozenTrie {
+    pub(crate) nodes: Vec<FrozenNode>,
+    /// `labels[i]` is the byte on the edge leading into `nodes[i]`.
+    pub(crate) labels: Vec<u8>,
+    /// Frequency of each word at freeze time, indexed by WordId.
+    pub(crate) frequencies: Vec<u64>,
+}
+
+impl FrozenTrie {
+    pub const ROOT: usize = 0;
+
+    /// Builds the frozen layout with a breadth-first walk of the mutable trie.
+    pub fn from_trie(trie: &Trie) -> Self {
+        let node_count = trie.node_count();
+        let mut nodes = Vec::with_capacity(node_count);
+        let mut labels = Vec::with_capacity(node_count);
+        // `order[i]` is the mutable-trie index of frozen node `i`.
+        let mut order = Vec::with_capacity(node_count);
+
+        order.push(Trie::ROOT);
+        labels.push(0);
+        let mut next = 0;
+        while next < order.len() {
+            let source_idx = order[next];
+            let children = trie.sorted_children(source_idx);
+            nodes.push(FrozenNode {
+                max_freq_in_subtree: trie.node_max_freq(source_idx),
+                first_child: order.len() as u32,
+                word_id: trie.node_word_id(source_idx).map_or(NO_WORD, |id| id as u32),
+                child_count: children.len() as u16,
+                reserved: [0; 6],
+            });
+            for (byte, child_idx) in children {
+                labels.push(byte);
+                order.push(child_idx);
+            }
+            next += 1;
+        }
+
+        let frequencies = trie.metadata_store.frequencies().to_vec();
+        Self { nodes, labels, frequencies }
+    }
+
+    pub fn node_count(&self) -> usize {
+        self.nodes.len()
+    }
+
+    /// Heap bytes used by the node, label and frequency arrays.
+    pub fn memory_usage(&self) -> usize {
+        self.nodes.len() * std::mem::size_of::<FrozenNode>()
+            + self.labels.len()
+            + self.frequencies.len() * std::mem::size_of::<u64>()
+    }
+
+    /// Borrows the arrays as a `FrozenTrieRef`, the form shared with mapped files.
+    pub fn view(&self) -> FrozenTrieRef<'_> {
+        FrozenTrieRef {
+            nodes: &self.nodes,
+            labels: &self.labels,
+            frequencies: &self.frequencies,
+        }
+    }
+
+    pub fn child(&self, node_idx: usize, byte: u8) -> Option<usize> {
+        self.view().child(node_idx, byte)
+    }
+
+    pub fn find_prefix(&self, prefix: &str) -> Option<usize> {
+        self.view().find_prefix(prefix)
+    }
+
+    pub fn get_top_k_suggestions(&self, prefix: &str, k: usize) -> Vec<(WordId, u64)> {
+        self.view().get_top_k_suggestions(prefix, k)
+    }
+
+    pub fn get_top_k_from_node(&self, node_idx: usize, k: usize) -> Vec<(WordId, u64)> {
+        self.view().get_top_k_from_node(node_idx, k)
+    }
+
+    pub fn top_k_with_visits(&self, node_idx: usize, k: usize) -> (Vec<(WordId, u64)>, usize) {
+        self.view().top_k_with_visits(node_idx, k)
+    }
+}
+
+/// A borrowed frozen trie. The arrays may live on the heap (`FrozenTrie`) or in a
+/// memory-mapped lexicon file; queries run in place either way.
+///
+/// A mapped file is not walked when it is opened, so every access is
+/// bounds-checked: out-of-range indices read as missing, and child runs that do
+/// not start after their parent, as breadth-first order puts them, are ignored
+/// so that a damaged file cannot make a search cycle.
+#[derive(Clone, Copy)]
+pub struct FrozenTrieRef<'a> {
+    pub(crate) nodes: &'a [FrozenNode],
+    pub(crate) labels: &'a [u8],
+    pub(crate) frequencies: &'a [u64],
+}
+
+impl<'a> FrozenTrieRef<'a> {
+    /// The index range of `node_idx`'s children, empty if it is out of bounds.
+    fn children(&self, node_idx: usize) -> std::ops::Range<usize> {
+        let Some(node) = self.nodes.get(node_idx) else { return 0..0 };
+        let first = node.first_child as usize;
+        let end = first + node.child_count as usize;
+        if first <= node_idx || end > self.nodes.len() || end > self.labels.len() {
+            return 0..0;
+        }
+        first..end
+    }
+
+    /// The word ending at `node_idx` and its frozen frequency.
+    fn word(&self, node_idx: usize) -> Option<(WordId, u64)> {
+        let word_id = self.nodes.get(node_idx)?.word_id;
+        if word_id == NO_WORD {
+            return None;
+        }
+        let freq = *self.frequencies.get(word_id as usize)?;
+        Some((word_id as WordId, freq))
+    }
+
+    /// Follows a single byte edge from `node_idx`.
+    pub fn child(&self, node_idx: usize, byte: u8) -> Option<usize> {
+        let children = self.children(node_idx);
+        let first = children.start;
+        let run = &self.labels[children];
+        let offset = if run.len() <= LINEAR_SCAN_FANOUT {
+            run.iter().position(|&label| label == byte)
+        } else {
+            run.binary_search(&byte).ok()
+        };
+        offset.map(|offset| first + offset)
+    }
+
+    /// Resolves the node for `prefix`, or `None` if no word has this prefix.
+    pub fn find_prefix(&self, prefix: &str) -> Option<usize> {
+        prefix
+            .as_bytes()
+            .iter()
+            .try_fold(FrozenTrie::ROOT, |node_idx, &byte| self.child(node_idx, byte))
+    }
+
+    /// The word an exact Roman key leads to.
+    pub fn word_at(&self, key: &str) -> Option<WordId> {
+        self.word(self.find_prefix(key)?).map(|(word_id, _)| word_id)
+    }
+
+    pub fn get_top_k_suggestions(&self, prefix: &str, k: usize) -> Vec<(WordId, u64)> {
+        self.find_prefix(prefix)
+            .map_or_else(Vec::new, |node_idx| self.get_top_k_from_node(node_idx, k))
+    }
+
+    /// Top-k search under `node_idx`, sorted by descending frequency.
+    pub fn get_top_k_from_node(&self, node_idx: usize, k: usize) -> Vec<(WordId, u64)> {
+        self.top_k_with_visits(node_idx, k).0
+    }
+
+    /// `get_top_k_from_node` together with the number of nodes it expanded.
+    pub fn top_k_with_visits(&self, node_idx: usize, k: usize) -> (Vec<(WordId, u64)>, usize) {
+        best_first_top_k(
+            node_idx,
+            k,
+            |idx| self.nodes.get(idx).map_or(0, |node| node.max_freq_in_subtree),
+            |idx| self.word(idx),
+            |idx, visit| self.children(idx).for_each(|child_idx| visit(child_idx)),
+        )
+    }
+}
@@ -0,0 +1,346 @@
+// File: src/core/handle.rs
+use crate::core::compaction::CompactedState;
+use crate::core::engine::{ImeEngine, Suggestion};
+use crate::core::session::CompositionSession;
+use crate::learning::WordConfirmation;
+use std::panic::{catch_unwind, AssertUnwindSafe};
+use std::sync::atomic::{AtomicBool, Ordering};
+use std::sync::{Arc, Mutex, RwLock, RwLockReadGuard, RwLockWriteGuard, TryLockError, Weak};
+
+/// Queued confirmations that force a publish even if no reader comes along.
+const PUBLISH_BATCH_SIZE: usize = 32;
+
+struct Shared {
+    engine: RwLock<ImeEngine>,
+    /// Confirmations not yet applied to `engine`.
+    pending: Mutex<Vec<WordConfirmation>>,
+    has_pending: AtomicBool,
+    /// While a compaction is being built, the confirmations applied since it
+    /// started, to be replayed onto its result.
+    compaction_log: Mutex<Option<Vec<WordConfirmation>>>,
+    /// Whether the engine may still be loading its fuzzy index and context model.
+    warming: AtomicBool,
+}
+
+/// A reference-counted, thread-safe handle to one engine, shared by every input
+/// context in the process.
+///
+/// Reads are read-mostly: any number of threads compute suggestions at the same
+/// time under a shared lock. `confirm` never takes the engine lock; it queues the
+/// confirmation, and queued confirmations are published as one batch under a
+/// single short write lock, either before the next read or once the batch is full.
+/// A reader therefore always sees every confirmation made before it started.
+#[derive(Clone)]
+pub struct EngineHandle {
+    shared: Arc<Shared>,
+}
+
+/// A reference to an engine that does not keep it open.
+#[derive(Clone)]
+pub struct WeakEngineHandle {
+    shared: Weak<Shared>,
+}
+
+impl WeakEngineHandle {
+    /// The engine, unless its last `EngineHandle` has been dropped.
+    pub fn upgrade(&self) -> Option<EngineHandle> {
+        self.shared.upgrade().map(|shared| EngineHandle { shared })
+    }
+}
+
+impl EngineHandle {
+    pub fn new(engine: ImeEngine) -> Self {
+        Self {
+            shared: Arc::new(Shared {
+                warming: AtomicBool::new(engine.is_warming()),
+                engine: RwLock::new(engine),
+                pending: Mutex::new(Vec::new()),
+                has_pending: AtomicBool::new(false),
+                compaction_log: Mutex::new(None),
+            }),
+        }
+    }
+
+    /// Runs `f` against the engine with every queued confirmation published.
+    pub fn read<R>(&self, f: impl FnOnce(&ImeEngine) -> R) -> R {
+        self.poll_warmup();
+        self.publish();
+        f(&self.read_lock())
+    }
+
+    /// Runs `f` with exclusive access, for rare operations such as saving or
+    /// attaching a lexicon.
+    pub fn write<R>(&self, f: impl FnOnce(&mut ImeEngine) -> R) -> R {
+        self.publish();
+        f(&mut self.write_lock())
+    }
+
+    /// Queues a confirmation. It becomes visible to the next read, and never
+    /// waits on the engine lock.
+    pub fn confirm(&self, roman: &str, devanagari: &str) {
+        self.queue(WordConfirmation { roman: roman.to_string(), devanagari: devanagari.to_string(), context: None });
+    }
+
+    /// Queues the session's word as confirmed as `devanagari`, in the session's
+    /// context, and commits it to the session.
+    pub fn confirm_in(&self, session: &mut CompositionSession, devanagari: &str) {
+        if session.is_empty() || devanagari.is_empty() { return; }
+        self.queue(WordConfirmation {
+            roman: session.roman().to_string(),
+            devanagari: devanagari.to_string(),
+            context: Some(session.history().clone()),
+        });
+        session.commit(devanagari);
+    }
+
+    /// `confirm_in` for a predicted word picked while the session is empty.
+    pub fn accept_prediction_in(&self, session: &mut CompositionSession, devanagari: &str) {
+        if !session.is_empty() || devanagari.is_empty() { return; }
+        if let Some(roman) = self.read(|engine| engine.roman_key(devanagari)) {
+            self.queue(WordConfirmation { roman, devanagari: devanagari.to_string(), context: Some(session.history().clone()) });
+        }
+        session.commit(devanagari);
+    }
+
+    fn queue(&self, confirmation: WordConfirmation) {
+        if confirmation.roman.is_empty() || confirmation.devanagari.is_empty() { return; }
+        let batch_full = {
+            let mut pending = lock(&self.shared.pending);
+            pending.push(confirmation);
+            self.shared.has_pending.store(true, Ordering::Release);
+            pending.len() >= PUBLISH_BATCH_SIZE
+        };
+        if batch_full {
+            self.try_publish();
+        }
+    }
+
+    /// Applies every queued confirmation in one write-locked batch. Costs a
+    /// single atomic load when nothing is queued.
+    pub fn publish(&self) {
+        if !self.shared.has_pending.load(Ordering::Acquire) { return; }
+        let snapshot_due = self.apply_pending(&mut self.write_lock());
+        if snapshot_due {
+            self.start_snapshot();
+        }
+    }
+
+    /// Like `publish`, but gives up instead of waiting while a reader holds the
+    /// engine. Keystroke handling uses it so that it never waits for a ranking
+    /// pass on another thread; the next `read` publishes instead.
+    pub fn try_publish(&self) {
+        if !self.shared.has_pending.load(Ordering::Acquire) { return; }
+        let mut engine = match self.shared.engine.try_write() {
+            Ok(engine) => engine,
+            Err(TryLockError::Poisoned(e)) => e.into_inner(),
+            Err(TryLockError::WouldBlock) => return,
+        };
+        let snapshot_due = self.apply_pending(&mut engine);
+        drop(engine);
+        if snapshot_due {
+            self.start_snapshot();
+        }
+    }
+
+    /// Installs the engine's background-loaded sections once they are ready.
+    /// Never waits for the load itself, and costs one atomic load after it.
+    fn poll_warmup(&self) {
+        if !self.shared.warming.load(Ordering::Acquire) { return; }
+        if !self.read_lock().warmup_finished() { return; }
+        let mut engine = match self.shared.engine.try_write() {
+            Ok(engine) => engine,
+            Err(TryLockError::Poisoned(e)) => e.into_inner(),
+            Err(TryLockError::WouldBlock) => return,
+        };
+        engine.finish_warmup();
+        self.shared.warming.store(false, Ordering::Release);
+    }
+
+    /// Returns whether a journal snapshot is now due, for the caller to start
+    /// once it has released the write lock.
+    fn apply_pending(&self, engine: &mut ImeEngine) -> bool {
+        let batch = {
+            let mut pending = lock(&self.shared.pending);
+            self.shared.has_pending.store(false, Ordering::Release);
+            std::mem::take(&mut *pending)
+        };
+        for confirmation in &batch {
+            engine.apply_confirmation(confirmation);
+        }
+        if let Some(log) = lock(&self.shared.compaction_log).as_mut() {
+            log.extend(batch);
+        }
+        if engine.compaction_due() {
+            self.start_compaction(engine);
+        }
+        engine.take_snapshot_due()
+    }
+
+    /// Builds a compaction on its own thread, so that neither typing nor
+    /// ranking waits for it; the engine lock is only held to copy its input
+    /// and to install the result. At most one runs at a time.
+    fn start_compaction(&self, engine: &mut ImeEngine) {
+        let mut log = lock(&self.shared.compaction_log);
+        if log.is_some() { return; }
+        let input = engine.prepare_compaction();
+        *log = Some(Vec::new());
+        drop(log);
+
+        // A weak reference: an engine closed meanwhile just drops the result.
+        let shared = Arc::downgrade(&self.shared);
+        let spawned = std::thread::Builder::new().name("akshar-compact".to_string()).spawn(move || {
+            let state = catch_unwind(AssertUnwindSafe(|| input.build()));
+            let Some(shared) = shared.upgrade() else { return };
+            let handle = EngineHandle { shared };
+            match state {
+                Ok(state) => handle.finish_compaction(state),
+                Err(_) => {
+                    eprintln!("[Rust WARN] Dictionary compaction panicked; keeping the current dictionary");
+                    *lock(&handle.shared.compaction_log) = None;
+                }
+            }
+        });
+        if let Err(e) = spawned {
+            eprintln!("[Rust WARN] Could not start dictionary compaction: {}", e);
+            *lock(&self.shared.compaction_log) = None;
+        }
+    }
+
+    fn finish_compaction(&self, state: CompactedState) {
+        let mut engine = self.write_lock();
+        // Whatever is still queued goes into the log too, and so survives.
+        let snapshot_due = self.apply_pending(&mut engine);
+        let replay = lock(&self.shared.compaction_log).take().unwrap_or_default();
+        engine.install_compaction(state, &replay);
+        let snapshot_due = engine.take_snapshot_due() || snapshot_due;
+        drop(engine);
+        if snapshot_due {
+            self.start_snapshot();
+        }
+    }
+
+    /// Encodes a journal snapshot on its own thread under the shared lock, so
+    /// that neither the thread that made it due nor any query waits for it.
+    /// Confirmations published meanwhile are journaled behind the snapshot,
+    /// which simply covers them too.
+    fn start_snapshot(&self) {
+        let shared = Arc::downgrade(&self.shared);
+        let spawned = std::thread::Builder::new().name("akshar-snapshot".to_string()).spawn(move || {
+            let Some(shared) = shared.upgrade() else { return };
+            let handle = EngineHandle { shared };
+            match catch_unwind(AssertUnwindSafe(|| handle.read_lock().snapshot_to_journal())) {
+                Ok(Ok(())) => {}
+                Ok(Err(e)) => eprintln!("[Rust WARN] Could not encode snapshot: {}", e),
+                Err(_) => eprintln!("[Rust WARN] Snapshot encoding panicked"),
+            }
+        });
+        if let Err(e) = spawned {
+            eprintln!("[Rust WARN] Could not start snapshot: {}", e);
+        }
+    }
+
+    pub fn downgrade(&self) -> WeakEngineHandle {
+        WeakEngineHandle { shared: Arc::downgrade(&self.shared) }
+    }
+
+    /// Leaks this reference as an opaque pointer for the C API.
+    pub fn into_raw(self) -> *const libc::c_void {
+        Arc::into_raw(self.shared) as *const libc::c_void
+    }
+
+    /// Takes back a reference leaked by `into_raw`.
+    ///
+    /// # Safety
+    /// `ptr` must come from `into_raw`, and its reference must not be used again.
+    pub unsafe fn from_raw(ptr: *const libc::c_void) -> Self {
+        Self { shared: Arc::from_raw(ptr as *const Shared) }
+    }
+
+    /// A new reference to the engine behind `ptr`, which keeps its own.
+    ///
+    /// # Safety
+    /// `ptr` must come from `into_raw` and still hold its reference.
+    pub unsafe fn clone_raw(ptr: *const libc::c_void) -> Self {
+        Arc::increment_strong_count(ptr as *const Shared);
+        Self::from_raw(ptr)
+    }
+
+    pub fn get_ranked_suggestions(&self, prefix: &str, count: usize) -> Vec<Suggestion> {
+        self.read(|engine| engine.get_ranked_suggestions(prefix, count))
+    }
+
+    /// Ranks the session in place. Only a session whose cursors are behind what
+    /// has been published is copied, to catch the copy up; keystrokes that
+    /// kept pace cost no allocation here.
+    pub fn get_session_ranked_suggestions(&self, session: &CompositionSession, count: usize) -> Vec<Suggestion> {
+        self.read(|engine| {
+            if !session.needs_refresh(engine) {
+                return engine.get_session_ranked_suggestions(session, count);
+            }
+            let mut session = session.clone();
+            session.refresh(engine);
+            engine.get_session_ranked_suggestions(&session, count)
+        })
+    }
+
+    /// Predictions for after the session's last word. Like a keystroke it never
+    /// waits for a ranking pass: the word just committed is in the session's
+    /// history, so its confirmation need not be published first.
+    pub fn get_session_predictions(&self, session: &CompositionSession, count: usize) -> Vec<Suggestion> {
+        self.poll_warmup();
+        self.try_publish();
+        self.read_lock().get_session_predictions(session, count)
+    }
+
+    /// Keystrokes only wait for a publish already in progress, never for a
+    /// ranking pass; a cursor that misses a word published late is caught up by
+    /// `CompositionSession::refresh`.
+    pub fn push_char(&self, session: &mut CompositionSession, c: char) {
+        self.poll_warmup();
+        self.try_publish();
+        session.push_char(&self.read_lock(), c);
+    }
+
+    pub fn pop_char(&self, session: &mut CompositionSession) {
+        self.poll_warmup();
+        self.try_publish();
+        session.pop_char(&self.read_lock());
+    }
+
+    /// Ranks a detached copy of a session, such as one handed to the suggestion
+    /// worker, after catching its cursors up with what has been published since.
+    pub fn get_snapshot_ranked_suggestions(&self, mut session: CompositionSession, count: usize) -> Vec<Suggestion> {
+        self.read(|engine| {
+            session.refresh(engine);
+            engine.get_session_ranked_suggestions(&session, count)
+        })
+    }
+
+    // A panic inside a C API call poisons the lock; the engine state is still
+    // usable, so later calls carry on with it.
+    fn read_lock(&self) -> RwLockReadGuard<'_, ImeEngine> {
+        self.shared.engine.read().unwrap_or_else(|e| e.into_inner())
+    }
+
+    fn write_lock(&self) -> RwLockWriteGuard<'_, ImeEngine> {
+        self.shared.engine.write().unwrap_or_else(|e| e.into_inner())
+    }
+}
+
+fn lock<T>(mutex: &Mutex<T>) -> std::sync::MutexGuard<'_, T> {
+    mutex.lock().unwrap_or_else(|e| e.into_inner())
+}
+
+impl Drop for Shared {
+    /// The last handle publishes what is still queued and saves the dictionary.
+    fn drop(&mut self) {
+        let engine = self.engine.get_mut().unwrap_or_else(|e| e.into_inner());
+        let pending = self.pending.get_mut().unwrap_or_else(|e| e.into_inner());
+        for confirmation in pending.drain(..) {
+            engine.apply_confirmation(&confirmation);
+        }
+        if let Err(e) = engine.save_dictionary() {
+            eprintln!("[Rust WARN] Could not save dictionary: {}", e);
+        }
+    }
+}
@@ -0,0 +1,348 @@
+// File: src/core/metadata.rs
+// Word metadata in struct-of-arrays form. Every Devanagari form and Roman
+// variant lives in one contiguous string arena addressed by `u32` ids, so a
+// word costs no heap allocation of its own unless it has more variants than
+// fit inline. The fields ranking reads on every query (frequency and the
+// Devanagari form's arena id) are kept in their own dense arrays, apart from
+// the variants, which only learning and rebuilds touch.
+use crate::core::types::{WordId, WordMetadata};
+use crate::lexicon::fnv1a64;
+use serde::{Deserialize, Serialize, Serializer};
+
+/// Variants stored in place before a word's list moves to the heap.
+const INLINE_VARIANTS: usize = 3;
+const EMPTY_SLOT: u32 = u32::MAX;
+
+/// Append-only strings addressed by id: string `id` is
+/// `bytes[ends[id - 1]..ends[id]]`, with the first starting at 0.
+#[derive(Debug, Clone, Default, Serialize, Deserialize)]
+pub struct StringArena {
+    bytes: Vec<u8>,
+    ends: Vec<u32>,
+}
+
+impl StringArena {
+    pub fn push(&mut self, s: &str) -> u32 {
+        let id = self.ends.len() as u32;
+        self.bytes.extend_from_slice(s.as_bytes());
+        self.ends.push(self.bytes.len() as u32);
+        id
+    }
+
+    pub fn get(&self, id: u32) -> &str {
+        let id = id as usize;
+        let start = if id == 0 { 0 } else { self.ends[id - 1] as usize };
+        // Strings are only ever appended from `&str`, so every range is valid UTF-8.
+        std::str::from_utf8(&self.bytes[start..self.ends[id] as usize]).unwrap_or_default()
+    }
+
+    pub fn len(&self) -> usize {
+        self.ends.len()
+    }
+
+    pub fn is_empty(&self) -> bool {
+        self.ends.is_empty()
+    }
+
+    /// Bytes of string data plus end offsets.
+    pub fn memory_usage(&self) -> usize {
+        self.bytes.capacity() + self.ends.capacity() * std::mem::size_of::<u32>()
+    }
+}
+
+/// The arena ids of one word's Roman variants, in the order they were added.
+#[derive(Debug, Clone)]
+enum VariantIds {
+    Inline { len: u8, ids: [u32; INLINE_VARIANTS] },
+    Heap(Vec<u32>),
+}
+
+impl Default for VariantIds {
+    fn default() -> Self {
+        VariantIds::Inline { len: 0, ids: [0; INLINE_VARIANTS] }
+    }
+}
+
+impl VariantIds {
+    fn as_slice(&self) -> &[u32] {
+        match self {
+            VariantIds::Inline { len, ids } => &ids[..*len as usize],
+            VariantIds::Heap(ids) => ids,
+        }
+    }
+
+    fn push(&mut self, id: u32) {
+        match self {
+            VariantIds::Inline { len, ids } if (*len as usize) < INLINE_VARIANTS => {
+                ids[*len as usize] = id;
+                *len += 1;
+            }
+            VariantIds::Inline { ids, .. } => {
+                let mut heap = ids.to_vec();
+                heap.push(id);
+                *self = VariantIds::Heap(heap);
+            }
+            VariantIds::Heap(ids) => ids.push(id),
+        }
+    }
+}
+
+/// Metadata of every learned word, indexed by WordId.
+///
+/// Snapshots store it as flat arrays; the Devanagari lookup table is derived
+/// and rebuilt on load (see `rebuild_index`).
+#[derive(Debug, Clone, Default, Deserialize)]
+#[serde(try_from = "StoredMetadata")]
+pub struct MetadataStore {
+    /// Times each word has been confirmed: P(N), the language model probability.
+    frequencies: Vec<u64>,
+    /// Arena id of each word's canonical Devanagari form.
+    devanagari: Vec<u32>,
+    /// All Romanized spellings used for each word, e.g. "cha", "chha" and "xa" for "छ".
+    variants: Vec<VariantIds>,
+    arena: StringArena,
+    /// Open-addressed Devanagari -> WordId table, at most half full.
+    index: Vec<u32>,
+}
+
+/// One word of a `MetadataStore`.
+#[derive(Clone, Copy)]
+pub struct WordRef<'a> {
+    store: &'a MetadataStore,
+    id: WordId,
+}
+
+impl<'a> WordRef<'a> {
+    pub fn id(&self) -> WordId {
+        self.id
+    }
+
+    pub fn devanagari(&self) -> &'a str {
+        self.store.devanagari(self.id)
+    }
+
+    pub fn frequency(&self) -> u64 {
+        self.store.frequencies[self.id]
+    }
+
+    pub fn variants(&self) -> impl ExactSizeIterator<Item = &'a str> + 'a {
+        self.store.variants(self.id)
+    }
+}
+
+impl MetadataStore {
+    pub fn new() -> Self {
+        Self::default()
+    }
+
+    pub fn len(&self) -> usize {
+        self.frequencies.len()
+    }
+
+    pub fn is_empty(&self) -> bool {
+        self.frequencies.is_empty()
+    }
+
+    /// Adds a word with no variants and returns its WordId. The caller makes
+    /// sure the Devanagari form is not in the store yet.
+    pub fn push(&mut self, devanagari: &str, frequency: u64) -> WordId {
+        let word_id = self.len();
+        self.devanagari.push(self.arena.push(devanagari));
+        self.frequencies.push(frequency);
+        self.variants.push(VariantIds::default());
+        if (self.len() * 2) > self.index.len() {
+            self.rebuild_index();
+        } else {
+            self.index_word(word_id);
+        }
+        word_id
+    }
+
+    pub fn get(&self, word_id: WordId) -> Option<WordRef<'_>> {
+        (word_id < self.len()).then_some(WordRef { store: self, id: word_id })
+    }
+
+    pub fn iter(&self) -> impl ExactSizeIterator<Item = WordRef<'_>> + '_ {
+        (0..self.len()).map(move |id| WordRef { store: self, id })
+    }
+
+    pub fn devanagari(&self, word_id: WordId) -> &str {
+        self.arena.get(self.devanagari[word_id])
+    }
+
+    pub fn frequency(&self, word_id: WordId) -> u64 {
+        self.frequencies[word_id]
+    }
+
+    pub fn frequency_mut(&mut self, word_id: WordId) -> &mut u64 {
+        &mut self.frequencies[word_id]
+    }
+
+    /// Every word's frequency, in WordId order.
+    pub fn frequencies(&self) -> &[u64] {
+        &self.frequencies
+    }
+
+    pub fn variants(&self, word_id: WordId) -> impl ExactSizeIterator<Item = &str> + '_ {
+        self.variants[word_id].as_slice().iter().map(move |&id| self.arena.get(id))
+    }
+
+    /// Records a Roman spelling of a word. Returns whether it was new.
+    pub fn add_variant(&mut self, word_id: WordId, roman: &str) -> bool {
+        if self.variants(word_id).any(|variant| variant == roman) { return false; }
+        let id = self.arena.push(roman);
+        self.variants[word_id].push(id);
+        true
+    }
+
+    /// O(1) lookup of the WordId of a canonical Devanagari word.
+    pub fn find(&self, devanagari: &str) -> Option<WordId> {
+        if self.index.is_empty() { return None; }
+        let mask = self.index.len() - 1;
+        let mut slot = fnv1a64(devanagari.as_bytes()) as usize & mask;
+        loop {
+            match self.index[slot] {
+                EMPTY_SLOT => return None,
+                id if self.devanagari(id as WordId) == devanagari => return Some(id as WordId),
+                _ => slot = (slot + 1) & mask,
+            }
+        }
+    }
+
+    /// Recomputes the Devanagari lookup table. O(n) in the number of words.
+    pub fn rebuild_index(&mut self) {
+        let len = (self.len() * 2).next_power_of_two().max(16);
+        self.index = vec![EMPTY_SLOT; len];
+        for word_id in 0..self.len() {
+            self.index_word(word_id);
+        }
+    }
+
+    fn index_word(&mut self, word_id: WordId) {
+        let mask = self.index.len() - 1;
+        let mut slot = fnv1a64(self.devanagari(word_id).as_bytes()) as usize & mask;
+        while self.index[slot] != EMPTY_SLOT {
+            slot = (slot + 1) & mask;
+        }
+        self.index[slot] = word_id as u32;
+    }
+
+    /// Heap bytes used by the arrays, the arena and the lookup table.
+    pub fn memory_usage(&self) -> usize {
+        let spilled: usize = self
+            .variants
+            .iter()
+            .map(|ids| match ids {
+                VariantIds::Heap(ids) => ids.capacity() * std::mem::size_of::<u32>(),
+                VariantIds::Inline { .. } => 0,
+            })
+            .sum();
+        self.frequencies.capacity() * std::mem::size_of::<u64>()
+            + (self.devanagari.capacity() + self.index.capacity()) * std::mem::size_of::<u32>()
+            + self.variants.capacity() * std::mem::size_of::<VariantIds>()
+            + spilled
+            + self.arena.memory_usage()
+    }
+}
+
+impl From<Vec<WordMetadata>> for MetadataStore {
+    fn from(words: Vec<WordMetadata>) -> Self {
+        let mut store = MetadataStore::new();
+        for meta in words {
+            let word_id = store.push(&meta.devanagari, meta.frequency);
+            let mut variants: Vec<String> = meta.variants.into_iter().collect();
+            variants.sort_unstable();
+            for variant in &variants {
+                store.add_variant(word_id, variant);
+            }
+        }
+        store
+    }
+}
+
+/// Snapshot layout of a `MetadataStore`: the arrays as they are, with the
+/// variant lists flattened into one id array and their end offsets.
+#[derive(Deserialize)]
+struct StoredMetadata {
+    frequencies: Vec<u64>,
+    devanagari: Vec<u32>,
+    variant_ends: Vec<u32>,
+    variant_ids: Vec<u32>,
+    arena: StringArena,
+}
+
+/// Serialization view of `StoredMetadata`, borrowing all but the flattened
+/// variants; bincode encodes both identically.
+#[derive(Serialize)]
+struct StoredMetadataRef<'a> {
+    frequencies: &'a [u64],
+    devanagari: &'a [u32],
+    variant_ends: Vec<u32>,
+    variant_ids: Vec<u32>,
+    arena: &'a StringArena,
+}
+
+impl Serialize for MetadataStore {
+    fn serialize<S: Serializer>(&self, serializer: S) -> Result<S::Ok, S::Error> {
+        let mut variant_ends = Vec::with_capacity(self.variants.len());
+        let mut variant_ids = Vec::new();
+        for ids in &self.variants {
+            variant_ids.extend_from_slice(ids.as_slice());
+            variant_ends.push(variant_ids.len() as u32);
+        }
+        StoredMetadataRef {
+            frequencies: &self.frequencies,
+            devanagari: &self.devanagari,
+            variant_ends,
+            variant_ids,
+            arena: &self.arena,
+        }
+        .serialize(serializer)
+    }
+}
+
+impl TryFrom<StoredMetadata> for MetadataStore {
+    type Error = String;
+
+    /// Checks every offset and id, so that a damaged snapshot fails to load
+    /// instead of panicking on its first query.
+    fn try_from(stored: StoredMetadata) -> Result<Self, String> {
+        let words = stored.frequencies.len();
+        if stored.devanagari.len() != words || stored.variant_ends.len() != words {
+            return Err("word metadata arrays differ in length".to_string());
+        }
+        let arena = &stored.arena;
+        let ascending = |ends: &[u32], limit: usize| {
+            ends.windows(2).all(|pair| pair[0] <= pair[1]) && ends.last().map_or(true, |&end| end as usize <= limit)
+        };
+        if !ascending(&arena.ends, arena.bytes.len())
+            || !ascending(&stored.variant_ends, stored.variant_ids.len())
+            || stored.devanagari.iter().chain(&stored.variant_ids).any(|&id| id as usize >= arena.len())
+        {
+            return Err("word metadata offsets out of range".to_string());
+        }
+
+        let mut start = 0;
+        let variants = stored
+            .variant_ends
+            .iter()
+            .map(|&end| {
+                let mut ids = VariantIds::default();
+                for &id in &stored.variant_ids[start..end as usize] {
+                    ids.push(id);
+                }
+                start = end as usize;
+                ids
+            })
+            .collect();
+        let mut store = MetadataStore {
+            frequencies: stored.frequencies,
+            devanagari: stored.devanagari,
+            variants,
+            arena: stored.arena,
+            index: Vec::new(),
+        };
+        store.rebuild_index();
+        Ok(store)
+    }
+}
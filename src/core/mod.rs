@@ -1,6 +1,16 @@
 // File: src/core/mod.rs
+pub mod cache;
+pub mod compaction;
 pub mod context;
 pub mod converter;
 pub mod engine;
+pub mod frozen_trie;
+pub mod handle;
+pub mod metadata;
+pub mod pool;
+pub mod session;
+pub mod stats;
+pub mod top_k;
 pub mod trie;
-pub mod types;
\ No newline at end of file
+pub mod types;
+pub mod worker;
@@ -0,0 +1,123 @@
+// File: src/core/pool.rs
+// A small persistent thread pool for running the independent stages of one
+// suggestion query side by side. Unlike the suggestion worker, its tasks borrow
+// from the caller: `run` blocks until every task has finished, so they may use
+// the engine and local buffers without copying them.
+
+use std::any::Any;
+use std::io;
+use std::panic::{catch_unwind, resume_unwind, AssertUnwindSafe};
+use std::sync::mpsc::{channel, Receiver, Sender};
+use std::sync::{Arc, Condvar, Mutex, MutexGuard, OnceLock};
+
+/// Upper bound on pool threads; a query has only a handful of stages.
+const MAX_POOL_THREADS: usize = 3;
+
+type Task = Box<dyn FnOnce() + Send + 'static>;
+type Panic = Box<dyn Any + Send + 'static>;
+
+/// Counts outstanding tasks of one `run` call and keeps the first panic.
+struct Latch {
+    state: Mutex<(usize, Option<Panic>)>,
+    done: Condvar,
+}
+
+impl Latch {
+    fn count_down(&self, panic: Option<Panic>) {
+        let mut state = lock(&self.state);
+        state.0 -= 1;
+        if state.1.is_none() {
+            state.1 = panic;
+        }
+        if state.0 == 0 {
+            self.done.notify_all();
+        }
+    }
+
+    fn wait(&self) -> Option<Panic> {
+        let mut state = lock(&self.state);
+        while state.0 > 0 {
+            state = self.done.wait(state).unwrap_or_else(|e| e.into_inner());
+        }
+        state.1.take()
+    }
+}
+
+pub struct StagePool {
+    sender: Mutex<Sender<Task>>,
+}
+
+impl StagePool {
+    pub fn new(threads: usize) -> io::Result<Self> {
+        let (sender, receiver) = channel::<Task>();
+        let receiver = Arc::new(Mutex::new(receiver));
+        for i in 0..threads.max(1) {
+            let receiver = Arc::clone(&receiver);
+            std::thread::Builder::new()
+                .name(format!("akshar-stage-{}", i))
+                .spawn(move || worker_loop(&receiver))?;
+        }
+        Ok(Self { sender: Mutex::new(sender) })
+    }
+
+    /// The process-wide pool, sized to the spare cores. `None` on a single core
+    /// or if no thread could be started; callers then run their stages in turn.
+    pub fn shared() -> Option<&'static StagePool> {
+        static POOL: OnceLock<Option<StagePool>> = OnceLock::new();
+        POOL.get_or_init(|| {
+            let cores = std::thread::available_parallelism().map_or(1, |n| n.get());
+            if cores < 2 { return None; }
+            match StagePool::new((cores - 1).min(MAX_POOL_THREADS)) {
+                Ok(pool) => Some(pool),
+                Err(e) => {
+                    eprintln!("[Rust WARN] Could not start stage pool: {}", e);
+                    None
+                }
+            }
+        })
+        .as_ref()
+    }
+
+    /// Runs every task once: the first on the calling thread, the rest on the
+    /// pool. Returns when all of them have finished, re-raising the first panic.
+    pub fn run(&self, tasks: &mut [&mut (dyn FnMut() + Send)]) {
+        let Some((first, rest)) = tasks.split_first_mut() else { return; };
+        let latch = Arc::new(Latch { state: Mutex::new((rest.len(), None)), done: Condvar::new() });
+
+        for task in rest.iter_mut() {
+            let task: &mut (dyn FnMut() + Send) = &mut **task;
+            // SAFETY: `run` does not return before the latch has counted this task
+            // down, so the borrow outlives every use the pool makes of it.
+            let task: &'static mut (dyn FnMut() + Send) = unsafe { std::mem::transmute(task) };
+            let task_latch = Arc::clone(&latch);
+            let boxed: Task = Box::new(move || {
+                let result = catch_unwind(AssertUnwindSafe(|| task()));
+                task_latch.count_down(result.err());
+            });
+            // A pool that lost its threads hands the task back; run it here.
+            if let Err(returned) = lock(&self.sender).send(boxed) {
+                (returned.0)();
+            }
+        }
+
+        let inline = catch_unwind(AssertUnwindSafe(|| first()));
+        let pooled = latch.wait();
+        if let Err(panic) = inline { resume_unwind(panic); }
+        if let Some(panic) = pooled { resume_unwind(panic); }
+    }
+}
+
+fn worker_loop(receiver: &Mutex<Receiver<Task>>) {
+    loop {
+        // Hold the receiver only while taking a task, not while running it.
+        let task = match lock(receiver).recv() {
+            Ok(task) => task,
+            Err(_) => return,
+        };
+        task();
+    }
+}
+
+fn lock<T>(mutex: &Mutex<T>) -> MutexGuard<'_, T> {
+    mutex.lock().unwrap_or_else(|e| e.into_inner())
+}
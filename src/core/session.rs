@@ -0,0 +1,206 @@
+// File: src/core/session.rs
+use crate::core::context::ContextHistory;
+use crate::core::converter::{IncrementalTransliteration, RomanizationScheme};
+use crate::core::engine::ImeEngine;
+use crate::core::frozen_trie::FrozenTrie;
+use crate::core::trie::Trie;
+
+/// A stateful composition that lives from the first keystroke of a word until it
+/// is committed or cancelled. It keeps the trie cursor and the FST state between
+/// keystrokes, so typing and backspacing only pay for the delta instead of
+/// re-walking the trie and re-running the transliterator over the whole prefix.
+///
+/// One session serves one input context (an IBus engine instance, say) for its
+/// whole life, so it also remembers the words committed there: they, not words
+/// typed in other windows, are the context its suggestions are reranked in.
+#[derive(Debug, Clone)]
+pub struct CompositionSession {
+    transliteration: IncrementalTransliteration,
+    /// Trie node reached after each matched input byte, starting with the root.
+    /// It is shorter than `roman().len() + 1` once the input has left the trie.
+    trie_path: Vec<usize>,
+    /// The same cursor for the engine's mapped lexicon, if it has one.
+    lexicon_path: Vec<usize>,
+    /// `ImeEngine::cursor_generation` the cursors were computed in.
+    generation: u64,
+    /// Words committed in this session, kept across `clear`.
+    history: ContextHistory,
+    /// The input method layout's romanization table variant.
+    scheme: RomanizationScheme,
+}
+
+impl CompositionSession {
+    pub fn new() -> Self {
+        Self::with_scheme(RomanizationScheme::Standard)
+    }
+
+    /// A session that transliterates with `scheme`'s table; it ranks against the
+    /// same dictionary as every other session on the engine.
+    pub fn with_scheme(scheme: RomanizationScheme) -> Self {
+        Self {
+            transliteration: IncrementalTransliteration::new(),
+            trie_path: vec![Trie::ROOT],
+            lexicon_path: vec![FrozenTrie::ROOT],
+            generation: 0,
+            history: ContextHistory::new(),
+            scheme,
+        }
+    }
+
+    pub fn scheme(&self) -> RomanizationScheme {
+        self.scheme
+    }
+
+    /// The Roman text composed so far.
+    pub fn roman(&self) -> &str {
+        self.transliteration.roman()
+    }
+
+    pub fn is_empty(&self) -> bool {
+        self.transliteration.is_empty()
+    }
+
+    /// Appends a keystroke. Costs one trie edge per byte plus a bounded FST resume.
+    pub fn push_char(&mut self, engine: &ImeEngine, c: char) {
+        self.sync(engine);
+        let matched_len = self.roman().len() + 1;
+        engine.romanizer_for(self.scheme).push_char(&mut self.transliteration, c);
+
+        let mut buf = [0u8; 4];
+        let bytes = c.encode_utf8(&mut buf).as_bytes();
+        Self::descend(&mut self.trie_path, matched_len, bytes, |node_idx, byte| engine.trie.child(node_idx, byte));
+        if let Some(lexicon) = &engine.lexicon {
+            let trie = lexicon.trie();
+            Self::descend(&mut self.lexicon_path, matched_len, bytes, |node_idx, byte| trie.child(node_idx, byte));
+        }
+    }
+
+    /// Extends a cursor path by `bytes`, provided it still matched the whole input.
+    fn descend(path: &mut Vec<usize>, matched_len: usize, bytes: &[u8], child: impl Fn(usize, u8) -> Option<usize>) {
+        if path.len() != matched_len {
+            return;
+        }
+        let mut node_idx = *path.last().unwrap();
+        for &byte in bytes {
+            match child(node_idx, byte) {
+                Some(next_idx) => {
+                    node_idx = next_idx;
+                    path.push(node_idx);
+                }
+                None => break,
+            }
+        }
+    }
+
+    /// Extends cursors that stopped short of the input because the engine did not
+    /// yet contain the word, e.g. when typing raced a publish. Costs one child
+    /// lookup per cursor when nothing changed.
+    pub fn refresh(&mut self, engine: &ImeEngine) {
+        self.sync(engine);
+        let roman = self.transliteration.roman().as_bytes();
+        Self::resume(&mut self.trie_path, roman, |node_idx, byte| engine.trie.child(node_idx, byte));
+        if let Some(lexicon) = &engine.lexicon {
+            let trie = lexicon.trie();
+            Self::resume(&mut self.lexicon_path, roman, |node_idx, byte| trie.child(node_idx, byte));
+        }
+    }
+
+    /// Whether `refresh` would change anything: the cursors are from an older
+    /// trie or lexicon, or one stopped short of a byte the engine now has.
+    /// Costs one child lookup per cursor that stopped short.
+    pub(crate) fn needs_refresh(&self, engine: &ImeEngine) -> bool {
+        if !self.is_synced(engine) { return true; }
+        let roman = self.transliteration.roman().as_bytes();
+        let extends = |path: &[usize], child: &dyn Fn(usize, u8) -> Option<usize>| {
+            roman.get(path.len() - 1).is_some_and(|&byte| child(path[path.len() - 1], byte).is_some())
+        };
+        extends(&self.trie_path, &|node_idx, byte| engine.trie.child(node_idx, byte))
+            || engine.lexicon.as_ref().is_some_and(|lexicon| {
+                let trie = lexicon.trie();
+                extends(&self.lexicon_path, &|node_idx, byte| trie.child(node_idx, byte))
+            })
+    }
+
+    /// Whether the cursors belong to the engine's current trie and lexicon.
+    pub(crate) fn is_synced(&self, engine: &ImeEngine) -> bool {
+        self.generation == engine.cursor_generation()
+    }
+
+    /// Drops the cursors back to the roots after a compaction rebuilt the trie
+    /// or a lexicon was attached; `refresh` then re-descends them.
+    fn sync(&mut self, engine: &ImeEngine) {
+        if self.is_synced(engine) { return; }
+        self.generation = engine.cursor_generation();
+        self.trie_path.truncate(1);
+        self.lexicon_path.truncate(1);
+        self.refresh(engine);
+    }
+
+    fn resume(path: &mut Vec<usize>, roman: &[u8], child: impl Fn(usize, u8) -> Option<usize>) {
+        let matched = path.len() - 1;
+        if matched < roman.len() {
+            Self::descend(path, matched + 1, &roman[matched..], child);
+        }
+    }
+
+    /// Removes the last keystroke, restoring the previous trie cursor and FST state.
+    pub fn pop_char(&mut self, engine: &ImeEngine) -> Option<char> {
+        self.sync(engine);
+        let c = engine.romanizer_for(self.scheme).pop_char(&mut self.transliteration)?;
+        self.trie_path.truncate(self.roman().len() + 1);
+        self.lexicon_path.truncate(self.roman().len() + 1);
+        Some(c)
+    }
+
+    /// Drops the word being composed. The committed-word history stays.
+    pub fn clear(&mut self) {
+        self.transliteration.clear();
+        self.trie_path.truncate(1);
+        self.lexicon_path.truncate(1);
+    }
+
+    /// Records `devanagari` as committed here and starts the next word.
+    pub fn commit(&mut self, devanagari: &str) {
+        self.history.push(devanagari);
+        self.clear();
+    }
+
+    /// The words committed in this session, oldest first.
+    pub fn history(&self) -> &ContextHistory {
+        &self.history
+    }
+
+    /// Forgets the committed words, e.g. when the input context is reset.
+    pub fn clear_history(&mut self) {
+        self.history.clear();
+    }
+
+    /// The trie node for the full input, or `None` if no learned word has this prefix.
+    pub(crate) fn trie_node(&self) -> Option<usize> {
+        if self.trie_path.len() == self.roman().len() + 1 {
+            self.trie_path.last().copied()
+        } else {
+            None
+        }
+    }
+
+    /// The lexicon node for the full input, if the engine has a lexicon containing this prefix.
+    pub(crate) fn lexicon_node(&self) -> Option<usize> {
+        if self.lexicon_path.len() == self.roman().len() + 1 {
+            self.lexicon_path.last().copied()
+        } else {
+            None
+        }
+    }
+
+    /// The primary transliteration of the current input, maintained incrementally.
+    pub(crate) fn primary(&self) -> &str {
+        self.transliteration.primary()
+    }
+}
+
+impl Default for CompositionSession {
+    fn default() -> Self {
+        Self::new()
+    }
+}
@@ -0,0 +1,248 @@
+// File: src/core/stats.rs
+// Hot-path latency instrumentation. Each stage of a query, a confirmation and
+// a snapshot load or save records its duration into a process-wide histogram
+// of atomic counters, so recording is lock-free and costs two clock reads and
+// a few relaxed adds. Histograms are read through `snapshot` (and the C API's
+// `akshar_ime_get_stats`) without stopping the engine.
+//
+// Built without the `stats` feature, timers are zero-sized and record nothing.
+#[cfg(feature = "stats")]
+use std::time::Instant;
+
+/// An instrumented stage. Stages nest: a `Query` that misses the cache
+/// contains one `Rank`, which contains the trie, fuzzy, primary, literal and
+/// rerank stages that ran for it.
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub enum Stage {
+    /// A whole suggestion query, cache lookup included.
+    Query,
+    /// A query that missed the cache and ran the ranking pipeline.
+    Rank,
+    Trie,
+    Fuzzy,
+    Primary,
+    Literal,
+    Rerank,
+    /// One confirmation applied by `LearningEngine::learn`.
+    Learn,
+    /// Reading a snapshot and decoding the sections queries need.
+    Load,
+    /// Decoding the rest of a sectioned snapshot in the background.
+    Warmup,
+    /// Encoding a snapshot.
+    Encode,
+    /// Writing an encoded snapshot to disk.
+    Write,
+    /// From a candidate request to the candidates being shown, as measured by
+    /// the IBus engine.
+    RoundTrip,
+}
+
+impl Stage {
+    pub const ALL: [Stage; 13] = [
+        Stage::Query,
+        Stage::Rank,
+        Stage::Trie,
+        Stage::Fuzzy,
+        Stage::Primary,
+        Stage::Literal,
+        Stage::Rerank,
+        Stage::Learn,
+        Stage::Load,
+        Stage::Warmup,
+        Stage::Encode,
+        Stage::Write,
+        Stage::RoundTrip,
+    ];
+
+    pub fn name(self) -> &'static str {
+        match self {
+            Stage::Query => "query",
+            Stage::Rank => "rank",
+            Stage::Trie => "trie",
+            Stage::Fuzzy => "fuzzy",
+            Stage::Primary => "primary",
+            Stage::Literal => "literal",
+            Stage::Rerank => "rerank",
+            Stage::Learn => "learn",
+            Stage::Load => "load",
+            Stage::Warmup => "warmup",
+            Stage::Encode => "encode",
+            Stage::Write => "write",
+            Stage::RoundTrip => "round_trip",
+        }
+    }
+}
+
+/// Summary of one stage's histogram. Percentiles are bucket upper bounds.
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub struct StageStats {
+    pub stage: Stage,
+    pub count: u64,
+    pub total_nanos: u64,
+    pub max_nanos: u64,
+    pub p50_nanos: u64,
+    pub p99_nanos: u64,
+    pub p999_nanos: u64,
+}
+
+/// Measures one stage from its creation until it is dropped.
+#[must_use = "a timer records when it is dropped"]
+pub struct StageTimer {
+    #[cfg(feature = "stats")]
+    stage: Stage,
+    #[cfg(feature = "stats")]
+    start: Instant,
+}
+
+/// Starts timing `stage`; the duration is recorded when the timer is dropped.
+#[inline]
+#[cfg_attr(not(feature = "stats"), allow(unused_variables))]
+pub fn timer(stage: Stage) -> StageTimer {
+    StageTimer {
+        #[cfg(feature = "stats")]
+        stage,
+        #[cfg(feature = "stats")]
+        start: Instant::now(),
+    }
+}
+
+/// `snapshot` as a JSON object keyed by stage name, with times in microseconds.
+pub fn to_json() -> String {
+    let stages: serde_json::Map<String, serde_json::Value> = snapshot()
+        .into_iter()
+        .map(|s| {
+            let micros = |nanos: u64| nanos as f64 / 1e3;
+            let value = serde_json::json!({
+                "count": s.count,
+                "mean_us": micros(s.total_nanos) / s.count as f64,
+                "p50_us": micros(s.p50_nanos),
+                "p99_us": micros(s.p99_nanos),
+                "p999_us": micros(s.p999_nanos),
+                "max_us": micros(s.max_nanos),
+            });
+            (s.stage.name().to_string(), value)
+        })
+        .collect();
+    serde_json::Value::Object(stages).to_string()
+}
+
+#[cfg(feature = "stats")]
+pub use histograms::{record, reset, snapshot};
+
+#[cfg(feature = "stats")]
+mod histograms {
+    use super::{Stage, StageStats, StageTimer};
+    use std::sync::atomic::{AtomicU64, Ordering};
+
+    /// Buckets per power of two; bucket bounds are within 19% of each other.
+    const SUB_BUCKETS: usize = 4;
+    /// Covers durations up to 2^32 ns (about 4.3 s); longer ones share the last bucket.
+    const BUCKETS: usize = 32 * SUB_BUCKETS;
+
+    /// Bucket of a duration: its power of two, refined by the next two bits.
+    fn bucket_of(nanos: u64) -> usize {
+        if nanos < SUB_BUCKETS as u64 {
+            return nanos as usize;
+        }
+        let exponent = 63 - nanos.leading_zeros() as usize;
+        let fraction = (nanos >> (exponent - 2)) as usize & (SUB_BUCKETS - 1);
+        (exponent * SUB_BUCKETS + fraction).min(BUCKETS - 1)
+    }
+
+    /// Smallest duration that falls into a later bucket than `bucket`.
+    fn bucket_upper_bound(bucket: usize) -> u64 {
+        if bucket < SUB_BUCKETS {
+            return bucket as u64 + 1;
+        }
+        let (exponent, fraction) = (bucket / SUB_BUCKETS, bucket % SUB_BUCKETS);
+        ((SUB_BUCKETS + fraction + 1) as u64) << (exponent - 2)
+    }
+
+    struct Histogram {
+        buckets: [AtomicU64; BUCKETS],
+        total_nanos: AtomicU64,
+        max_nanos: AtomicU64,
+    }
+
+    impl Histogram {
+        const ZERO: AtomicU64 = AtomicU64::new(0);
+        const EMPTY: Histogram = Histogram {
+            buckets: [Self::ZERO; BUCKETS],
+            total_nanos: AtomicU64::new(0),
+            max_nanos: AtomicU64::new(0),
+        };
+
+        fn record(&self, nanos: u64) {
+            self.buckets[bucket_of(nanos)].fetch_add(1, Ordering::Relaxed);
+            self.total_nanos.fetch_add(nanos, Ordering::Relaxed);
+            self.max_nanos.fetch_max(nanos, Ordering::Relaxed);
+        }
+
+        fn reset(&self) {
+            for bucket in &self.buckets {
+                bucket.store(0, Ordering::Relaxed);
+            }
+            self.total_nanos.store(0, Ordering::Relaxed);
+            self.max_nanos.store(0, Ordering::Relaxed);
+        }
+
+        fn summary(&self, stage: Stage) -> Option<StageStats> {
+            let buckets: Vec<u64> = self.buckets.iter().map(|b| b.load(Ordering::Relaxed)).collect();
+            let count: u64 = buckets.iter().sum();
+            if count == 0 { return None; }
+            let percentile = |q: f64| {
+                let rank = ((count as f64 * q).ceil() as u64).max(1);
+                let mut seen = 0;
+                let bucket = buckets.iter().position(|&n| { seen += n; seen >= rank }).unwrap_or(BUCKETS - 1);
+                bucket_upper_bound(bucket)
+            };
+            Some(StageStats {
+                stage,
+                count,
+                total_nanos: self.total_nanos.load(Ordering::Relaxed),
+                max_nanos: self.max_nanos.load(Ordering::Relaxed),
+                p50_nanos: percentile(0.50),
+                p99_nanos: percentile(0.99),
+                p999_nanos: percentile(0.999),
+            })
+        }
+    }
+
+    static HISTOGRAMS: [Histogram; Stage::ALL.len()] = [Histogram::EMPTY; Stage::ALL.len()];
+
+    impl Drop for StageTimer {
+        #[inline]
+        fn drop(&mut self) {
+            record(self.stage, self.start.elapsed().as_nanos() as u64);
+        }
+    }
+
+    /// Records a duration measured elsewhere, e.g. on the C side.
+    #[inline]
+    pub fn record(stage: Stage, nanos: u64) {
+        HISTOGRAMS[stage as usize].record(nanos);
+    }
+
+    /// Clears every histogram.
+    pub fn reset() {
+        HISTOGRAMS.iter().for_each(Histogram::reset);
+    }
+
+    /// Reads every stage that has recorded anything. Samples recorded while this
+    /// runs may be partly included, so counts and percentiles can be a sample apart.
+    pub fn snapshot() -> Vec<StageStats> {
+        Stage::ALL.iter().zip(HISTOGRAMS.iter()).filter_map(|(&stage, h)| h.summary(stage)).collect()
+    }
+}
+
+#[cfg(not(feature = "stats"))]
+pub fn record(_stage: Stage, _nanos: u64) {}
+
+#[cfg(not(feature = "stats"))]
+pub fn reset() {}
+
+#[cfg(not(feature = "stats"))]
+pub fn snapshot() -> Vec<StageStats> {
+    Vec::new()
+}
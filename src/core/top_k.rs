@@ -0,0 +1,59 @@
+// File: src/core/top_k.rs
+use crate::core::types::WordId;
+use std::cmp::Reverse;
+use std::collections::BinaryHeap;
+
+/// Frontier entries start with room for this many before the heap grows.
+const INITIAL_FRONTIER: usize = 64;
+
+/// A pending step of the search: (bound, is_word, id). A subtree's bound is its
+/// `max_freq_in_subtree`, a word's is its frequency. The heap pops the highest
+/// bound first; between equal bounds, words before subtrees and lower ids first.
+type FrontierEntry = (u64, bool, Reverse<usize>);
+
+/// Best-first top-k over a trie whose nodes record the highest frequency in
+/// their subtree, shared by `Trie` and `FrozenTrieRef`.
+///
+/// Subtrees are expanded in order of that bound, so once `k` words have been
+/// reported no other node can beat them and nothing else is touched. A query
+/// expands roughly k * depth nodes whatever the size of the subtree under the
+/// prefix, and results come out sorted by descending frequency.
+///
+/// Returns the results together with the number of nodes expanded.
+pub(crate) fn best_first_top_k(
+    root: usize,
+    k: usize,
+    max_freq: impl Fn(usize) -> u64,
+    word: impl Fn(usize) -> Option<(WordId, u64)>,
+    mut for_each_child: impl FnMut(usize, &mut dyn FnMut(usize)),
+) -> (Vec<(WordId, u64)>, usize) {
+    let mut results = Vec::with_capacity(k.min(INITIAL_FRONTIER));
+    let mut visited = 0;
+    if k == 0 {
+        return (results, visited);
+    }
+
+    let mut frontier: BinaryHeap<FrontierEntry> = BinaryHeap::with_capacity(INITIAL_FRONTIER);
+    frontier.push((max_freq(root), false, Reverse(root)));
+    while let Some((bound, is_word, Reverse(idx))) = frontier.pop() {
+        // Words of frequency 0 are never suggested.
+        if bound == 0 { break; }
+        if is_word {
+            results.push((idx, bound));
+            if results.len() == k { break; }
+            continue;
+        }
+
+        visited += 1;
+        if let Some((word_id, freq)) = word(idx) {
+            frontier.push((freq, true, Reverse(word_id)));
+        }
+        for_each_child(idx, &mut |child_idx| {
+            let child_bound = max_freq(child_idx);
+            if child_bound > 0 {
+                frontier.push((child_bound, false, Reverse(child_idx)));
+            }
+        });
+    }
+    (results, visited)
+}
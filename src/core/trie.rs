@@ -1,7 +1,17 @@
 // File: src/core/trie.rs
+use crate::core::frozen_trie::FrozenTrie;
+use crate::core::metadata::MetadataStore;
+use crate::core::top_k::best_first_top_k;
 use crate::core::types::{WordId, WordMetadata};
 use serde::{Deserialize, Serialize};
-use std::collections::{BinaryHeap, HashMap, HashSet};
+use std::cmp::Reverse;
+use std::collections::HashMap;
+
+/// Nodes this close to the root cache their most frequent words, so the short
+/// prefixes with the largest subtrees answer with a read instead of a search.
+const CACHED_DEPTH: usize = 3;
+/// Words cached per node, a full candidate page.
+const CACHED_TOP_K: usize = 8;
 
 #[derive(Clone, Serialize, Deserialize)]
 struct Node {
@@ -20,120 +30,491 @@ impl Node {
     }
 }
 
+/// The most frequent distinct words of a subtree, by descending frequency and
+/// then ascending WordId. Words of frequency 0 are left out, as in searches.
+#[derive(Clone, Copy, Default)]
+struct TopWords {
+    len: u8,
+    words: [(WordId, u64); CACHED_TOP_K],
+}
+
+impl TopWords {
+    fn iter(&self) -> impl Iterator<Item = (WordId, u64)> + '_ {
+        self.words[..self.len as usize].iter().copied()
+    }
+
+    /// The frequency a word needs to enter the list: that of its last word once
+    /// it is full.
+    fn threshold(&self) -> u64 {
+        match self.len as usize {
+            CACHED_TOP_K => self.words[CACHED_TOP_K - 1].1,
+            _ => 0,
+        }
+    }
+
+    /// Accounts for a word of the subtree now having `frequency`, which must
+    /// not be lower than before. O(CACHED_TOP_K).
+    fn raise(&mut self, word_id: WordId, frequency: u64) {
+        if frequency == 0 { return; }
+        let len = self.len as usize;
+        let mut pos = match self.words[..len].iter().position(|&(id, _)| id == word_id) {
+            Some(pos) => pos,
+            None if len < CACHED_TOP_K => {
+                self.len += 1;
+                len
+            }
+            None if ranks_before((word_id, frequency), self.words[len - 1]) => len - 1,
+            None => return,
+        };
+        self.words[pos] = (word_id, frequency);
+        while pos > 0 && ranks_before(self.words[pos], self.words[pos - 1]) {
+            self.words.swap(pos, pos - 1);
+            pos -= 1;
+        }
+    }
+}
+
+fn ranks_before((a_id, a_freq): (WordId, u64), (b_id, b_freq): (WordId, u64)) -> bool {
+    (a_freq, Reverse(a_id)) > (b_freq, Reverse(b_id))
+}
+
+/// Snapshots hold the nodes and the metadata store; the top-word caches are
+/// derived and rebuilt on load.
 #[derive(Clone, Serialize, Deserialize)]
+#[serde(from = "StoredTrie")]
 pub struct Trie {
     nodes: Vec<Node>,
-    pub metadata_store: Vec<WordMetadata>,
+    pub metadata_store: MetadataStore,
+    /// Top words of every node at most `CACHED_DEPTH` bytes below the root.
+    #[serde(skip)]
+    top_words: HashMap<usize, TopWords>,
+}
+
+#[derive(Deserialize)]
+struct StoredTrie {
+    nodes: Vec<Node>,
+    metadata_store: MetadataStore,
+}
+
+impl From<StoredTrie> for Trie {
+    fn from(stored: StoredTrie) -> Self {
+        Self::with_nodes(stored.nodes, stored.metadata_store)
+    }
+}
+
+/// `Trie` layout of unversioned snapshots, with one owned
+/// `WordMetadata` per word. Decoded snapshots are converted to the arena layout.
+#[derive(Deserialize)]
+pub(crate) struct LegacyTrie {
+    nodes: Vec<Node>,
+    metadata_store: Vec<WordMetadata>,
+}
+
+impl From<LegacyTrie> for Trie {
+    fn from(legacy: LegacyTrie) -> Self {
+        Self::with_nodes(legacy.nodes, legacy.metadata_store.into())
+    }
 }
 
 impl Trie {
     pub fn new() -> Self {
         Self {
             nodes: vec![Node::new()],
-            metadata_store: Vec::new(),
+            metadata_store: MetadataStore::new(),
+            top_words: HashMap::new(),
         }
     }
 
+    /// A trie over complete nodes, with the top-word caches rebuilt.
+    fn with_nodes(nodes: Vec<Node>, metadata_store: MetadataStore) -> Self {
+        let mut trie = Self { nodes, metadata_store, top_words: HashMap::new() };
+        trie.rebuild_top_words();
+        trie
+    }
+
+    /// O(1) lookup of the WordId for a canonical Devanagari word.
     pub fn find_word_id_by_devanagari(&self, devanagari: &str) -> Option<WordId> {
-        self.metadata_store.iter().position(|meta| meta.devanagari == devanagari)
+        self.metadata_store.find(devanagari)
     }
 
     pub fn get_or_create_metadata(&mut self, devanagari: &str) -> WordId {
         if let Some(id) = self.find_word_id_by_devanagari(devanagari) {
             id
         } else {
-            let new_meta = WordMetadata {
-                devanagari: devanagari.to_string(),
-                frequency: 0,
-                variants: HashSet::new(),
-            };
-            self.metadata_store.push(new_meta);
-            self.metadata_store.len() - 1
-        }
-    }
-
-    // Corrected the unused variable warning
-    pub fn insert(&mut self, key: &str, word_id: WordId, _frequency: u64) {
-        let mut node_idx = 0;
-        let mut path = vec![0];
-
-        for &byte in key.as_bytes() {
-            // --- BORROW CHECKER FIX IS HERE ---
-            // The original code held a mutable borrow on a node while trying to modify the
-            // parent `nodes` vector, which is not allowed. This new structure performs
-            // the check and the modification in separate steps, respecting the borrow checker.
-            let next_idx = if let Some(&child_idx) = self.nodes[node_idx].children.get(&byte) {
-                child_idx
-            } else {
-                let new_node_idx = self.nodes.len();
-                self.nodes.push(Node::new());
-                self.nodes[node_idx].children.insert(byte, new_node_idx);
-                new_node_idx
-            };
-            // --- END OF FIX ---
-            node_idx = next_idx;
-            path.push(node_idx);
-        }
-        self.nodes[node_idx].word_id = Some(word_id);
-
-        for &idx in path.iter().rev() {
-            let current_node_freq = self.nodes[idx]
-                .word_id
-                .map_or(0, |id| self.metadata_store[id].frequency);
-
-            let max_child_freq = self.nodes[idx]
-                .children
-                .values()
-                .map(|&child_idx| self.nodes[child_idx].max_freq_in_subtree)
-                .max()
-                .unwrap_or(0);
-            
-            let new_max_freq = current_node_freq.max(max_child_freq);
-
-            if new_max_freq == self.nodes[idx].max_freq_in_subtree {
-                break;
+            self.metadata_store.push(devanagari, 0)
+        }
+    }
+
+    /// Builds a trie over (Roman key, WordId) pairs for a complete metadata store,
+    /// for bulk imports. Paths are inserted without maintaining subtree maxima,
+    /// which one sweep then computes for every node, so the build is linear in
+    /// the total key length.
+    pub fn from_words(metadata_store: MetadataStore, keys: &[(String, WordId)]) -> Self {
+        let mut trie = Self::new();
+        trie.metadata_store = metadata_store;
+        for (key, word_id) in keys {
+            let node_idx = key.bytes().fold(Self::ROOT, |node_idx, byte| trie.child_or_insert(node_idx, byte));
+            trie.nodes[node_idx].word_id = Some(*word_id);
+        }
+        // Children are always created after their parent, so a reverse sweep
+        // finishes every subtree before its root.
+        for idx in (0..trie.nodes.len()).rev() {
+            trie.nodes[idx].max_freq_in_subtree = trie.rescan_max_freq(idx);
+        }
+        trie.rebuild_top_words();
+        trie
+    }
+
+    /// Points `key` at `word_id` and brings the subtree maxima and top-word
+    /// caches above every key of the word up to date with its frequency, which
+    /// must not have dropped since it was last inserted.
+    ///
+    /// A frequency that rises is pushed down each path from the root in
+    /// O(depth), touching no siblings. Only a key taken over from another word,
+    /// which loses that word from its subtrees, has its path repaired.
+    pub fn insert(&mut self, key: &str, word_id: WordId) {
+        let node_idx = key.bytes().fold(Self::ROOT, |node_idx, byte| self.child_or_insert(node_idx, byte));
+        if let Some(previous) = self.nodes[node_idx].word_id.replace(word_id) {
+            if previous != word_id {
+                self.remove_from_path(key, previous);
+            }
+        }
+
+        // Every key of the word leads to it through its own ancestors, and all
+        // of them have to see the new frequency.
+        let Self { nodes, metadata_store, top_words } = self;
+        let frequency = metadata_store.frequency(word_id);
+        let mut key_is_variant = false;
+        for variant in metadata_store.variants(word_id) {
+            key_is_variant |= variant == key;
+            raise_path(nodes, top_words, variant.as_bytes(), word_id, frequency);
+        }
+        if !key_is_variant {
+            raise_path(nodes, top_words, key.as_bytes(), word_id, frequency);
+        }
+    }
+
+    /// Accounts for `previous` no longer being the word at `key`, deepest node
+    /// first. Only maxima that `previous` set are rescanned, and only cached
+    /// lists that held it are recomputed.
+    fn remove_from_path(&mut self, key: &str, previous: WordId) {
+        let mut path = Vec::with_capacity(key.len() + 1);
+        path.push(Self::ROOT);
+        for byte in key.bytes() {
+            let Some(child_idx) = self.child(path[path.len() - 1], byte) else { return };
+            path.push(child_idx);
+        }
+        let frequency = self.metadata_store.frequency(previous);
+        let mut rescan = true;
+        for (depth, &idx) in path.iter().enumerate().rev() {
+            // A maximum above the one `previous` had came from another word,
+            // and so does every maximum above it.
+            rescan &= self.nodes[idx].max_freq_in_subtree <= frequency;
+            if rescan {
+                self.nodes[idx].max_freq_in_subtree = self.rescan_max_freq(idx);
+            }
+            let held = self.top_words.get(&idx).is_some_and(|top| top.iter().any(|(id, _)| id == previous));
+            if held {
+                let top = self.collect_top_words(idx, depth);
+                self.top_words.insert(idx, top);
+            }
+        }
+    }
+
+    /// Recomputes the top-word cache of every node down to `CACHED_DEPTH`,
+    /// deepest first, from correct subtree maxima. Each node at the deepest
+    /// cached level searches its subtree once, skipping what its maxima rule
+    /// out, and the levels above merge the lists of their children.
+    fn rebuild_top_words(&mut self) {
+        self.top_words.clear();
+        let mut levels = vec![vec![Self::ROOT]];
+        while levels.len() <= CACHED_DEPTH {
+            let next: Vec<usize> = levels[levels.len() - 1]
+                .iter()
+                .flat_map(|&idx| self.nodes[idx].children.values().copied())
+                .collect();
+            levels.push(next);
+        }
+        for (depth, level) in levels.iter().enumerate().rev() {
+            for &idx in level {
+                let top = self.collect_top_words(idx, depth);
+                self.top_words.insert(idx, top);
+            }
+        }
+    }
+
+    /// The top words of the subtree under `node_idx`, at `depth` below the
+    /// root, from the cached lists of its children where they have them. The
+    /// top words of a subtree are among the top words of the child subtrees
+    /// that hold them, so merging the lists is exact.
+    fn collect_top_words(&self, node_idx: usize, depth: usize) -> TopWords {
+        let mut top = TopWords::default();
+        let mut stack = vec![node_idx];
+        while let Some(idx) = stack.pop() {
+            let node = &self.nodes[idx];
+            if let Some(word_id) = node.word_id {
+                top.raise(word_id, self.metadata_store.frequency(word_id));
+            }
+            for &child_idx in node.children.values() {
+                let child_top = if depth < CACHED_DEPTH { self.top_words.get(&child_idx) } else { None };
+                match child_top {
+                    Some(child_top) => child_top.iter().for_each(|(id, freq)| top.raise(id, freq)),
+                    // Nothing in a subtree whose maximum is below the full
+                    // list's last word can make the list.
+                    None if self.nodes[child_idx].max_freq_in_subtree < top.threshold() => {}
+                    None => stack.push(child_idx),
+                }
             }
-            self.nodes[idx].max_freq_in_subtree = new_max_freq;
         }
+        top
+    }
+
+    fn child_or_insert(&mut self, node_idx: usize, byte: u8) -> usize {
+        if let Some(&child_idx) = self.nodes[node_idx].children.get(&byte) {
+            return child_idx;
+        }
+        let child_idx = self.nodes.len();
+        self.nodes.push(Node::new());
+        self.nodes[node_idx].children.insert(byte, child_idx);
+        child_idx
+    }
+
+    /// The highest frequency at or below `node_idx`, from its own word and the
+    /// stored maxima of its children.
+    fn rescan_max_freq(&self, node_idx: usize) -> u64 {
+        let node = &self.nodes[node_idx];
+        let own = node.word_id.map_or(0, |id| self.metadata_store.frequency(id));
+        let children = node.children.values().map(|&child_idx| self.nodes[child_idx].max_freq_in_subtree);
+        children.fold(own, u64::max)
+    }
+
+    /// Index of the root node, the starting point for incremental prefix descent.
+    pub const ROOT: usize = 0;
+
+    /// Follows a single byte edge from `node_idx`. Node indices are never reused,
+    /// so a cursor obtained here stays valid across later insertions.
+    pub fn child(&self, node_idx: usize, byte: u8) -> Option<usize> {
+        self.nodes[node_idx].children.get(&byte).copied()
+    }
+
+    /// The word an exact Roman key leads to.
+    pub fn word_at(&self, key: &str) -> Option<WordId> {
+        let node_idx = key.bytes().try_fold(Self::ROOT, |node_idx, byte| self.child(node_idx, byte))?;
+        self.nodes[node_idx].word_id
+    }
+
+    pub(crate) fn node_count(&self) -> usize {
+        self.nodes.len()
+    }
+
+    pub(crate) fn node_word_id(&self, node_idx: usize) -> Option<WordId> {
+        self.nodes[node_idx].word_id
+    }
+
+    pub(crate) fn node_max_freq(&self, node_idx: usize) -> u64 {
+        self.nodes[node_idx].max_freq_in_subtree
+    }
+
+    /// Children of a node as (edge byte, node index), sorted by edge byte.
+    pub(crate) fn sorted_children(&self, node_idx: usize) -> Vec<(u8, usize)> {
+        let mut children: Vec<(u8, usize)> = self.nodes[node_idx]
+            .children
+            .iter()
+            .map(|(&byte, &child_idx)| (byte, child_idx))
+            .collect();
+        children.sort_unstable();
+        children
+    }
+
+    /// Snapshots the trie into the compact read-only layout.
+    pub fn freeze(&self) -> FrozenTrie {
+        FrozenTrie::from_trie(self)
     }
 
     pub fn get_top_k_suggestions(&self, prefix: &str, k: usize) -> Vec<(WordId, u64)> {
-        let mut node_idx = 0;
+        let mut node_idx = Self::ROOT;
         for &byte in prefix.as_bytes() {
-            if let Some(&next_idx) = self.nodes[node_idx].children.get(&byte) {
+            if let Some(next_idx) = self.child(node_idx, byte) {
                 node_idx = next_idx;
             } else {
                 return vec![];
             }
         }
+        self.get_top_k_from_node(node_idx, k)
+    }
 
-        let mut heap = BinaryHeap::with_capacity(k + 1);
-        self.dfs_pruning_search(node_idx, k, &mut heap);
+    /// Top-k search over the subtree rooted at an already-resolved prefix node,
+    /// sorted by descending frequency. Prefixes of up to `CACHED_DEPTH` bytes
+    /// read their cached list when `k` fits in it.
+    pub fn get_top_k_from_node(&self, node_idx: usize, k: usize) -> Vec<(WordId, u64)> {
+        if k <= CACHED_TOP_K {
+            if let Some(top) = self.top_words.get(&node_idx) {
+                return top.iter().take(k).collect();
+            }
+        }
+        self.top_k_with_visits(node_idx, k).0
+    }
 
-        heap.into_iter().map(|(freq, id)| (id, freq)).collect()
+    /// `get_top_k_from_node` together with the number of nodes it expanded.
+    pub fn top_k_with_visits(&self, node_idx: usize, k: usize) -> (Vec<(WordId, u64)>, usize) {
+        best_first_top_k(
+            node_idx,
+            k,
+            |idx| self.nodes[idx].max_freq_in_subtree,
+            |idx| self.nodes[idx].word_id.map(|id| (id, self.metadata_store.frequency(id))),
+            |idx, visit| self.nodes[idx].children.values().for_each(|&child_idx| visit(child_idx)),
+        )
     }
+}
 
-    fn dfs_pruning_search(&self, node_idx: usize, k: usize, heap: &mut BinaryHeap<(u64, WordId)>) {
-        let node = &self.nodes[node_idx];
+/// Raises the maxima and top-word caches from the root down to the node `key`
+/// leads to, if that node holds `word_id`, to at least `frequency`.
+fn raise_path(nodes: &mut [Node], top_words: &mut HashMap<usize, TopWords>, key: &[u8], word_id: WordId, frequency: u64) {
+    let leaf = key.iter().try_fold(Trie::ROOT, |idx, byte| nodes[idx].children.get(byte).copied());
+    if leaf.map_or(true, |leaf| nodes[leaf].word_id != Some(word_id)) { return; }
 
-        if let Some(id) = node.word_id {
-            let freq = self.metadata_store[id].frequency;
-            if freq > 0 {
-                if heap.len() < k {
-                    heap.push((freq, id));
-                } else if freq > heap.peek().unwrap().0 {
-                    heap.pop();
-                    heap.push((freq, id));
-                }
+    let mut idx = Trie::ROOT;
+    for depth in 0..=key.len() {
+        if depth > 0 {
+            idx = nodes[idx].children[&key[depth - 1]];
+        }
+        let node = &mut nodes[idx];
+        node.max_freq_in_subtree = node.max_freq_in_subtree.max(frequency);
+        if depth <= CACHED_DEPTH {
+            top_words.entry(idx).or_default().raise(word_id, frequency);
+        }
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    /// Confirms `roman` as `devanagari` the way the learner does: the
+    /// frequency rises by `increment`, then the key is inserted.
+    fn learn(trie: &mut Trie, roman: &str, devanagari: &str, increment: u64) -> WordId {
+        let word_id = trie.get_or_create_metadata(devanagari);
+        *trie.metadata_store.frequency_mut(word_id) += increment;
+        trie.metadata_store.add_variant(word_id, roman);
+        trie.insert(roman, word_id);
+        word_id
+    }
+
+    /// The distinct words reachable under `node_idx`, found by walking every
+    /// node, in the order top-k lists use.
+    fn subtree_words(trie: &Trie, node_idx: usize) -> Vec<(WordId, u64)> {
+        let mut words = Vec::new();
+        let mut stack = vec![node_idx];
+        while let Some(idx) = stack.pop() {
+            let node = &trie.nodes[idx];
+            if let Some(word_id) = node.word_id {
+                let frequency = trie.metadata_store.frequency(word_id);
+                if frequency > 0 { words.push((word_id, frequency)); }
             }
+            stack.extend(node.children.values().copied());
         }
+        words.sort_unstable_by_key(|&(id, freq)| (Reverse(freq), id));
+        words.dedup();
+        words
+    }
 
-        let min_freq_in_heap = if heap.len() == k { heap.peek().unwrap().0 } else { 0 };
+    /// Checks every node's maximum, cached list and uncached search against a
+    /// full walk of its subtree.
+    fn assert_consistent(trie: &Trie) {
+        let mut depths = vec![0; trie.node_count()];
+        for idx in 0..trie.node_count() {
+            for &child_idx in trie.nodes[idx].children.values() {
+                depths[child_idx] = depths[idx] + 1;
+            }
+        }
+        for idx in 0..trie.node_count() {
+            let expected = subtree_words(trie, idx);
+            let max_freq = trie.nodes[idx].max_freq_in_subtree;
+            assert_eq!(max_freq, expected.first().map_or(0, |&(_, freq)| freq), "maximum of node {}", idx);
 
-        for &child_idx in node.children.values() {
-            if self.nodes[child_idx].max_freq_in_subtree > min_freq_in_heap {
-                self.dfs_pruning_search(child_idx, k, heap);
+            assert_eq!(trie.top_words.contains_key(&idx), depths[idx] <= CACHED_DEPTH, "cache of node {}", idx);
+            if depths[idx] <= CACHED_DEPTH {
+                for k in 1..=CACHED_TOP_K {
+                    let cached = trie.get_top_k_from_node(idx, k);
+                    assert_eq!(cached, expected[..k.min(expected.len())], "top {} of node {}", k, idx);
+                }
             }
+
+            // The search reports a word once per key under the node, and
+            // breaks frequency ties by what it expands first.
+            let mut uncached = trie.top_k_with_visits(idx, usize::MAX).0;
+            assert!(uncached.windows(2).all(|pair| pair[0].1 >= pair[1].1), "order under node {}", idx);
+            uncached.sort_unstable_by_key(|&(id, freq)| (Reverse(freq), id));
+            uncached.dedup();
+            assert_eq!(uncached, expected, "search under node {}", idx);
         }
     }
-}
\ No newline at end of file
+
+    #[test]
+    fn caches_follow_a_sequence_of_inserts() {
+        const SYLLABLES: [&str; 6] = ["ka", "kha", "ma", "na", "ra", "a"];
+        let mut trie = Trie::new();
+        let mut state = 7u64;
+        for step in 0..300u64 {
+            state = state.wrapping_mul(6364136223846793005).wrapping_add(1442695040888963407);
+            let word = (state >> 33) % 40;
+            // Each word keeps one key, made of two or three syllables.
+            let roman: String = (0..2 + word % 2)
+                .map(|i| SYLLABLES[((word / 6u64.pow(i as u32)) % 6) as usize])
+                .collect();
+            learn(&mut trie, &roman, &format!("w{}", word), 1 + step % 3);
+            assert_consistent(&trie);
+        }
+    }
+
+    #[test]
+    fn caches_drop_a_word_whose_key_is_taken_over() {
+        let mut trie = Trie::new();
+        learn(&mut trie, "kamal", "कमल", 20);
+        let taken = learn(&mut trie, "kal", "कल", 50);
+        learn(&mut trie, "kala", "कला", 5);
+        learn(&mut trie, "kal", "काल", 3);
+        assert_consistent(&trie);
+        assert!(trie.get_top_k_suggestions("k", CACHED_TOP_K).iter().all(|&(id, _)| id != taken));
+
+        // Keys in the uncached depths are repaired the same way.
+        learn(&mut trie, "kamalini", "कमलिनी", 40);
+        learn(&mut trie, "kamalini", "कामिनी", 2);
+        assert_consistent(&trie);
+    }
+
+    #[test]
+    fn caches_list_a_multi_variant_word_once() {
+        let mut trie = Trie::new();
+        let word_id = learn(&mut trie, "namaste", "नमस्ते", 4);
+        learn(&mut trie, "namastE", "नमस्ते", 1);
+        learn(&mut trie, "nmste", "नमस्ते", 1);
+        learn(&mut trie, "nadi", "नदी", 5);
+        assert_consistent(&trie);
+
+        // A rise through one key reaches the subtrees of the others.
+        learn(&mut trie, "nmste", "नमस्ते", 10);
+        assert_consistent(&trie);
+        assert_eq!(trie.get_top_k_suggestions("namastE", 1), vec![(word_id, 16)]);
+        assert_eq!(trie.get_top_k_suggestions("n", 2), vec![(word_id, 16), (trie.word_at("nadi").unwrap(), 5)]);
+    }
+
+    #[test]
+    fn caches_are_rebuilt_by_from_words() {
+        let mut metadata_store = MetadataStore::new();
+        let mut keys = Vec::new();
+        for (i, roman) in ["ghar", "gharma", "gaa", "gati", "gham", "ga", "gara", "gala", "gal", "gan"].iter().enumerate() {
+            let word_id = metadata_store.push(&format!("w{}", i), (i as u64 * 7) % 5);
+            metadata_store.add_variant(word_id, roman);
+            keys.push((roman.to_string(), word_id));
+        }
+        // A second key for the same word.
+        keys.push(("gharr".to_string(), keys[0].1));
+        let mut trie = Trie::from_words(metadata_store, &keys);
+        assert_consistent(&trie);
+
+        learn(&mut trie, "gati", "w3", 9);
+        learn(&mut trie, "ghaa", "w10", 1);
+        assert_consistent(&trie);
+    }
+}
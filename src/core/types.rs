@@ -5,8 +5,9 @@ use std::collections::HashSet;
 /// A unique identifier for a canonical Devanagari word.
 pub type WordId = usize;
 
-/// Rich metadata associated with a single canonical Devanagari word.
-/// This is the "value" in our learned dictionary.
+/// Rich metadata associated with a single canonical Devanagari word, as one
+/// owned value. The learned dictionary keeps it in a `MetadataStore`; this
+/// form is how unversioned snapshots stored each word.
 #[derive(Debug, Clone, Serialize, Deserialize)]
 pub struct WordMetadata {
     pub devanagari: String,
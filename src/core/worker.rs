@@ -0,0 +1,124 @@
+// File: src/core/worker.rs
+// A background thread that computes suggestions off the caller's thread. Each
+// requester (an input context) has at most one queued job: a newer request from
+// the same requester replaces the queued one, so a burst of keystrokes costs one
+// ranking pass for the latest prefix instead of one per keystroke.
+
+use std::collections::VecDeque;
+use std::io;
+use std::panic::{catch_unwind, AssertUnwindSafe};
+use std::sync::{Arc, Condvar, Mutex, MutexGuard};
+use std::thread::JoinHandle;
+
+/// How a job is being run. Every submitted job is called exactly once, with
+/// `Superseded` if it was replaced or cancelled before it could start, so it can
+/// always release what it holds.
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub enum JobStatus {
+    Run,
+    Superseded,
+}
+
+pub type Job = Box<dyn FnOnce(JobStatus) + Send>;
+
+struct Queue {
+    /// Queued jobs in arrival order, at most one per key.
+    jobs: VecDeque<(u64, Job)>,
+    shutdown: bool,
+}
+
+struct Shared {
+    queue: Mutex<Queue>,
+    wakeup: Condvar,
+}
+
+pub struct SuggestionWorker {
+    shared: Arc<Shared>,
+    thread: Option<JoinHandle<()>>,
+}
+
+impl SuggestionWorker {
+    pub fn spawn() -> io::Result<Self> {
+        let shared = Arc::new(Shared {
+            queue: Mutex::new(Queue { jobs: VecDeque::new(), shutdown: false }),
+            wakeup: Condvar::new(),
+        });
+        let worker_shared = Arc::clone(&shared);
+        let thread = std::thread::Builder::new()
+            .name("akshar-suggest".to_string())
+            .spawn(move || worker_loop(&worker_shared))?;
+        Ok(Self { shared, thread: Some(thread) })
+    }
+
+    /// Queues `job` for `key`. A job still queued for the same key is superseded
+    /// and the new one takes its place in line.
+    pub fn submit(&self, key: u64, job: Job) {
+        let superseded = {
+            let mut queue = lock(&self.shared.queue);
+            match queue.jobs.iter_mut().find(|(queued_key, _)| *queued_key == key) {
+                Some((_, queued)) => Some(std::mem::replace(queued, job)),
+                None => {
+                    queue.jobs.push_back((key, job));
+                    None
+                }
+            }
+        };
+        self.shared.wakeup.notify_one();
+        // Run outside the lock: the job may call back into C.
+        if let Some(old) = superseded {
+            old(JobStatus::Superseded);
+        }
+    }
+
+    /// Supersedes the job queued for `key`, if any. A job that already started
+    /// still runs to completion.
+    pub fn cancel(&self, key: u64) {
+        let cancelled = {
+            let mut queue = lock(&self.shared.queue);
+            let position = queue.jobs.iter().position(|(queued_key, _)| *queued_key == key);
+            position.and_then(|i| queue.jobs.remove(i))
+        };
+        if let Some((_, job)) = cancelled {
+            job(JobStatus::Superseded);
+        }
+    }
+}
+
+impl Drop for SuggestionWorker {
+    /// Supersedes whatever is still queued and waits for the running job.
+    fn drop(&mut self) {
+        let remaining: Vec<(u64, Job)> = {
+            let mut queue = lock(&self.shared.queue);
+            queue.shutdown = true;
+            queue.jobs.drain(..).collect()
+        };
+        self.shared.wakeup.notify_one();
+        for (_, job) in remaining {
+            job(JobStatus::Superseded);
+        }
+        if let Some(thread) = self.thread.take() {
+            let _ = thread.join();
+        }
+    }
+}
+
+fn worker_loop(shared: &Shared) {
+    loop {
+        let job = {
+            let mut queue = lock(&shared.queue);
+            loop {
+                if let Some((_, job)) = queue.jobs.pop_front() { break job; }
+                if queue.shutdown { return; }
+                queue = shared.wakeup.wait(queue).unwrap_or_else(|e| e.into_inner());
+            }
+        };
+        // A panicking job must not take the worker down with it.
+        if catch_unwind(AssertUnwindSafe(|| job(JobStatus::Run))).is_err() {
+            eprintln!("[Rust WARN] Suggestion job panicked");
+        }
+    }
+}
+
+fn lock<T>(mutex: &Mutex<T>) -> MutexGuard<'_, T> {
+    mutex.lock().unwrap_or_else(|e| e.into_inner())
+}
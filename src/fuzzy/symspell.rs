@@ -1,84 +1,650 @@
 // File: src/fuzzy/symspell.rs
+use crate::core::trie::Trie;
 use crate::core::types::WordId;
+use serde::ser::{SerializeStruct, Serializer};
 use serde::{Deserialize, Serialize};
+use std::cell::RefCell;
 use std::collections::{HashMap, HashSet};
 
+/// Number of leading characters of each term that go into the delete index.
+pub const DEFAULT_PREFIX_LENGTH: usize = 7;
+
+/// Terms per thread below which `from_trie` generates deletes on one thread.
+const PARALLEL_BUILD_MIN_TERMS: usize = 4096;
+
+/// A candidate whose edit distance to the input has been verified.
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub struct FuzzyMatch {
+    pub word_id: WordId,
+    pub distance: usize,
+}
+
 /// A high-performance fuzzy search and spelling correction engine based on the
 /// Symmetric Delete (SymSpell) algorithm. It pre-calculates a dictionary of "deletes"
 /// for O(1) lookup complexity (relative to dictionary size).
+///
+/// Only the first `prefix_length` characters of each term are expanded into
+/// deletes, so the index size and the per-lookup delete count stay flat as words
+/// and inputs get longer. Candidates from the index are then verified against the
+/// full term with a bounded Damerau-Levenshtein distance.
 #[derive(Clone, Serialize, Deserialize)]
 pub struct SymSpell {
-    /// Maps a delete variant (e.g., "namste") to the list of original WordIds
-    /// it could have come from (e.g., [id_for_namaste]).
-    deletes: HashMap<String, HashSet<WordId>>,
+    /// Maps the hash of a delete variant (e.g., "namste") to the indexed terms it
+    /// could have come from (e.g., the term for "namaste").
+    deletes: DeleteIndex,
+    /// Every indexed spelling, concatenated, kept for verification.
+    term_bytes: Vec<u8>,
+    /// Term index -> byte range in `term_bytes` (terms + 1 entries).
+    term_offsets: Vec<u32>,
+    /// The word each term spells.
+    term_words: Vec<u32>,
     max_edit_distance: usize,
+    prefix_length: usize,
 }
 
 impl SymSpell {
     pub fn new(max_edit_distance: usize) -> Self {
+        Self::with_prefix_length(max_edit_distance, DEFAULT_PREFIX_LENGTH)
+    }
+
+    pub fn with_prefix_length(max_edit_distance: usize, prefix_length: usize) -> Self {
         Self {
-            deletes: HashMap::new(),
+            deletes: DeleteIndex::default(),
+            term_bytes: Vec::new(),
+            term_offsets: vec![0],
+            term_words: Vec::new(),
             max_edit_distance,
+            prefix_length: prefix_length.max(max_edit_distance + 1),
         }
     }
 
-    /// Adds a word to the SymSpell dictionary by generating all its delete variants
-    /// up to the configured edit distance and mapping them back to the word's ID.
-    /// Complexity: Amortized O(k^2) where k is the word length, due to string operations.
-    pub fn add_word(&mut self, word: &str, word_id: WordId) {
-        let edits = self.generate_edits(word);
-        for edit in edits {
-            self.deletes.entry(edit).or_default().insert(word_id);
+    /// Indexes every Roman variant and Devanagari form in the trie's metadata, the
+    /// same terms `LearningEngine::learn` adds one confirmation at a time. The
+    /// delete index is built in one sort rather than by repeated merging, and the
+    /// deletes of large dictionaries are hashed on every core.
+    pub fn from_trie(trie: &Trie, max_edit_distance: usize) -> Self {
+        let mut symspell = Self::new(max_edit_distance);
+        for word in trie.metadata_store.iter() {
+            let mut variants: Vec<&str> = word.variants().collect();
+            variants.sort_unstable();
+            for term in variants.into_iter().chain(std::iter::once(word.devanagari())) {
+                symspell.push_term(term, word.id());
+            }
         }
+
+        let term_count = symspell.term_words.len();
+        let cores = std::thread::available_parallelism().map_or(1, |n| n.get());
+        let threads = (term_count / PARALLEL_BUILD_MIN_TERMS).clamp(1, cores);
+        let chunk = term_count.div_ceil(threads).max(1);
+        let entries = std::thread::scope(|scope| {
+            let symspell = &symspell;
+            let chunks: Vec<_> = (0..term_count)
+                .step_by(chunk)
+                .map(|start| scope.spawn(move || symspell.delete_entries(start..(start + chunk).min(term_count))))
+                .collect();
+            let mut entries = Vec::new();
+            for chunk in chunks {
+                entries.extend(chunk.join().unwrap_or_else(|panic| std::panic::resume_unwind(panic)));
+            }
+            entries
+        });
+        symspell.deletes = DeleteIndex::from_entries(entries);
+        symspell
+    }
+
+    /// (delete hash, term index) pairs of a range of terms.
+    fn delete_entries(&self, terms: std::ops::Range<usize>) -> Vec<(u64, u32)> {
+        with_lookup_scratch(|scratch| {
+            let mut entries = Vec::new();
+            for term_idx in terms {
+                let (term, _) = self.term(term_idx);
+                scratch.collect_delete_keys(char_prefix(term, self.prefix_length), self.max_edit_distance);
+                entries.extend(scratch.keys.iter().map(|&key| (key, term_idx as u32)));
+            }
+            entries
+        })
+    }
+
+    /// Adds a word to the SymSpell dictionary by generating all delete variants of
+    /// its prefix up to the configured edit distance and mapping them to the term.
+    /// Complexity: O(p^d) in the prefix length p, independent of the word length.
+    pub fn add_word(&mut self, word: &str, word_id: WordId) {
+        let term_idx = self.push_term(word, word_id);
+        with_lookup_scratch(|scratch| {
+            scratch.collect_delete_keys(char_prefix(word, self.prefix_length), self.max_edit_distance);
+            for &key in &scratch.keys {
+                self.deletes.insert(key, term_idx);
+            }
+        });
+    }
+
+    fn push_term(&mut self, word: &str, word_id: WordId) -> u32 {
+        let term_idx = self.term_words.len() as u32;
+        self.term_bytes.extend_from_slice(word.as_bytes());
+        self.term_offsets.push(self.term_bytes.len() as u32);
+        self.term_words.push(word_id as u32);
+        term_idx
+    }
+
+    fn term(&self, term_idx: usize) -> (&str, WordId) {
+        let range = self.term_offsets[term_idx] as usize..self.term_offsets[term_idx + 1] as usize;
+        // Terms are only ever appended from `&str`, so every range is valid UTF-8.
+        let term = std::str::from_utf8(&self.term_bytes[range]).unwrap_or_default();
+        (term, self.term_words[term_idx] as WordId)
     }
 
-    /// Looks up a potentially misspelled word by generating its deletes and
-    /// finding them in the pre-calculated dictionary.
-    /// Complexity: O(k^2) where k is the input length. Crucially, this is
-    /// independent of the main dictionary size, making it extremely fast.
+    /// Every word within the edit distance of `input`, verified but unranked.
     pub fn lookup(&self, input: &str) -> HashSet<WordId> {
-        let mut candidates = HashSet::new();
-        
-        // Check for an exact match first
-        if let Some(word_ids) = self.deletes.get(input) {
-            for &id in word_ids {
-                candidates.insert(id);
+        self.lookup_top_k(input, usize::MAX, |_| 0)
+            .into_iter()
+            .map(|m| m.word_id)
+            .collect()
+    }
+
+    /// Looks up a potentially misspelled word by generating the deletes of its
+    /// prefix, verifies each candidate term with a bounded Damerau-Levenshtein
+    /// distance, and returns the best `k` words ordered by distance, then frequency.
+    /// Hash collisions only add candidates, which verification then rejects.
+    pub fn lookup_top_k(&self, input: &str, k: usize, frequency: impl Fn(WordId) -> u64) -> Vec<FuzzyMatch> {
+        with_lookup_scratch(|scratch| {
+            scratch.collect_delete_keys(char_prefix(input, self.prefix_length), self.max_edit_distance);
+            let LookupScratch { keys, term_ids, .. } = scratch;
+            for &key in keys.iter() {
+                term_ids.extend(self.deletes.get(key));
+            }
+            scratch.rank(input, |term_idx| Some(self.term(term_idx as usize)), self.max_edit_distance, k, frequency)
+        })
+    }
+
+    pub fn max_edit_distance(&self) -> usize {
+        self.max_edit_distance
+    }
+
+    pub fn prefix_length(&self) -> usize {
+        self.prefix_length
+    }
+
+    pub(crate) fn terms(&self) -> impl Iterator<Item = (&str, WordId)> {
+        (0..self.term_words.len()).map(move |idx| self.term(idx))
+    }
+
+    /// The delete index with pending additions merged in: sorted hashed keys, an
+    /// offsets array (keys + 1 entries) and the term postings they address.
+    pub(crate) fn compact_deletes(&self) -> (Vec<u64>, Vec<u32>, Vec<u32>) {
+        let mut index = self.deletes.clone();
+        index.merge();
+        (index.keys, index.offsets, index.postings)
+    }
+}
+
+/// Pending postings always allowed before a merge, so small dictionaries do not
+/// merge on every word.
+const MIN_PENDING_POSTINGS: usize = 4096;
+
+/// Hashed delete keys pointing into one flat `u32` postings array. Keys are
+/// sorted and looked up by binary search; postings for key `i` are
+/// `postings[offsets[i]..offsets[i + 1]]`. New entries collect in `pending` and
+/// are merged in once they exceed a quarter of the base, which keeps the
+/// amortized cost per insert constant.
+#[derive(Clone, Deserialize)]
+#[serde(from = "StoredDeleteIndex")]
+struct DeleteIndex {
+    keys: Vec<u64>,
+    offsets: Vec<u32>,
+    postings: Vec<u32>,
+    pending: HashMap<u64, Vec<u32>>,
+    pending_postings: usize,
+}
+
+impl Default for DeleteIndex {
+    fn default() -> Self {
+        Self {
+            keys: Vec::new(),
+            offsets: vec![0],
+            postings: Vec::new(),
+            pending: HashMap::new(),
+            pending_postings: 0,
+        }
+    }
+}
+
+/// On-disk form of `DeleteIndex`: pending postings are stored as flat
+/// (key, term) pairs rather than as a map of small vectors.
+#[derive(Deserialize)]
+struct StoredDeleteIndex {
+    keys: Vec<u64>,
+    offsets: Vec<u32>,
+    postings: Vec<u32>,
+    pending: Vec<(u64, u32)>,
+}
+
+impl From<StoredDeleteIndex> for DeleteIndex {
+    fn from(stored: StoredDeleteIndex) -> Self {
+        let mut index = Self {
+            keys: stored.keys,
+            offsets: stored.offsets,
+            postings: stored.postings,
+            pending: HashMap::new(),
+            pending_postings: stored.pending.len(),
+        };
+        for (key, term_idx) in stored.pending {
+            index.pending.entry(key).or_default().push(term_idx);
+        }
+        index
+    }
+}
+
+impl Serialize for DeleteIndex {
+    fn serialize<S: Serializer>(&self, serializer: S) -> Result<S::Ok, S::Error> {
+        let pending: Vec<(u64, u32)> = self
+            .pending
+            .iter()
+            .flat_map(|(&key, term_ids)| term_ids.iter().map(move |&term_idx| (key, term_idx)))
+            .collect();
+        let mut state = serializer.serialize_struct("StoredDeleteIndex", 4)?;
+        state.serialize_field("keys", &self.keys)?;
+        state.serialize_field("offsets", &self.offsets)?;
+        state.serialize_field("postings", &self.postings)?;
+        state.serialize_field("pending", &pending)?;
+        state.end()
+    }
+}
+
+impl DeleteIndex {
+    fn from_entries(mut entries: Vec<(u64, u32)>) -> Self {
+        entries.sort_unstable();
+        entries.dedup();
+        let mut index = Self::default();
+        index.postings.reserve_exact(entries.len());
+        for (key, term_idx) in entries {
+            if index.keys.last() != Some(&key) {
+                if !index.keys.is_empty() {
+                    index.offsets.push(index.postings.len() as u32);
+                }
+                index.keys.push(key);
+            }
+            index.postings.push(term_idx);
+        }
+        if !index.keys.is_empty() {
+            index.offsets.push(index.postings.len() as u32);
+        }
+        index
+    }
+
+    fn insert(&mut self, key: u64, term_idx: u32) {
+        self.pending.entry(key).or_default().push(term_idx);
+        self.pending_postings += 1;
+        if self.pending_postings > MIN_PENDING_POSTINGS.max(self.postings.len() / 4) {
+            self.merge();
+        }
+    }
+
+    fn get(&self, key: u64) -> impl Iterator<Item = u32> + '_ {
+        let base = match self.keys.binary_search(&key) {
+            Ok(idx) => &self.postings[self.offsets[idx] as usize..self.offsets[idx + 1] as usize],
+            Err(_) => &[],
+        };
+        let pending = self.pending.get(&key).map_or(&[][..], Vec::as_slice);
+        base.iter().chain(pending).copied()
+    }
+
+    /// Folds `pending` into the sorted arrays in a single linear pass.
+    fn merge(&mut self) {
+        if self.pending.is_empty() {
+            return;
+        }
+        let mut pending: Vec<(u64, Vec<u32>)> = std::mem::take(&mut self.pending).into_iter().collect();
+        pending.sort_unstable_by_key(|(key, _)| *key);
+
+        let mut keys = Vec::with_capacity(self.keys.len() + pending.len());
+        let mut offsets = Vec::with_capacity(keys.capacity() + 1);
+        let mut postings = Vec::with_capacity(self.postings.len() + self.pending_postings);
+        offsets.push(0);
+
+        let mut base = (0..self.keys.len()).peekable();
+        let mut pending = pending.into_iter().peekable();
+        loop {
+            let base_key = base.peek().map(|&idx| self.keys[idx]);
+            let pending_key = pending.peek().map(|(key, _)| *key);
+            let key = match (base_key, pending_key) {
+                (None, None) => break,
+                (Some(b), Some(p)) => b.min(p),
+                (Some(b), None) => b,
+                (None, Some(p)) => p,
+            };
+            if base_key == Some(key) {
+                let idx = base.next().unwrap();
+                postings.extend_from_slice(&self.postings[self.offsets[idx] as usize..self.offsets[idx + 1] as usize]);
+            }
+            if pending_key == Some(key) {
+                postings.extend(pending.next().unwrap().1);
+            }
+            keys.push(key);
+            offsets.push(postings.len() as u32);
+        }
+
+        self.keys = keys;
+        self.offsets = offsets;
+        self.postings = postings;
+        self.pending_postings = 0;
+    }
+}
+
+/// The first `n` characters of `word`.
+pub(crate) fn char_prefix(word: &str, n: usize) -> &str {
+    word.char_indices().nth(n).map_or(word, |(end, _)| &word[..end])
+}
+
+/// Buffers of one fuzzy lookup, kept per thread so that steady-state lookups
+/// only allocate their result.
+#[derive(Default)]
+pub(crate) struct LookupScratch {
+    /// Hashes of the deletes of the input prefix, sorted and unique.
+    pub(crate) keys: Vec<u64>,
+    /// Candidate term indices gathered from the postings of `keys`.
+    pub(crate) term_ids: Vec<u32>,
+    char_starts: Vec<usize>,
+    deleted: Vec<usize>,
+    input_chars: Vec<char>,
+    term_chars: Vec<char>,
+    rows: DistanceRows,
+    /// Verified (match, frequency) pairs.
+    verified: Vec<(FuzzyMatch, u64)>,
+}
+
+thread_local! {
+    static LOOKUP_SCRATCH: RefCell<LookupScratch> = RefCell::new(LookupScratch::default());
+}
+
+/// Runs `f` with this thread's lookup buffers, emptied of the previous lookup.
+pub(crate) fn with_lookup_scratch<R>(f: impl FnOnce(&mut LookupScratch) -> R) -> R {
+    LOOKUP_SCRATCH.with(|cell| {
+        let mut scratch = cell.borrow_mut();
+        scratch.term_ids.clear();
+        scratch.verified.clear();
+        f(&mut scratch)
+    })
+}
+
+impl LookupScratch {
+    /// Fills `keys` with the FNV-1a hashes of `word` and of every variant of it
+    /// with up to `max_edit_distance` characters deleted, hashing each variant in
+    /// place instead of building it as a string.
+    pub(crate) fn collect_delete_keys(&mut self, word: &str, max_edit_distance: usize) {
+        self.keys.clear();
+        self.deleted.clear();
+        self.char_starts.clear();
+        self.char_starts.extend(word.char_indices().map(|(i, _)| i));
+        self.char_starts.push(word.len());
+        self.push_deletes(word, 0, max_edit_distance);
+        self.keys.sort_unstable();
+        self.keys.dedup();
+    }
+
+    /// Hashes `word` without the characters in `deleted`, then recurses into every
+    /// further delete after the last one, up to `remaining` more.
+    fn push_deletes(&mut self, word: &str, from: usize, remaining: usize) {
+        let mut hash: u64 = 0xcbf2_9ce4_8422_2325;
+        let mut deleted = self.deleted.iter().peekable();
+        for c in 0..self.char_starts.len() - 1 {
+            if deleted.next_if_eq(&&c).is_some() { continue; }
+            for &byte in &word.as_bytes()[self.char_starts[c]..self.char_starts[c + 1]] {
+                hash ^= byte as u64;
+                hash = hash.wrapping_mul(0x0000_0100_0000_01b3);
+            }
+        }
+        self.keys.push(hash);
+
+        if remaining == 0 { return; }
+        for c in from..self.char_starts.len() - 1 {
+            self.deleted.push(c);
+            self.push_deletes(word, c + 1, remaining - 1);
+            self.deleted.pop();
+        }
+    }
+
+    /// Verifies the gathered `term_ids` against `input` and keeps the best `k`
+    /// words, ordered by edit distance, then descending frequency. A word
+    /// reachable through several terms keeps its closest one.
+    pub(crate) fn rank<'a>(
+        &mut self,
+        input: &str,
+        term: impl Fn(u32) -> Option<(&'a str, WordId)>,
+        max_edit_distance: usize,
+        k: usize,
+        frequency: impl Fn(WordId) -> u64,
+    ) -> Vec<FuzzyMatch> {
+        self.term_ids.sort_unstable();
+        self.term_ids.dedup();
+        self.input_chars.clear();
+        self.input_chars.extend(input.chars());
+
+        for &term_idx in &self.term_ids {
+            let Some((term, word_id)) = term(term_idx) else { continue };
+            self.term_chars.clear();
+            self.term_chars.extend(term.chars());
+            if let Some(distance) = self.rows.bounded_distance(&self.input_chars, &self.term_chars, max_edit_distance) {
+                self.verified.push((FuzzyMatch { word_id, distance }, 0));
             }
         }
 
-        // Check for matches within the edit distance
-        let edits = self.generate_edits(input);
-        for edit in edits {
-            if let Some(word_ids) = self.deletes.get(&edit) {
-                for &id in word_ids {
-                    candidates.insert(id);
+        // Closest term per word first, then keep only that one.
+        self.verified.sort_unstable_by_key(|&(m, _)| (m.word_id, m.distance));
+        self.verified.dedup_by_key(|(m, _)| m.word_id);
+        for (m, freq) in self.verified.iter_mut() {
+            *freq = frequency(m.word_id);
+        }
+        self.verified.sort_unstable_by_key(|&(m, freq)| (m.distance, std::cmp::Reverse(freq), m.word_id));
+        self.verified.iter().take(k).map(|&(m, _)| m).collect()
+    }
+}
+
+/// Whether `a` and `b` are within `max_edit_distance` of each other, with the
+/// same distance that `lookup_top_k` verifies candidates with.
+pub(crate) fn within_distance(a: &str, b: &str, max_edit_distance: usize) -> bool {
+    let a_chars: Vec<char> = a.chars().collect();
+    let b_chars: Vec<char> = b.chars().collect();
+    DistanceRows::default().bounded_distance(&a_chars, &b_chars, max_edit_distance).is_some()
+}
+
+/// Reusable dynamic-programming rows for the distance computation.
+#[derive(Default)]
+struct DistanceRows {
+    before_previous: Vec<usize>,
+    previous: Vec<usize>,
+    current: Vec<usize>,
+}
+
+impl DistanceRows {
+    /// Optimal-string-alignment Damerau-Levenshtein distance between `a` and `b`,
+    /// or `None` as soon as it is known to exceed `max`. Only a diagonal band of
+    /// width 2 * max + 1 is evaluated, so the cost is O(max * len).
+    fn bounded_distance(&mut self, a: &[char], b: &[char], max: usize) -> Option<usize> {
+        if a.len().abs_diff(b.len()) > max {
+            return None;
+        }
+        let over = max + 1;
+        let width = b.len() + 1;
+        for row in [&mut self.before_previous, &mut self.previous, &mut self.current] {
+            row.clear();
+            row.resize(width, over);
+        }
+        for (j, cell) in self.previous.iter_mut().enumerate().take(over.min(width)) {
+            *cell = j;
+        }
+
+        for i in 1..=a.len() {
+            let lo = i.saturating_sub(max).max(1);
+            let hi = (i + max).min(b.len());
+            self.current.fill(over);
+            if i <= max {
+                self.current[0] = i;
+            }
+            let mut row_min = self.current[0];
+            for j in lo..=hi {
+                let cost = usize::from(a[i - 1] != b[j - 1]);
+                let mut value = (self.previous[j - 1] + cost)
+                    .min(self.previous[j] + 1)
+                    .min(self.current[j - 1] + 1);
+                if i > 1 && j > 1 && a[i - 1] == b[j - 2] && a[i - 2] == b[j - 1] {
+                    value = value.min(self.before_previous[j - 2] + 1);
                 }
+                let value = value.min(over);
+                self.current[j] = value;
+                row_min = row_min.min(value);
             }
+            if row_min > max {
+                return None;
+            }
+            std::mem::swap(&mut self.before_previous, &mut self.previous);
+            std::mem::swap(&mut self.previous, &mut self.current);
         }
-        candidates
+
+        let distance = self.previous[b.len()];
+        (distance <= max).then_some(distance)
     }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
 
-    /// Generates all unique string variants within the max_edit_distance.
-    /// This includes the original string itself.
-    fn generate_edits(&self, word: &str) -> HashSet<String> {
-        let mut edits = HashSet::new();
-        edits.insert(word.to_string()); // Distance 0
+    /// Optimal-string-alignment distance over the full table.
+    fn full_distance(a: &str, b: &str) -> usize {
+        let (a, b): (Vec<char>, Vec<char>) = (a.chars().collect(), b.chars().collect());
+        let mut table = vec![vec![0; b.len() + 1]; a.len() + 1];
+        for i in 0..=a.len() {
+            for j in 0..=b.len() {
+                table[i][j] = match (i, j) {
+                    (0, _) => j,
+                    (_, 0) => i,
+                    _ => {
+                        let cost = usize::from(a[i - 1] != b[j - 1]);
+                        let mut value = (table[i - 1][j - 1] + cost).min(table[i - 1][j] + 1).min(table[i][j - 1] + 1);
+                        if i > 1 && j > 1 && a[i - 1] == b[j - 2] && a[i - 2] == b[j - 1] {
+                            value = value.min(table[i - 2][j - 2] + 1);
+                        }
+                        value
+                    }
+                };
+            }
+        }
+        table[a.len()][b.len()]
+    }
 
-        let mut current_edits = edits.clone();
+    /// Pseudo-random words over a small alphabet, so that many are close.
+    fn words(count: usize, seed: u64) -> Vec<String> {
+        let mut state = seed;
+        (0..count)
+            .map(|_| {
+                state = state.wrapping_mul(6364136223846793005).wrapping_add(1442695040888963407);
+                let len = 3 + (state >> 60) as usize;
+                (0..len).map(|i| b"aeikmnrst"[((state >> (3 * i + 5)) % 9) as usize] as char).collect()
+            })
+            .collect()
+    }
 
-        for _ in 0..self.max_edit_distance {
-            let mut next_edits = HashSet::new();
-            for edit in current_edits {
-                for i in 0..edit.len() {
-                    let mut deleted_variant = edit.clone();
-                    deleted_variant.remove(i);
-                    next_edits.insert(deleted_variant);
+    fn frequency(word_id: WordId) -> u64 {
+        (word_id as u64 * 7) % 11
+    }
+
+    #[test]
+    fn banded_distance_matches_the_full_table() {
+        let samples = words(120, 3);
+        for a in &samples {
+            for b in samples.iter().take(40) {
+                let distance = full_distance(a, b);
+                for max in 0..=3 {
+                    assert_eq!(within_distance(a, b, max), distance <= max, "{} / {} within {}", a, b, max);
                 }
             }
-            edits.extend(next_edits.clone());
-            current_edits = next_edits;
         }
-        
-        edits
+        let mut rows = DistanceRows::default();
+        let mut distance = |a: &str, b: &str, max| {
+            let (a, b): (Vec<char>, Vec<char>) = (a.chars().collect(), b.chars().collect());
+            rows.bounded_distance(&a, &b, max)
+        };
+        assert_eq!(distance("namaste", "namaste", 0), Some(0));
+        assert_eq!(distance("namaste", "nmaste", 2), Some(1));
+        assert_eq!(distance("namaste", "anmaste", 2), Some(1));
+        assert_eq!(distance("namaste", "namasetk", 2), Some(2));
+        // Optimal string alignment never edits a transposed pair again.
+        assert_eq!(distance("ca", "abc", 3), Some(3));
+        assert_eq!(distance("ca", "abc", 2), None);
+        assert_eq!(distance("नमस्ते", "नमसते", 1), Some(1));
+    }
+
+    #[test]
+    fn lookups_agree_before_and_after_a_merge() {
+        let mut symspell = SymSpell::new(2);
+        let terms = words(600, 11);
+        for (word_id, term) in terms.iter().enumerate() {
+            symspell.add_word(term, word_id);
+        }
+        // Enough deletes for earlier merges, and some still pending.
+        assert!(!symspell.deletes.keys.is_empty());
+        assert!(!symspell.deletes.pending.is_empty());
+
+        let mut merged = symspell.clone();
+        merged.deletes.merge();
+        assert!(merged.deletes.pending.is_empty());
+        assert_eq!(merged.deletes.offsets.len(), merged.deletes.keys.len() + 1);
+        assert!(merged.deletes.keys.windows(2).all(|pair| pair[0] < pair[1]));
+        let (keys, offsets, postings) = symspell.compact_deletes();
+        assert_eq!(keys, merged.deletes.keys);
+        assert_eq!(offsets, merged.deletes.offsets);
+        assert_eq!(postings, merged.deletes.postings);
+
+        for input in words(80, 5).iter().chain(terms.iter().take(20)) {
+            let mut expected: Vec<(usize, std::cmp::Reverse<u64>, WordId)> = terms
+                .iter()
+                .enumerate()
+                .map(|(word_id, term)| (full_distance(input, term), std::cmp::Reverse(frequency(word_id)), word_id))
+                .filter(|&(distance, ..)| distance <= 2)
+                .collect();
+            expected.sort_unstable();
+            let expected: Vec<FuzzyMatch> =
+                expected.into_iter().map(|(distance, _, word_id)| FuzzyMatch { word_id, distance }).collect();
+            assert_eq!(symspell.lookup_top_k(input, usize::MAX, frequency), expected, "{} pending", input);
+            assert_eq!(merged.lookup_top_k(input, usize::MAX, frequency), expected, "{} merged", input);
+            assert_eq!(merged.lookup_top_k(input, 3, frequency)[..], expected[..expected.len().min(3)]);
+        }
     }
-}
\ No newline at end of file
+
+    #[test]
+    fn ties_rank_by_frequency_then_word_id() {
+        let mut symspell = SymSpell::new(2);
+        for (word_id, term) in ["ghar", "gharaa", "gar", "gahr", "ghr"].iter().enumerate() {
+            symspell.add_word(term, word_id);
+        }
+        // A second, closer spelling of word 1, which it is ranked by.
+        symspell.add_word("ghara", 1);
+        let frequencies = [5, 9, 9, 2, 9];
+        let matches = symspell.lookup_top_k("ghar", 10, |word_id| frequencies[word_id]);
+        let ranked: Vec<(WordId, usize)> = matches.iter().map(|m| (m.word_id, m.distance)).collect();
+        // "gahr" is one transposition away.
+        assert_eq!(ranked, vec![(0, 0), (1, 1), (2, 1), (4, 1), (3, 1)]);
+        assert_eq!(symspell.lookup_top_k("ghar", 2, |word_id| frequencies[word_id]).len(), 2);
+    }
+
+    #[test]
+    fn only_the_prefix_is_indexed_but_the_whole_term_is_verified() {
+        let mut symspell = SymSpell::with_prefix_length(1, 4);
+        symspell.add_word("kathmandu", 0);
+        symspell.add_word("कमलपोखरी", 1);
+        assert_eq!(symspell.prefix_length(), 4);
+        assert_eq!(SymSpell::with_prefix_length(2, 1).prefix_length(), 3);
+        assert_eq!(char_prefix("कमलपोखरी", 2), "कम");
+        assert_eq!(char_prefix("ab", 5), "ab");
+
+        // One edit inside the prefix or past it is found either way.
+        assert_eq!(symspell.lookup("kathmundu"), HashSet::from([0]));
+        assert_eq!(symspell.lookup("kthmandu"), HashSet::from([0]));
+        assert_eq!(symspell.lookup("कमलपोखर"), HashSet::from([1]));
+        // Past the prefix, two edits share every delete but fail verification.
+        assert!(symspell.lookup("kathmxnxu").is_empty());
+        // The indexed forms hold only prefix-length deletes.
+        let keys = symspell.deletes.pending.len();
+        assert!(keys <= 2 * (4 + 1), "{} keys", keys);
+    }
+}
@@ -1,6 +1,5 @@
 // src/ibus_engine.c
 #include <ibus.h>
-#include <jansson.h>
 #include <stdio.h>
 #include <string.h>
 #include <stdarg.h>
@@ -12,6 +11,103 @@ char *akshar_ime_get_suggestions(const char *prefix);
 void akshar_ime_confirm_word(const char *roman, const char *devanagari);
 void akshar_ime_free_string(char *s);
 
+// Incremental composition sessions: the Rust side keeps the trie cursor and
+// transliteration state between keystrokes.
+typedef struct AksharSession AksharSession;
+AksharSession *akshar_ime_session_open(void);
+// Opens a session that transliterates with one `RomanizationScheme` (see
+// converter.rs). Sessions of every scheme share the one loaded dictionary.
+AksharSession *akshar_ime_session_open_with_scheme(guint32 scheme);
+void akshar_ime_session_close(AksharSession *session);
+void akshar_ime_session_push_char(AksharSession *session, guint32 codepoint);
+void akshar_ime_session_pop_char(AksharSession *session);
+void akshar_ime_session_clear(AksharSession *session);
+char *akshar_ime_session_get_suggestions(const AksharSession *session);
+
+// Binary candidate buffers. Mirrors `AksharCandidate` in c_api.rs: each record is
+// this header followed by NUL-terminated UTF-8 text, padded to an 8-byte boundary.
+typedef struct
+{
+    guint64 score;
+    guint32 len;
+    guint8 source;
+    guint8 reserved[3];
+} AksharCandidate;
+gint akshar_ime_fill_candidates(const char *prefix, guint32 max_count, void *buf, gsize buf_len);
+gint akshar_ime_session_fill_candidates(const AksharSession *session, guint32 max_count, void *buf, gsize buf_len);
+
+// Asynchronous candidates: ranking runs on a Rust worker thread and the callback
+// is called there, exactly once per request. A negative count means the request
+// was superseded by a newer one and `buf` is NULL.
+typedef void (*AksharCandidatesCallback)(gpointer user_data, guint64 generation, const guint8 *buf, gsize buf_len,
+                                         gint count);
+guint64 akshar_ime_session_request_candidates(const AksharSession *session, guint32 max_count,
+                                              AksharCandidatesCallback callback, gpointer user_data);
+
+// Direct commits: both write NUL-terminated UTF-8 into `buf` and return its
+// length, 0 if there is nothing to commit, or -1 if `buf` is too small.
+// `akshar_ime_session_commit_top` also confirms the word and clears the session;
+// it ranks with `max_count` candidates, so pass the count the list is shown with.
+gint akshar_ime_session_commit_top(AksharSession *session, guint32 max_count, char *buf, gsize buf_len);
+// Confirms a chosen candidate for the session's word. Each engine instance has
+// its own session, so words committed in one input context only rerank that one.
+void akshar_ime_session_confirm_word(AksharSession *session, const char *devanagari);
+gint akshar_ime_transliterate_symbol(guint32 codepoint, char *buf, gsize buf_len);
+
+// Next-word predictions: likely successors of the session's last committed
+// word, read from precomputed lists, so they are filled synchronously. A picked
+// prediction is confirmed with `akshar_ime_session_accept_prediction`.
+gint akshar_ime_session_fill_predictions(const AksharSession *session, guint32 max_count, void *buf, gsize buf_len);
+void akshar_ime_session_accept_prediction(AksharSession *session, const char *devanagari);
+
+// Latency statistics: a JSON object of per-stage histograms (free it with
+// `akshar_ime_free_string`), and the request-to-display time measured here.
+char *akshar_ime_get_stats(void);
+void akshar_ime_record_round_trip(guint64 nanos);
+
+#define AKSHAR_MAX_CANDIDATES 8
+#define AKSHAR_CANDIDATE_BUFFER_SIZE 4096
+
+static inline const char *akshar_candidate_text(const AksharCandidate *candidate)
+{
+    return (const char *)(candidate + 1);
+}
+
+static inline const AksharCandidate *akshar_candidate_next(const AksharCandidate *candidate)
+{
+    gsize record_len = (sizeof(AksharCandidate) + candidate->len + 1 + 7) & ~(gsize)7;
+    return (const AksharCandidate *)((const guint8 *)candidate + record_len);
+}
+
+// --- Layouts ---
+// Every engine name this process registers, with its own configuration. All
+// of them share one Rust engine, so the dictionary and the suggestion worker
+// are loaded once however many layouts are enabled.
+#define AKSHAR_SCHEME_STANDARD 0
+#define AKSHAR_SCHEME_NEPALI 1
+
+typedef struct
+{
+    const char *name;      // engine name, as in the component XML
+    guint32 scheme;        // RomanizationScheme discriminant
+    guint candidate_count; // candidates requested and shown, at most AKSHAR_MAX_CANDIDATES
+} AksharLayout;
+
+static const AksharLayout akshar_layouts[] = {
+    {"devanagari-smart", AKSHAR_SCHEME_STANDARD, 8},
+    {"nepali-smart", AKSHAR_SCHEME_NEPALI, 5},
+};
+
+static const AksharLayout *akshar_layout_for(const char *engine_name)
+{
+    for (gsize i = 0; i < G_N_ELEMENTS(akshar_layouts); i++)
+    {
+        if (g_strcmp0(akshar_layouts[i].name, engine_name) == 0)
+            return &akshar_layouts[i];
+    }
+    return &akshar_layouts[0];
+}
+
 // --- GObject Boilerplate ---
 typedef struct _IBusDevanagariEngine IBusDevanagariEngine;
 typedef struct _IBusDevanagariEngineClass IBusDevanagariEngineClass;
@@ -20,6 +116,16 @@ struct _IBusDevanagariEngine
     IBusEngine parent;
     IBusLookupTable *table;
     GString *preedit_string;
+    AksharSession *session;
+    const AksharLayout *layout;
+    // Generation of the latest candidate request, and of the one the lookup
+    // table shows. They differ while the table still lists an older prefix.
+    guint64 requested_generation;
+    guint64 shown_generation;
+    // The lookup table lists next-word predictions rather than candidates for
+    // a preedit. Its cursor stays hidden until the user moves it.
+    gboolean showing_predictions;
+    guint64 candidate_buffer[AKSHAR_CANDIDATE_BUFFER_SIZE / sizeof(guint64)];
 };
 struct _IBusDevanagariEngineClass
 {
@@ -28,6 +134,7 @@ struct _IBusDevanagariEngineClass
 static guint g_engine_instance_count = 0;
 static void ibus_devanagari_engine_class_init(IBusDevanagariEngineClass *klass);
 static void ibus_devanagari_engine_init_instance(IBusDevanagariEngine *engine);
+static void ibus_devanagari_engine_constructed(GObject *object);
 static void ibus_devanagari_engine_finalize(GObject *object);
 static gboolean ibus_devanagari_engine_process_key_event(IBusEngine *engine, guint keyval, guint keycode, guint modifiers);
 static void ibus_devanagari_engine_candidate_clicked(IBusEngine *engine, guint index, guint button, guint state);
@@ -41,6 +148,7 @@ static void ibus_devanagari_engine_class_init(IBusDevanagariEngineClass *klass)
     GObjectClass *object_class = G_OBJECT_CLASS(klass);
     engine_class->process_key_event = ibus_devanagari_engine_process_key_event;
     engine_class->candidate_clicked = ibus_devanagari_engine_candidate_clicked;
+    object_class->constructed = ibus_devanagari_engine_constructed;
     object_class->finalize = ibus_devanagari_engine_finalize;
 }
 static void ibus_devanagari_engine_init_instance(IBusDevanagariEngine *engine)
@@ -55,8 +163,20 @@ static void ibus_devanagari_engine_init_instance(IBusDevanagariEngine *engine)
     g_engine_instance_count++;
 }
 static void ibus_devanagari_engine_init(IBusDevanagariEngine *engine) { ibus_devanagari_engine_init_instance(engine); }
+// The engine name is a construct property, so the layout is only known here.
+static void ibus_devanagari_engine_constructed(GObject *object)
+{
+    G_OBJECT_CLASS(ibus_devanagari_engine_parent_class)->constructed(object);
+    IBusDevanagariEngine *engine = (IBusDevanagariEngine *)object;
+    engine->layout = akshar_layout_for(ibus_engine_get_name((IBusEngine *)engine));
+    ibus_lookup_table_set_page_size(engine->table, engine->layout->candidate_count);
+    engine->session = akshar_ime_session_open_with_scheme(engine->layout->scheme);
+}
 static void ibus_devanagari_engine_finalize(GObject *object)
 {
+    IBusDevanagariEngine *devanagari_engine = (IBusDevanagariEngine *)object;
+    akshar_ime_session_close(devanagari_engine->session);
+    devanagari_engine->session = NULL;
     g_engine_instance_count--;
     if (g_engine_instance_count == 0)
     {
@@ -69,52 +189,154 @@ static void ibus_devanagari_engine_finalize(GObject *object)
 static void clear_preedit(IBusDevanagariEngine *devanagari_engine)
 {
     g_string_set_size(devanagari_engine->preedit_string, 0);
+    akshar_ime_session_clear(devanagari_engine->session);
+    // Drop whatever is still in flight for the cleared input.
+    devanagari_engine->requested_generation = 0;
+    devanagari_engine->shown_generation = 0;
     ibus_engine_hide_preedit_text((IBusEngine *)devanagari_engine);
     ibus_engine_hide_lookup_table((IBusEngine *)devanagari_engine);
 }
 
-static void update_preedit_and_lookup(IBusDevanagariEngine *devanagari_engine)
+static void show_candidates(IBusDevanagariEngine *devanagari_engine, const void *buf, gint count)
 {
     IBusEngine *engine = (IBusEngine *)devanagari_engine;
-    const char *preedit_str = devanagari_engine->preedit_string->str;
+    ibus_lookup_table_clear(devanagari_engine->table);
+    ibus_lookup_table_set_cursor_visible(devanagari_engine->table, !devanagari_engine->showing_predictions);
 
-    if (strlen(preedit_str) == 0)
+    const AksharCandidate *candidate = (const AksharCandidate *)buf;
+    for (gint i = 0; i < count; i++, candidate = akshar_candidate_next(candidate))
     {
-    clear_preedit(devanagari_engine);
-        return;
+        IBusText *candidate_text = ibus_text_new_from_string(akshar_candidate_text(candidate));
+        ibus_lookup_table_append_candidate(devanagari_engine->table, candidate_text);
     }
 
-    IBusText *preedit_text = ibus_text_new_from_string(preedit_str);
-    ibus_engine_update_preedit_text(engine, preedit_text, strlen(preedit_str), TRUE);
+    if (ibus_lookup_table_get_number_of_candidates(devanagari_engine->table) > 0)
+    {
+        ibus_engine_update_lookup_table(engine, devanagari_engine->table, TRUE);
+    }
+    else
+    {
+        ibus_engine_hide_lookup_table(engine);
+    }
+}
+
+// Shows the likely next words after the word just committed, if any.
+static void show_predictions(IBusDevanagariEngine *devanagari_engine)
+{
+    gint count = akshar_ime_session_fill_predictions(devanagari_engine->session, devanagari_engine->layout->candidate_count,
+                                                     devanagari_engine->candidate_buffer,
+                                                     sizeof(devanagari_engine->candidate_buffer));
+    if (count <= 0)
+        return;
+    devanagari_engine->showing_predictions = TRUE;
+    show_candidates(devanagari_engine, devanagari_engine->candidate_buffer, count);
+}
+
+static void hide_predictions(IBusDevanagariEngine *devanagari_engine)
+{
+    if (!devanagari_engine->showing_predictions)
+        return;
+    devanagari_engine->showing_predictions = FALSE;
     ibus_lookup_table_clear(devanagari_engine->table);
+    ibus_engine_hide_lookup_table((IBusEngine *)devanagari_engine);
+}
+
+// Commits the prediction under the cursor and predicts the word after it.
+static void accept_prediction(IBusDevanagariEngine *devanagari_engine)
+{
+    guint index = ibus_lookup_table_get_cursor_pos(devanagari_engine->table);
+    IBusText *prediction = ibus_lookup_table_get_candidate(devanagari_engine->table, index);
+    if (prediction && prediction->text)
+    {
+        g_object_ref(prediction);
+        ibus_engine_commit_text((IBusEngine *)devanagari_engine, prediction);
+        akshar_ime_session_accept_prediction(devanagari_engine->session, prediction->text);
+        g_object_unref(prediction);
+    }
+    hide_predictions(devanagari_engine);
+    show_predictions(devanagari_engine);
+}
+
+// One asynchronous candidate request, carried from the main loop to the worker
+// thread and back. It only holds a weak reference, so an engine finalized in
+// the meantime simply drops its results.
+typedef struct
+{
+    GWeakRef engine;
+    guint64 generation;
+    gint64 requested_at; // g_get_monotonic_time() when the request was made
+    gint count;
+    guint8 *candidates;
+} AksharCandidateDelivery;
 
-    char *suggestions_json = akshar_ime_get_suggestions(preedit_str);
-    json_error_t error;
-    json_t *root = json_loads(suggestions_json, 0, &error);
+static void candidate_delivery_free(AksharCandidateDelivery *delivery)
+{
+    g_weak_ref_clear(&delivery->engine);
+    g_free(delivery->candidates);
+    g_free(delivery);
+}
 
-    if (root && json_is_array(root))
+// Runs on the main loop. Results for a prefix that has since changed are dropped.
+static gboolean deliver_candidates(gpointer user_data)
+{
+    AksharCandidateDelivery *delivery = user_data;
+    IBusDevanagariEngine *devanagari_engine = g_weak_ref_get(&delivery->engine);
+    if (devanagari_engine)
     {
-        size_t i;
-        json_t *value;
-        json_array_foreach(root, i, value)
+        if (delivery->generation == devanagari_engine->requested_generation)
         {
-            if (json_is_string(value))
-            {
-                IBusText *candidate_text = ibus_text_new_from_string(json_string_value(value));
-                ibus_lookup_table_append_candidate(devanagari_engine->table, candidate_text);
-            }
+            show_candidates(devanagari_engine, delivery->candidates, delivery->count);
+            devanagari_engine->shown_generation = delivery->generation;
+            akshar_ime_record_round_trip((guint64)(g_get_monotonic_time() - delivery->requested_at) * 1000);
         }
-        json_decref(root);
+        g_object_unref(devanagari_engine);
     }
-    akshar_ime_free_string(suggestions_json);
+    candidate_delivery_free(delivery);
+    return G_SOURCE_REMOVE;
+}
 
-    if (ibus_lookup_table_get_number_of_candidates(devanagari_engine->table) > 0)
+// Runs on the Rust worker thread: copy the buffer and hand it to the main loop.
+static void on_candidates_ready(gpointer user_data, guint64 generation, const guint8 *buf, gsize buf_len, gint count)
+{
+    AksharCandidateDelivery *delivery = user_data;
+    if (count < 0)
     {
-        ibus_engine_update_lookup_table(engine, devanagari_engine->table, TRUE);
+        candidate_delivery_free(delivery);
+        return;
     }
-    else
+    delivery->generation = generation;
+    delivery->count = count;
+    delivery->candidates = g_malloc(buf_len);
+    memcpy(delivery->candidates, buf, buf_len);
+    g_idle_add(deliver_candidates, delivery);
+}
+
+// Echoes the preedit at once and ranks candidates off the main loop. The lookup
+// table keeps showing the previous candidates until the new ones arrive.
+static void update_preedit_and_lookup(IBusDevanagariEngine *devanagari_engine)
+{
+    IBusEngine *engine = (IBusEngine *)devanagari_engine;
+    const char *preedit_str = devanagari_engine->preedit_string->str;
+    devanagari_engine->showing_predictions = FALSE;
+
+    if (strlen(preedit_str) == 0)
     {
-        ibus_engine_hide_lookup_table(engine);
+    clear_preedit(devanagari_engine);
+        return;
+    }
+
+    IBusText *preedit_text = ibus_text_new_from_string(preedit_str);
+    ibus_engine_update_preedit_text(engine, preedit_text, strlen(preedit_str), TRUE);
+
+    AksharCandidateDelivery *delivery = g_new0(AksharCandidateDelivery, 1);
+    g_weak_ref_init(&delivery->engine, devanagari_engine);
+    delivery->requested_at = g_get_monotonic_time();
+    devanagari_engine->requested_generation = akshar_ime_session_request_candidates(
+        devanagari_engine->session, devanagari_engine->layout->candidate_count, on_candidates_ready, delivery);
+    if (devanagari_engine->requested_generation == 0)
+    {
+        // No session, so no callback will come.
+        candidate_delivery_free(delivery);
     }
 }
 
@@ -124,54 +346,58 @@ static void commit_best_candidate(IBusDevanagariEngine *devanagari_engine)
     if (devanagari_engine->preedit_string->len == 0)
         return;
 
-    const char *preedit_for_confirm = g_strdup(devanagari_engine->preedit_string->str);
     IBusText *commit_text = NULL;
 
-    // First, try to get the user-selected candidate
-    guint index = ibus_lookup_table_get_cursor_pos(devanagari_engine->table);
-    commit_text = ibus_lookup_table_get_candidate(devanagari_engine->table, index);
+    // First, try to get the user-selected candidate, unless the table still
+    // lists candidates for an older prefix
+    if (devanagari_engine->shown_generation == devanagari_engine->requested_generation)
+    {
+        guint index = ibus_lookup_table_get_cursor_pos(devanagari_engine->table);
+        commit_text = ibus_lookup_table_get_candidate(devanagari_engine->table, index);
+    }
     if (commit_text)
     {
         g_object_ref(commit_text); // Increment ref count because we are using it
     }
 
-    // If no candidate is selected, fetch the top suggestion directly from Rust
-    if (!commit_text)
+    if (commit_text && commit_text->text)
     {
-    char *suggestions_json = akshar_ime_get_suggestions(preedit_for_confirm);
-        json_error_t error;
-        json_t *root = json_loads(suggestions_json, 0, &error);
-        if (root && json_is_array(root) && json_array_size(root) > 0)
-        {
-            json_t *first = json_array_get(root, 0);
-            if (json_is_string(first))
-            {
-                commit_text = ibus_text_new_from_string(json_string_value(first));
-            }
-        }
-        if (root)
-            json_decref(root);
-    akshar_ime_free_string(suggestions_json);
+        ibus_engine_commit_text((IBusEngine *)devanagari_engine, commit_text);
+        akshar_ime_session_confirm_word(devanagari_engine->session, commit_text->text);
     }
-
-    if (commit_text && commit_text->text)
+    else
     {
-    ibus_engine_commit_text((IBusEngine *)devanagari_engine, commit_text);
-    akshar_ime_confirm_word(preedit_for_confirm, commit_text->text);
+        // No current candidate is shown: Rust ranks the list that would be
+        // shown, then confirms and commits its top suggestion in one call
+        char *text = (char *)devanagari_engine->candidate_buffer;
+        if (akshar_ime_session_commit_top(devanagari_engine->session, devanagari_engine->layout->candidate_count,
+                                          text, sizeof(devanagari_engine->candidate_buffer)) > 0)
+        {
+            ibus_engine_commit_text((IBusEngine *)devanagari_engine, ibus_text_new_from_string(text));
+        }
     }
 
     if (commit_text)
     {
         g_object_unref(commit_text);
     }
-    g_free((gpointer)preedit_for_confirm);
     clear_preedit(devanagari_engine);
+    show_predictions(devanagari_engine);
 }
 
 static void ibus_devanagari_engine_candidate_clicked(IBusEngine *engine, guint index, guint button, guint state)
 {
-    ibus_lookup_table_set_cursor_pos(((IBusDevanagariEngine *)engine)->table, index);
-    commit_best_candidate((IBusDevanagariEngine *)engine);
+    IBusDevanagariEngine *devanagari_engine = (IBusDevanagariEngine *)engine;
+    if (devanagari_engine->showing_predictions)
+    {
+        ibus_lookup_table_set_cursor_pos(devanagari_engine->table, index);
+        accept_prediction(devanagari_engine);
+        return;
+    }
+    // A click picks what is on screen, even if newer candidates are on their way.
+    devanagari_engine->shown_generation = devanagari_engine->requested_generation;
+    ibus_lookup_table_set_cursor_pos(devanagari_engine->table, index);
+    commit_best_candidate(devanagari_engine);
 }
 
 // --- RE-ARCHITECTED: The main key event processor ---
@@ -185,6 +411,42 @@ static gboolean ibus_devanagari_engine_process_key_event(IBusEngine *engine, gui
     }
 
     gboolean has_preedit = (devanagari_engine->preedit_string->len > 0);
+
+    // --- Next-word Predictions ---
+    // Up and Down reveal and move the cursor, Return, Tab or space then commit
+    // the prediction under it; any other key dismisses the predictions and is
+    // processed as usual.
+    if (devanagari_engine->showing_predictions && !has_preedit)
+    {
+        IBusLookupTable *table = devanagari_engine->table;
+        gboolean selecting = ibus_lookup_table_is_cursor_visible(table);
+        switch (keyval)
+        {
+        case IBUS_KEY_Up:
+        case IBUS_KEY_Down:
+            if (selecting && keyval == IBUS_KEY_Up)
+                ibus_lookup_table_cursor_up(table);
+            else if (selecting)
+                ibus_lookup_table_cursor_down(table);
+            ibus_lookup_table_set_cursor_visible(table, TRUE);
+            ibus_engine_update_lookup_table(engine, table, TRUE);
+            return TRUE;
+        case IBUS_KEY_Return:
+        case IBUS_KEY_space:
+        case IBUS_KEY_Tab:
+            if (selecting)
+            {
+                accept_prediction(devanagari_engine);
+                return TRUE;
+            }
+            break;
+        case IBUS_KEY_Escape:
+            hide_predictions(devanagari_engine);
+            return TRUE;
+        }
+        hide_predictions(devanagari_engine);
+    }
+
     gboolean has_candidates = ibus_lookup_table_get_number_of_candidates(devanagari_engine->table) > 0;
 
     // --- Punctuation and Symbol Handling ---
@@ -195,25 +457,15 @@ static gboolean ibus_devanagari_engine_process_key_event(IBusEngine *engine, gui
         if (has_preedit)
         {
             commit_best_candidate(devanagari_engine);
+            // The word is followed by the symbol, not by a prediction.
+            hide_predictions(devanagari_engine);
         }
-        // Now, transliterate and commit the symbol itself
-        char symbol_str[2] = {(char)keyval, '\0'};
-        char *suggestions_json = akshar_ime_get_suggestions(symbol_str);
-        json_error_t error;
-        json_t *root = json_loads(suggestions_json, 0, &error);
-        if (root && json_is_array(root) && json_array_size(root) > 0)
+        // Now commit the symbol itself, straight from the symbol table
+        char symbol[16];
+        if (akshar_ime_transliterate_symbol((guint32)keyval, symbol, sizeof(symbol)) > 0)
         {
-            json_t *first = json_array_get(root, 0);
-            if (json_is_string(first))
-            {
-                IBusText *text = ibus_text_new_from_string(json_string_value(first));
-                ibus_engine_commit_text(engine, text);
-                g_object_unref(text);
-            }
+            ibus_engine_commit_text(engine, ibus_text_new_from_string(symbol));
         }
-        if (root)
-            json_decref(root);
-    akshar_ime_free_string(suggestions_json);
         return TRUE; // Consume the key event
     }
 
@@ -258,6 +510,7 @@ static gboolean ibus_devanagari_engine_process_key_event(IBusEngine *engine, gui
         if (has_preedit)
         {
             g_string_truncate(devanagari_engine->preedit_string, devanagari_engine->preedit_string->len - 1);
+            akshar_ime_session_pop_char(devanagari_engine->session);
             update_preedit_and_lookup(devanagari_engine);
             return TRUE;
         }
@@ -268,6 +521,7 @@ static gboolean ibus_devanagari_engine_process_key_event(IBusEngine *engine, gui
     if ((keyval >= IBUS_KEY_a && keyval <= IBUS_KEY_z) || (keyval >= IBUS_KEY_A && keyval <= IBUS_KEY_Z) || (keyval >= IBUS_KEY_0 && keyval <= IBUS_KEY_9))
     {
     g_string_append_c(devanagari_engine->preedit_string, (gchar)keyval);
+    akshar_ime_session_push_char(devanagari_engine->session, keyval);
     update_preedit_and_lookup(devanagari_engine);
     return TRUE;
     }
@@ -275,17 +529,36 @@ static gboolean ibus_devanagari_engine_process_key_event(IBusEngine *engine, gui
     return FALSE;
 }
 
-// --- Main Function (unchanged) ---
+// Logs the latency statistics; set AKSHAR_STATS_INTERVAL to a number of
+// seconds to have them dumped periodically.
+static gboolean dump_stats(gpointer user_data)
+{
+    char *stats = akshar_ime_get_stats();
+    g_message("akshar stats: %s", stats);
+    akshar_ime_free_string(stats);
+    return G_SOURCE_CONTINUE;
+}
+
+// --- Main Function ---
 int main(int argc, char **argv)
 {
     ibus_init();
+    const char *stats_interval = g_getenv("AKSHAR_STATS_INTERVAL");
+    guint64 interval_seconds = stats_interval ? g_ascii_strtoull(stats_interval, NULL, 10) : 0;
+    if (interval_seconds > 0 && interval_seconds <= G_MAXUINT)
+    {
+        g_timeout_add_seconds((guint)interval_seconds, dump_stats, NULL);
+    }
     IBusBus *bus = ibus_bus_new();
     if (!ibus_bus_is_connected(bus))
     {
         return 1;
     }
     IBusFactory *factory = ibus_factory_new(ibus_bus_get_connection(bus));
-    ibus_factory_add_engine(factory, "devanagari-smart", IBUS_TYPE_DEVANAGARI_ENGINE);
+    for (gsize i = 0; i < G_N_ELEMENTS(akshar_layouts); i++)
+    {
+        ibus_factory_add_engine(factory, akshar_layouts[i].name, IBUS_TYPE_DEVANAGARI_ENGINE);
+    }
     if (argc > 1 && strcmp(argv[1], "--ibus") == 0)
     {
         ibus_bus_request_name(bus, "org.freedesktop.IBus.AksharDevanagari", 0);
@@ -0,0 +1,134 @@
+// File: src/import.rs
+//
+// Bulk dictionary seeding from a corpus. Confirming words one at a time pays
+// for a trie walk, a fuzzy index merge and a context update per token; an
+// import instead gathers aggregated records, sorts them once, and builds the
+// trie, the SymSpell index and the bigram tables directly from sorted input.
+//
+// Input is tab-separated UTF-8, one record per line; blank lines and lines
+// starting with '#' are skipped:
+//   words:    roman \t devanagari [\t count]     (count defaults to 1)
+//   bigrams:  previous devanagari \t devanagari [\t count]
+use crate::core::context::ContextModel;
+use crate::core::engine::{ImeEngine, MAX_EDIT_DISTANCE};
+use crate::core::metadata::MetadataStore;
+use crate::core::trie::Trie;
+use crate::core::types::WordId;
+use crate::fuzzy::symspell::SymSpell;
+use std::collections::VecDeque;
+use std::io::{self, BufRead};
+
+struct WordRecord {
+    roman: String,
+    devanagari: String,
+    count: u64,
+}
+
+/// Collects corpus records and builds a ready-to-save engine from them.
+#[derive(Default)]
+pub struct DictionaryBuilder {
+    words: Vec<WordRecord>,
+    bigrams: Vec<(String, String, u64)>,
+}
+
+impl DictionaryBuilder {
+    pub fn new() -> Self {
+        Self::default()
+    }
+
+    /// Records `count` confirmations of `devanagari` typed as `roman`.
+    pub fn add_word(&mut self, roman: &str, devanagari: &str, count: u64) {
+        if roman.is_empty() || devanagari.is_empty() || count == 0 { return; }
+        self.words.push(WordRecord { roman: roman.to_string(), devanagari: devanagari.to_string(), count });
+    }
+
+    /// Records `count` occurrences of `word` right after `previous`.
+    pub fn add_bigram(&mut self, previous: &str, word: &str, count: u64) {
+        if previous.is_empty() || word.is_empty() || count == 0 { return; }
+        self.bigrams.push((previous.to_string(), word.to_string(), count));
+    }
+
+    /// Reads word records. Returns the number of malformed lines skipped.
+    pub fn read_words(&mut self, input: impl BufRead) -> io::Result<usize> {
+        read_records(input, |first, second, count| self.add_word(first, second, count))
+    }
+
+    /// Reads bigram records. Returns the number of malformed lines skipped.
+    pub fn read_bigrams(&mut self, input: impl BufRead) -> io::Result<usize> {
+        read_records(input, |first, second, count| self.add_bigram(first, second, count))
+    }
+
+    /// Builds the engine state in sorted passes:
+    ///   1. sort the word records by (Devanagari, Roman) and fold them into
+    ///      metadata, one WordId per Devanagari form, in sorted order;
+    ///   2. sort the (Roman, word) pairs and give each Roman key to the word it
+    ///      was typed for most often, then build the trie in one sweep;
+    ///   3. index every variant for fuzzy search, hashing deletes on all cores;
+    ///   4. resolve the bigrams to WordIds and build the context tables.
+    /// Bigrams naming a word without a word record are dropped.
+    pub fn build(mut self) -> ImeEngine {
+        // --- Stage 1: Metadata ---
+        self.words.sort_unstable_by(|a, b| (&a.devanagari, &a.roman).cmp(&(&b.devanagari, &b.roman)));
+        let mut metadata_store = MetadataStore::new();
+        // (roman, word, count of that pair); adjacent duplicates are folded.
+        let mut keys: Vec<(String, WordId, u64)> = Vec::new();
+        for record in self.words {
+            let last = metadata_store.len().checked_sub(1);
+            let word_id = match last {
+                Some(word_id) if metadata_store.devanagari(word_id) == record.devanagari => word_id,
+                _ => metadata_store.push(&record.devanagari, 0),
+            };
+            *metadata_store.frequency_mut(word_id) += record.count;
+            match keys.last_mut() {
+                Some((roman, id, count)) if *id == word_id && *roman == record.roman => *count += record.count,
+                _ => {
+                    metadata_store.add_variant(word_id, &record.roman);
+                    keys.push((record.roman, word_id, record.count));
+                }
+            }
+        }
+
+        // --- Stage 2: Trie ---
+        keys.sort_unstable_by(|a, b| a.0.cmp(&b.0).then(b.2.cmp(&a.2)).then(a.1.cmp(&b.1)));
+        keys.dedup_by(|next, kept| next.0 == kept.0);
+        let keys: Vec<(String, WordId)> = keys.into_iter().map(|(roman, word_id, _)| (roman, word_id)).collect();
+        let trie = Trie::from_words(metadata_store, &keys);
+
+        // --- Stage 3: Fuzzy index ---
+        let symspell = SymSpell::from_trie(&trie, MAX_EDIT_DISTANCE);
+
+        // --- Stage 4: Context model ---
+        let bigrams = self.bigrams.into_iter().filter_map(|(previous, word, count)| {
+            let previous = trie.find_word_id_by_devanagari(&previous)?;
+            Some(((previous, trie.find_word_id_by_devanagari(&word)?), count))
+        });
+        let mut engine = ImeEngine::new();
+        engine.context_model = ContextModel::from_bigrams(engine.context_model.window_size(), VecDeque::new(), bigrams);
+        engine.trie = trie;
+        engine.symspell = symspell;
+        engine
+    }
+}
+
+fn read_records(input: impl BufRead, mut add: impl FnMut(&str, &str, u64)) -> io::Result<usize> {
+    let mut skipped = 0;
+    for line in input.lines() {
+        let line = line?;
+        let line = line.trim_end_matches('\r');
+        if line.trim().is_empty() || line.starts_with('#') { continue; }
+        let mut fields = line.split('\t').map(str::trim);
+        let (Some(first), Some(second)) = (fields.next(), fields.next()) else {
+            skipped += 1;
+            continue;
+        };
+        let count = match fields.next() {
+            None => Some(1),
+            Some(count) => count.parse::<u64>().ok(),
+        };
+        match count {
+            Some(count) if !first.is_empty() && !second.is_empty() => add(first, second, count),
+            _ => skipped += 1,
+        }
+    }
+    Ok(skipped)
+}
@@ -0,0 +1,355 @@
+// File: src/journal.rs
+//
+// Append-only journal of word confirmations. Every `user_confirms` is handed to
+// a background writer thread, so learning survives a crash without the key-event
+// thread ever waiting on disk. Periodically a snapshot is encoded from shared
+// state, on a thread of its own when the engine sits behind an `EngineHandle`,
+// and the writer thread persists it and truncates the journal.
+//
+// Record layout (little-endian):
+//   u32 payload_len | u32 checksum | payload
+//   payload = u64 seq | u32 roman_len | roman | u32 devanagari_len | devanagari
+//             [| u8 context_len | (u32 word_len | word) * context_len]
+// The optional tail holds the words typed before this one in the same input
+// context; records without it follow the engine's global history.
+// Replay stops at the first truncated or corrupt record, which is what a torn
+// write at crash time looks like.
+//
+// The journal file is held under an exclusive lock while it is open, so only
+// one engine, in this process or any other, ever writes a given dictionary.
+use crate::core::context::ContextHistory;
+use crate::learning::WordConfirmation;
+use crate::lexicon::fnv1a64;
+use std::fs::{File, OpenOptions};
+use std::io::{self, BufReader, Read, Write};
+use std::path::{Path, PathBuf};
+use std::sync::mpsc::{self, Receiver, Sender};
+use std::thread::JoinHandle;
+use std::time::{Duration, Instant};
+
+/// How long `Journal::open` waits for another engine to let go of the journal,
+/// long enough for one that is closing to write its last snapshot.
+const LOCK_WAIT: Duration = Duration::from_secs(1);
+const LOCK_RETRY: Duration = Duration::from_millis(20);
+
+enum Command {
+    Append(Vec<u8>),
+    /// Persist a snapshot covering every record already appended, then truncate.
+    Snapshot { bytes: Vec<u8>, path: PathBuf },
+}
+
+pub struct Journal {
+    sender: Option<Sender<Command>>,
+    worker: Option<JoinHandle<()>>,
+}
+
+impl Journal {
+    /// Opens (or creates) the journal at `path`, locks it and starts its writer
+    /// thread. Returns the intact records for replay; a torn tail left by a crash
+    /// is cut off so that new records are not appended behind it. Fails with
+    /// `ErrorKind::WouldBlock` if another engine keeps the journal locked.
+    pub fn open(path: &Path) -> io::Result<(Self, Vec<(u64, WordConfirmation)>)> {
+        let file = OpenOptions::new().create(true).append(true).open(path)?;
+        let deadline = Instant::now() + LOCK_WAIT;
+        while !try_lock(&file)? {
+            if Instant::now() >= deadline {
+                return Err(io::Error::new(io::ErrorKind::WouldBlock, "dictionary is open in another engine"));
+            }
+            std::thread::sleep(LOCK_RETRY);
+        }
+        let (records, valid_len) = read_journal(path)?;
+        file.set_len(valid_len)?;
+
+        let (sender, receiver) = mpsc::channel();
+        let worker = std::thread::Builder::new()
+            .name("akshar-journal".to_string())
+            .spawn(move || writer_loop(file, receiver))?;
+        Ok((Self { sender: Some(sender), worker: Some(worker) }, records))
+    }
+
+    /// Queues a confirmation for durable storage. Never blocks on I/O.
+    pub fn append(&self, seq: u64, confirmation: &WordConfirmation) {
+        self.send(Command::Append(encode_record(seq, confirmation)));
+    }
+
+    /// Hands an encoded snapshot to the writer thread. Once it is persisted at
+    /// `path`, the records it covers are dropped from the journal.
+    pub fn snapshot(&self, bytes: Vec<u8>, path: &Path) {
+        self.send(Command::Snapshot { bytes, path: path.to_path_buf() });
+    }
+
+    fn send(&self, command: Command) {
+        if let Some(sender) = &self.sender {
+            let _ = sender.send(command);
+        }
+    }
+}
+
+impl Drop for Journal {
+    /// Drains everything still queued before returning.
+    fn drop(&mut self) {
+        self.sender.take();
+        if let Some(worker) = self.worker.take() {
+            let _ = worker.join();
+        }
+    }
+}
+
+/// Takes the exclusive lock on `file` if no one else holds it. The lock goes
+/// with the file, when the writer thread closes it.
+#[cfg(unix)]
+fn try_lock(file: &File) -> io::Result<bool> {
+    use std::os::unix::io::AsRawFd;
+    if unsafe { libc::flock(file.as_raw_fd(), libc::LOCK_EX | libc::LOCK_NB) } == 0 {
+        return Ok(true);
+    }
+    match io::Error::last_os_error() {
+        e if e.kind() == io::ErrorKind::WouldBlock => Ok(false),
+        e => Err(e),
+    }
+}
+
+#[cfg(not(unix))]
+fn try_lock(_file: &File) -> io::Result<bool> {
+    Ok(true)
+}
+
+fn writer_loop(mut file: File, receiver: Receiver<Command>) {
+    while let Ok(command) = receiver.recv() {
+        apply(&mut file, command);
+        // Group commit: drain whatever queued up meanwhile, then sync once.
+        while let Ok(command) = receiver.try_recv() {
+            apply(&mut file, command);
+        }
+        let _ = file.sync_data();
+    }
+}
+
+fn apply(file: &mut File, command: Command) {
+    let result = match command {
+        Command::Append(record) => file.write_all(&record),
+        Command::Snapshot { bytes, path } => {
+            crate::persistence::write_snapshot(&bytes, &path).and_then(|_| file.set_len(0))
+        }
+    };
+    if let Err(e) = result {
+        eprintln!("[Rust WARN] Journal write failed: {}", e);
+    }
+}
+
+fn encode_record(seq: u64, confirmation: &WordConfirmation) -> Vec<u8> {
+    let roman = confirmation.roman.as_bytes();
+    let devanagari = confirmation.devanagari.as_bytes();
+    let mut payload = Vec::with_capacity(16 + roman.len() + devanagari.len());
+    payload.extend_from_slice(&seq.to_le_bytes());
+    payload.extend_from_slice(&(roman.len() as u32).to_le_bytes());
+    payload.extend_from_slice(roman);
+    payload.extend_from_slice(&(devanagari.len() as u32).to_le_bytes());
+    payload.extend_from_slice(devanagari);
+    if let Some(context) = &confirmation.context {
+        payload.push(context.words().count() as u8);
+        for word in context.words() {
+            payload.extend_from_slice(&(word.len() as u32).to_le_bytes());
+            payload.extend_from_slice(word.as_bytes());
+        }
+    }
+
+    let mut record = Vec::with_capacity(8 + payload.len());
+    record.extend_from_slice(&(payload.len() as u32).to_le_bytes());
+    record.extend_from_slice(&(fnv1a64(&payload) as u32).to_le_bytes());
+    record.extend_from_slice(&payload);
+    record
+}
+
+fn decode_payload(payload: &[u8]) -> Option<(u64, WordConfirmation)> {
+    let take = |at: usize, len: usize| payload.get(at..at + len);
+    let read_u32 = |at: usize| take(at, 4).map(|b| u32::from_le_bytes(b.try_into().unwrap()) as usize);
+
+    let seq = u64::from_le_bytes(take(0, 8)?.try_into().ok()?);
+    let roman_len = read_u32(8)?;
+    let roman = std::str::from_utf8(take(12, roman_len)?).ok()?;
+    let devanagari_len = read_u32(12 + roman_len)?;
+    let devanagari = std::str::from_utf8(take(16 + roman_len, devanagari_len)?).ok()?;
+
+    let mut at = 16 + roman_len + devanagari_len;
+    let context = match payload.get(at) {
+        None => None,
+        Some(&context_len) => {
+            at += 1;
+            let mut history = ContextHistory::new();
+            for _ in 0..context_len {
+                let word_len = read_u32(at)?;
+                history.push(std::str::from_utf8(take(at + 4, word_len)?).ok()?);
+                at += 4 + word_len;
+            }
+            Some(history)
+        }
+    };
+    let confirmation = WordConfirmation { roman: roman.to_string(), devanagari: devanagari.to_string(), context };
+    Some((seq, confirmation))
+}
+
+/// Reads every intact record from the journal at `path`, along with the byte
+/// length they span. A missing journal is empty.
+fn read_journal(path: &Path) -> io::Result<(Vec<(u64, WordConfirmation)>, u64)> {
+    let file = match File::open(path) {
+        Ok(file) => file,
+        Err(e) if e.kind() == io::ErrorKind::NotFound => return Ok((Vec::new(), 0)),
+        Err(e) => return Err(e),
+    };
+    let mut bytes = Vec::new();
+    BufReader::new(file).read_to_end(&mut bytes)?;
+
+    let mut records = Vec::new();
+    let mut offset = 0;
+    while let Some(header) = bytes.get(offset..offset + 8) {
+        let payload_len = u32::from_le_bytes(header[..4].try_into().unwrap()) as usize;
+        let checksum = u32::from_le_bytes(header[4..].try_into().unwrap());
+        let Some(payload) = bytes.get(offset + 8..offset + 8 + payload_len) else { break };
+        if fnv1a64(payload) as u32 != checksum {
+            break;
+        }
+        let Some(record) = decode_payload(payload) else { break };
+        records.push(record);
+        offset += 8 + payload_len;
+    }
+    Ok((records, offset as u64))
+}
+
+/// The journal that accompanies the snapshot at `dictionary_path`.
+pub fn journal_path(dictionary_path: &Path) -> PathBuf {
+    dictionary_path.with_extension("journal")
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    fn confirmation(roman: &str, devanagari: &str, context: Option<&[&str]>) -> WordConfirmation {
+        let context = context.map(|words| {
+            let mut history = ContextHistory::new();
+            words.iter().for_each(|word| history.push(word));
+            history
+        });
+        WordConfirmation { roman: roman.to_string(), devanagari: devanagari.to_string(), context }
+    }
+
+    fn write_records(path: &Path, records: &[(u64, WordConfirmation)]) -> Vec<usize> {
+        let mut bytes = Vec::new();
+        let mut ends = Vec::new();
+        for (seq, confirmation) in records {
+            bytes.extend_from_slice(&encode_record(*seq, confirmation));
+            ends.push(bytes.len());
+        }
+        std::fs::write(path, &bytes).unwrap();
+        ends
+    }
+
+    fn assert_same(read: &[(u64, WordConfirmation)], expected: &[(u64, WordConfirmation)]) {
+        assert_eq!(read.len(), expected.len());
+        for ((seq, got), (expected_seq, want)) in read.iter().zip(expected) {
+            assert_eq!(seq, expected_seq);
+            assert_eq!(got.roman, want.roman);
+            assert_eq!(got.devanagari, want.devanagari);
+            assert_eq!(got.context, want.context);
+        }
+    }
+
+    #[test]
+    fn records_round_trip_with_and_without_context() {
+        let records = [
+            (1, confirmation("namaste", "नमस्ते", None)),
+            (2, confirmation("ghar", "घर", Some(&["मेरो"]))),
+            (3, confirmation("ma", "म", Some(&[]))),
+        ];
+        for (seq, original) in &records {
+            let record = encode_record(*seq, original);
+            let (decoded_seq, decoded) = decode_payload(&record[8..]).unwrap();
+            assert_same(&[(decoded_seq, decoded)], &[(*seq, original.clone())]);
+        }
+
+        let dir = tempfile::tempdir().unwrap();
+        let path = dir.path().join("dictionary.journal");
+        let ends = write_records(&path, &records);
+        let (read, valid_len) = read_journal(&path).unwrap();
+        assert_same(&read, &records);
+        assert_eq!(valid_len, ends[2] as u64);
+    }
+
+    #[test]
+    fn missing_journal_is_empty() {
+        let dir = tempfile::tempdir().unwrap();
+        let (records, valid_len) = read_journal(&dir.path().join("none.journal")).unwrap();
+        assert!(records.is_empty());
+        assert_eq!(valid_len, 0);
+    }
+
+    #[test]
+    fn torn_tail_is_cut_before_new_appends() {
+        let dir = tempfile::tempdir().unwrap();
+        let path = dir.path().join("dictionary.journal");
+        let records = [(1, confirmation("ka", "क", None)), (2, confirmation("kha", "ख", Some(&["क"])))];
+        let ends = write_records(&path, &records);
+        // A crash in the middle of the second record.
+        let file = OpenOptions::new().write(true).open(&path).unwrap();
+        file.set_len(ends[1] as u64 - 3).unwrap();
+        drop(file);
+
+        let (journal, replay) = Journal::open(&path).unwrap();
+        assert_same(&replay, &records[..1]);
+        assert_eq!(std::fs::metadata(&path).unwrap().len(), ends[0] as u64);
+        let appended = confirmation("ga", "ग", None);
+        journal.append(3, &appended);
+        drop(journal);
+
+        let (read, _) = read_journal(&path).unwrap();
+        assert_same(&read, &[records[0].clone(), (3, appended)]);
+    }
+
+    #[test]
+    fn corrupt_record_ends_replay() {
+        let dir = tempfile::tempdir().unwrap();
+        let path = dir.path().join("dictionary.journal");
+        let records = [
+            (1, confirmation("ka", "क", None)),
+            (2, confirmation("kha", "ख", None)),
+            (3, confirmation("ga", "ग", None)),
+        ];
+        let ends = write_records(&path, &records);
+        let mut bytes = std::fs::read(&path).unwrap();
+        // Flip a byte of the second record's payload; its checksum no longer matches.
+        bytes[ends[1] - 1] ^= 0x55;
+        std::fs::write(&path, &bytes).unwrap();
+
+        let (read, valid_len) = read_journal(&path).unwrap();
+        assert_same(&read, &records[..1]);
+        assert_eq!(valid_len, ends[0] as u64);
+    }
+
+    #[test]
+    fn second_open_is_refused_until_the_first_closes() {
+        let dir = tempfile::tempdir().unwrap();
+        let path = dir.path().join("dictionary.journal");
+        let (journal, _) = Journal::open(&path).unwrap();
+        let refused = Journal::open(&path).err().map(|e| e.kind());
+        assert_eq!(refused, Some(io::ErrorKind::WouldBlock));
+        drop(journal);
+        assert!(Journal::open(&path).is_ok());
+    }
+
+    #[test]
+    fn snapshot_truncates_the_journal() {
+        let dir = tempfile::tempdir().unwrap();
+        let path = dir.path().join("dictionary.journal");
+        let snapshot_path = dir.path().join("dictionary.bin");
+        let (journal, _) = Journal::open(&path).unwrap();
+        journal.append(1, &confirmation("ka", "क", None));
+        journal.snapshot(b"snapshot".to_vec(), &snapshot_path);
+        journal.append(2, &confirmation("kha", "ख", None));
+        drop(journal);
+
+        assert_eq!(std::fs::read(&snapshot_path).unwrap(), b"snapshot");
+        let (read, _) = read_journal(&path).unwrap();
+        assert_same(&read, &[(2, confirmation("kha", "ख", None))]);
+    }
+}
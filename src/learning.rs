@@ -1,14 +1,30 @@
 // File: src/learning.rs
-use crate::core::{context::ContextModel, trie::Trie}; // MODIFIED
+use crate::core::{context::{ContextHistory, ContextModel}, trie::Trie}; // MODIFIED
+use crate::core::stats::{self, Stage};
+use crate::core::types::WordId;
 use crate::fuzzy::symspell::SymSpell;
 
 pub struct LearningEngine {
     frequency_increment: u64,
 }
 
+#[derive(Clone)]
 pub struct WordConfirmation {
     pub roman: String,
     pub devanagari: String,
+    /// The words confirmed before this one in the same input context, or
+    /// `None` to follow the model's own history (whatever was confirmed last).
+    pub context: Option<ContextHistory>,
+}
+
+/// What `LearningEngine::learn_word` changed, which `index_word` needs.
+#[derive(Debug, Clone, Copy)]
+pub struct LearnedWord {
+    pub word_id: WordId,
+    /// The Roman form was not yet a variant of the word.
+    pub new_variant: bool,
+    /// The word itself was new.
+    pub new_word: bool,
 }
 
 impl LearningEngine {
@@ -23,26 +39,51 @@ impl LearningEngine {
         symspell: &mut SymSpell,
         confirmation: &WordConfirmation,
     ) {
+        let _timer = stats::timer(Stage::Learn);
+        let learned = self.learn_word(trie, confirmation);
+        self.index_word(trie, context_model, symspell, confirmation, learned);
+    }
+
+    /// The trie half of `learn`: the word's frequency, variant and Roman key.
+    /// Enough for prefix suggestions; `index_word` completes it.
+    pub fn learn_word(&self, trie: &mut Trie, confirmation: &WordConfirmation) -> LearnedWord {
     let word_id = trie.get_or_create_metadata(&confirmation.devanagari);
         
-        let metadata = &mut trie.metadata_store[word_id];
-        metadata.frequency += self.frequency_increment;
+        let metadata = &mut trie.metadata_store;
+        *metadata.frequency_mut(word_id) += self.frequency_increment;
         
         // Only add the variant if it's new, to avoid bloating the metadata store
-        if metadata.variants.insert(confirmation.roman.clone()) {
+        let new_variant = metadata.add_variant(word_id, &confirmation.roman);
+        let new_word = new_variant && metadata.variants(word_id).len() == 1;
+        
+        trie.insert(&confirmation.roman, word_id);
+        LearnedWord { word_id, new_variant, new_word }
+    }
+
+    /// The fuzzy index and context half of `learn`, for a word `learn_word`
+    /// has applied. Confirmations must be indexed in the order they were learned.
+    pub fn index_word(
+        &self,
+        trie: &Trie,
+        context_model: &mut ContextModel,
+        symspell: &mut SymSpell,
+        confirmation: &WordConfirmation,
+        learned: LearnedWord,
+    ) {
+        let context = match &confirmation.context {
+            Some(history) => context_model.context_of(history, trie),
+            None => context_model.context(),
+        };
+        if learned.new_variant {
             // OPTIMIZATION: Only add the primary Roman variant and the Devanagari word itself to the
             // fuzzy index. This keeps the SymSpell dictionary much smaller and faster than
             // indexing every single user-typed variant.
-            symspell.add_word(&confirmation.roman, word_id);
-            if metadata.variants.len() == 1 { // First time we see this word, add its Nepali form too
-                 symspell.add_word(&confirmation.devanagari, word_id);
+            symspell.add_word(&confirmation.roman, learned.word_id);
+            if learned.new_word { // First time we see this word, add its Nepali form too
+                 symspell.add_word(&confirmation.devanagari, learned.word_id);
             }
         }
-        
-        let updated_freq = metadata.frequency;
-
-        trie.insert(&confirmation.roman, word_id, updated_freq);
 
-        context_model.add_word(word_id);
+        context_model.add_word_after(context, learned.word_id);
     }
-}
\ No newline at end of file
+}
@@ -0,0 +1,475 @@
+// File: src/lexicon.rs
+//
+// A versioned, memory-mappable dictionary format. Every structure is stored as a
+// flat, 8-byte aligned array addressed by offsets from a fixed header, so a file
+// can be queried in place straight out of the page cache: opening it is O(1) in
+// dictionary size, and every process that maps the same file shares its pages.
+//
+// Layout (all integers little-endian):
+//
+//   Header   magic, version, max edit distance, prefix length, section table
+//   Nodes          [FrozenNode]   breadth-first trie, children contiguous
+//   Labels         [u8]           edge byte leading into each node
+//   Frequencies    [u64]          per WordId
+//   StringOffsets  [u32]          WordId -> byte range in Strings (n + 1 entries)
+//   Strings        [u8]           concatenated Devanagari forms
+//   WordTable      [u32]          open-addressed Devanagari -> WordId hash table
+//   TermOffsets    [u32]          term -> byte range in Terms (n + 1 entries)
+//   Terms          [u8]           concatenated SymSpell terms, for verification
+//   TermWords      [u32]          term -> WordId
+//   DeleteKeys     [u64]          sorted hashes of SymSpell delete variants
+//   DeleteOffsets  [u32]          delete key -> range in Postings (n + 1 entries)
+//   Postings       [u32]          term indices
+use crate::core::frozen_trie::{FrozenNode, FrozenTrieRef};
+use crate::core::trie::Trie;
+use crate::core::types::WordId;
+use crate::fuzzy::symspell::{self, FuzzyMatch, SymSpell};
+use std::fs::{self, File};
+use std::io::{BufWriter, Error, ErrorKind, Write};
+use std::os::unix::io::AsRawFd;
+use std::path::Path;
+use tempfile::NamedTempFile;
+
+const MAGIC: [u8; 8] = *b"AKSHRLEX";
+pub const FORMAT_VERSION: u32 = 2;
+const SECTION_ALIGN: usize = 8;
+const EMPTY_SLOT: u32 = u32::MAX;
+
+#[derive(Clone, Copy)]
+#[repr(usize)]
+enum SectionId {
+    Nodes,
+    Labels,
+    Frequencies,
+    StringOffsets,
+    Strings,
+    WordTable,
+    TermOffsets,
+    Terms,
+    TermWords,
+    DeleteKeys,
+    DeleteOffsets,
+    Postings,
+}
+
+const SECTION_COUNT: usize = 12;
+
+#[derive(Clone, Copy, Default)]
+#[repr(C)]
+struct Section {
+    offset: u64,
+    len: u64,
+}
+
+#[repr(C)]
+struct Header {
+    magic: [u8; 8],
+    version: u32,
+    max_edit_distance: u32,
+    prefix_length: u32,
+    reserved: u32,
+    sections: [Section; SECTION_COUNT],
+}
+
+/// 64-bit FNV-1a. Stable across builds and platforms, which the on-disk hash
+/// tables rely on.
+pub(crate) fn fnv1a64(bytes: &[u8]) -> u64 {
+    let mut hash: u64 = 0xcbf2_9ce4_8422_2325;
+    for &byte in bytes {
+        hash ^= byte as u64;
+        hash = hash.wrapping_mul(0x0000_0100_0000_01b3);
+    }
+    hash
+}
+
+/// A length or index as the `u32` the format stores, or an error for lexicons
+/// too large to address. `u32::MAX` itself is reserved for empty slots.
+fn to_u32(value: usize) -> Result<u32, Error> {
+    u32::try_from(value)
+        .ok()
+        .filter(|&value| value != u32::MAX)
+        .ok_or_else(|| Error::new(ErrorKind::InvalidInput, "lexicon too large for 32-bit offsets"))
+}
+
+fn as_bytes<T: Copy>(items: &[T]) -> &[u8] {
+    unsafe { std::slice::from_raw_parts(items.as_ptr() as *const u8, std::mem::size_of_val(items)) }
+}
+
+/// Serializes a trie and its fuzzy index into the mappable format, atomically
+/// replacing `path`.
+pub fn write_lexicon(trie: &Trie, symspell: &SymSpell, path: &Path) -> Result<(), Error> {
+    if cfg!(target_endian = "big") {
+        return Err(Error::new(ErrorKind::Unsupported, "lexicon files are little-endian"));
+    }
+    let frozen = trie.freeze();
+    let words = &trie.metadata_store;
+    // Node indices and word ids are stored as `u32`.
+    to_u32(frozen.nodes.len())?;
+    to_u32(words.len())?;
+
+    let mut string_offsets = Vec::with_capacity(words.len() + 1);
+    let mut strings = Vec::new();
+    for word in words.iter() {
+        string_offsets.push(to_u32(strings.len())?);
+        strings.extend_from_slice(word.devanagari().as_bytes());
+    }
+    string_offsets.push(to_u32(strings.len())?);
+
+    // Load factor of at most 0.5 keeps linear probes short.
+    let table_len = (words.len() * 2).next_power_of_two().max(2);
+    let mut word_table = vec![EMPTY_SLOT; table_len];
+    for word in words.iter() {
+        let mut slot = fnv1a64(word.devanagari().as_bytes()) as usize & (table_len - 1);
+        while word_table[slot] != EMPTY_SLOT {
+            slot = (slot + 1) & (table_len - 1);
+        }
+        word_table[slot] = word.id() as u32;
+    }
+
+    let mut term_offsets = Vec::new();
+    let mut terms = Vec::new();
+    let mut term_words = Vec::new();
+    for (term, word_id) in symspell.terms() {
+        term_offsets.push(to_u32(terms.len())?);
+        terms.extend_from_slice(term.as_bytes());
+        term_words.push(to_u32(word_id)?);
+    }
+    term_offsets.push(to_u32(terms.len())?);
+
+    // The in-memory index already uses the on-disk key hash, so it is copied as is.
+    let (delete_keys, delete_offsets, postings) = symspell.compact_deletes();
+    to_u32(postings.len())?;
+
+    let payloads: [&[u8]; SECTION_COUNT] = [
+        as_bytes(&frozen.nodes),
+        &frozen.labels,
+        as_bytes(&frozen.frequencies),
+        as_bytes(&string_offsets),
+        &strings,
+        as_bytes(&word_table),
+        as_bytes(&term_offsets),
+        &terms,
+        as_bytes(&term_words),
+        as_bytes(&delete_keys),
+        as_bytes(&delete_offsets),
+        as_bytes(&postings),
+    ];
+
+    let mut header = Header {
+        magic: MAGIC,
+        version: FORMAT_VERSION,
+        max_edit_distance: symspell.max_edit_distance() as u32,
+        prefix_length: symspell.prefix_length() as u32,
+        reserved: 0,
+        sections: [Section::default(); SECTION_COUNT],
+    };
+    let mut offset = std::mem::size_of::<Header>();
+    for (section, payload) in header.sections.iter_mut().zip(payloads.iter()) {
+        offset = (offset + SECTION_ALIGN - 1) & !(SECTION_ALIGN - 1);
+        *section = Section { offset: offset as u64, len: payload.len() as u64 };
+        offset += payload.len();
+    }
+
+    let parent_dir = path.parent().unwrap_or_else(|| Path::new("."));
+    fs::create_dir_all(parent_dir)?;
+    let temp_file = NamedTempFile::new_in(parent_dir)?;
+    {
+        let mut writer = BufWriter::new(&temp_file);
+        let header_bytes = unsafe {
+            std::slice::from_raw_parts(&header as *const Header as *const u8, std::mem::size_of::<Header>())
+        };
+        writer.write_all(header_bytes)?;
+        let mut written = header_bytes.len();
+        for (section, payload) in header.sections.iter().zip(payloads.iter()) {
+            let padding = section.offset as usize - written;
+            writer.write_all(&[0u8; SECTION_ALIGN][..padding])?;
+            writer.write_all(payload)?;
+            written = section.offset as usize + payload.len();
+        }
+        writer.flush()?;
+    }
+    temp_file.as_file().sync_data()?;
+    temp_file.persist(path)?;
+    Ok(())
+}
+
+/// A read-only `mmap` of a file, unmapped on drop.
+struct Mmap {
+    ptr: *mut libc::c_void,
+    len: usize,
+}
+
+// The mapping is read-only and never mutated after creation.
+unsafe impl Send for Mmap {}
+unsafe impl Sync for Mmap {}
+
+impl Mmap {
+    fn open(path: &Path) -> Result<Self, Error> {
+        let file = File::open(path)?;
+        let len = file.metadata()?.len() as usize;
+        if len < std::mem::size_of::<Header>() {
+            return Err(Error::new(ErrorKind::InvalidData, "lexicon file is truncated"));
+        }
+        // MAP_SHARED lets every process mapping this file share the same page cache.
+        let ptr = unsafe {
+            libc::mmap(std::ptr::null_mut(), len, libc::PROT_READ, libc::MAP_SHARED, file.as_raw_fd(), 0)
+        };
+        if ptr == libc::MAP_FAILED {
+            return Err(Error::last_os_error());
+        }
+        Ok(Self { ptr, len })
+    }
+
+    fn bytes(&self) -> &[u8] {
+        unsafe { std::slice::from_raw_parts(self.ptr as *const u8, self.len) }
+    }
+}
+
+impl Drop for Mmap {
+    fn drop(&mut self) {
+        unsafe { libc::munmap(self.ptr, self.len); }
+    }
+}
+
+/// A dictionary queried directly from a memory-mapped lexicon file.
+/// Opening validates only the header, so startup cost does not grow with the
+/// number of words.
+pub struct MappedLexicon {
+    map: Mmap,
+    sections: [Section; SECTION_COUNT],
+    max_edit_distance: usize,
+    prefix_length: usize,
+}
+
+impl MappedLexicon {
+    pub fn open(path: &Path) -> Result<Self, Error> {
+        if cfg!(target_endian = "big") {
+            return Err(Error::new(ErrorKind::Unsupported, "lexicon files are little-endian"));
+        }
+        let map = Mmap::open(path)?;
+        let header = unsafe { &*(map.ptr as *const Header) };
+        if header.magic != MAGIC {
+            return Err(Error::new(ErrorKind::InvalidData, "not an Akshar lexicon file"));
+        }
+        if header.version != FORMAT_VERSION {
+            return Err(Error::new(
+                ErrorKind::InvalidData,
+                format!("unsupported lexicon version {}", header.version),
+            ));
+        }
+
+        let lexicon = Self {
+            sections: header.sections,
+            max_edit_distance: header.max_edit_distance as usize,
+            prefix_length: header.prefix_length as usize,
+            map,
+        };
+        lexicon.validate()?;
+        Ok(lexicon)
+    }
+
+    /// Checks section bounds, alignment and the array-length invariants. Node and
+    /// posting contents are bounds-checked on access instead.
+    fn validate(&self) -> Result<(), Error> {
+        let invalid = |what: &str| Err(Error::new(ErrorKind::InvalidData, format!("corrupt lexicon: {}", what)));
+        let sizes = [
+            std::mem::size_of::<FrozenNode>(),
+            1,
+            std::mem::size_of::<u64>(),
+            std::mem::size_of::<u32>(),
+            1,
+            std::mem::size_of::<u32>(),
+            std::mem::size_of::<u32>(),
+            1,
+            std::mem::size_of::<u32>(),
+            std::mem::size_of::<u64>(),
+            std::mem::size_of::<u32>(),
+            std::mem::size_of::<u32>(),
+        ];
+        for (section, size) in self.sections.iter().zip(sizes) {
+            let end = section.offset.checked_add(section.len);
+            if end.map_or(true, |end| end > self.map.len as u64)
+                || section.offset as usize % SECTION_ALIGN != 0
+                || section.len as usize % size != 0
+            {
+                return invalid("section table");
+            }
+        }
+
+        let words = self.frequencies().len();
+        if self.nodes().is_empty() || self.labels().len() != self.nodes().len() {
+            return invalid("trie");
+        }
+        if self.string_offsets().len() != words + 1
+            || *self.string_offsets().last().unwrap() as usize > self.strings().len()
+        {
+            return invalid("strings");
+        }
+        if !self.word_table().len().is_power_of_two() {
+            return invalid("word table");
+        }
+        if self.term_offsets().len() != self.term_words().len() + 1
+            || *self.term_offsets().last().unwrap() as usize > self.terms().len()
+        {
+            return invalid("terms");
+        }
+        if self.delete_offsets().len() != self.delete_keys().len() + 1
+            || *self.delete_offsets().last().unwrap() as usize > self.postings().len()
+        {
+            return invalid("delete index");
+        }
+        Ok(())
+    }
+
+    fn section<T>(&self, id: SectionId) -> &[T] {
+        let section = self.sections[id as usize];
+        let bytes = &self.map.bytes()[section.offset as usize..(section.offset + section.len) as usize];
+        // Alignment holds because the mapping is page-aligned and sections are 8-aligned.
+        unsafe { std::slice::from_raw_parts(bytes.as_ptr() as *const T, bytes.len() / std::mem::size_of::<T>()) }
+    }
+
+    fn nodes(&self) -> &[FrozenNode] { self.section(SectionId::Nodes) }
+    fn labels(&self) -> &[u8] { self.section(SectionId::Labels) }
+    fn frequencies(&self) -> &[u64] { self.section(SectionId::Frequencies) }
+    fn string_offsets(&self) -> &[u32] { self.section(SectionId::StringOffsets) }
+    fn strings(&self) -> &[u8] { self.section(SectionId::Strings) }
+    fn word_table(&self) -> &[u32] { self.section(SectionId::WordTable) }
+    fn term_offsets(&self) -> &[u32] { self.section(SectionId::TermOffsets) }
+    fn terms(&self) -> &[u8] { self.section(SectionId::Terms) }
+    fn term_words(&self) -> &[u32] { self.section(SectionId::TermWords) }
+    fn delete_keys(&self) -> &[u64] { self.section(SectionId::DeleteKeys) }
+    fn delete_offsets(&self) -> &[u32] { self.section(SectionId::DeleteOffsets) }
+    fn postings(&self) -> &[u32] { self.section(SectionId::Postings) }
+
+    /// The trie, read in place from the mapping.
+    pub fn trie(&self) -> FrozenTrieRef<'_> {
+        FrozenTrieRef {
+            nodes: self.nodes(),
+            labels: self.labels(),
+            frequencies: self.frequencies(),
+        }
+    }
+
+    pub fn word_count(&self) -> usize {
+        self.frequencies().len()
+    }
+
+    pub fn frequency(&self, word_id: WordId) -> u64 {
+        self.frequencies().get(word_id).copied().unwrap_or(0)
+    }
+
+    pub fn devanagari(&self, word_id: WordId) -> Option<&str> {
+        let offsets = self.string_offsets();
+        let start = *offsets.get(word_id)? as usize;
+        let end = *offsets.get(word_id + 1)? as usize;
+        std::str::from_utf8(self.strings().get(start..end)?).ok()
+    }
+
+    /// O(1) expected lookup of a Devanagari word through the on-disk hash table.
+    pub fn find_word_id(&self, devanagari: &str) -> Option<WordId> {
+        let table = self.word_table();
+        let mask = table.len() - 1;
+        let mut slot = fnv1a64(devanagari.as_bytes()) as usize & mask;
+        for _ in 0..table.len() {
+            let id = table[slot];
+            if id == EMPTY_SLOT {
+                return None;
+            }
+            if self.devanagari(id as WordId) == Some(devanagari) {
+                return Some(id as WordId);
+            }
+            slot = (slot + 1) & mask;
+        }
+        None
+    }
+
+    fn term(&self, term_idx: usize) -> Option<(&str, WordId)> {
+        let offsets = self.term_offsets();
+        let start = *offsets.get(term_idx)? as usize;
+        let end = *offsets.get(term_idx + 1)? as usize;
+        let term = std::str::from_utf8(self.terms().get(start..end)?).ok()?;
+        Some((term, *self.term_words().get(term_idx)? as WordId))
+    }
+
+    /// SymSpell lookup against the mapped delete index, verified and ranked the
+    /// same way as `SymSpell::lookup_top_k`.
+    pub fn fuzzy_lookup_top_k(&self, input: &str, k: usize) -> Vec<FuzzyMatch> {
+        let keys = self.delete_keys();
+        let offsets = self.delete_offsets();
+        let postings = self.postings();
+        symspell::with_lookup_scratch(|scratch| {
+            scratch.collect_delete_keys(symspell::char_prefix(input, self.prefix_length), self.max_edit_distance);
+            for key in &scratch.keys {
+                if let Ok(idx) = keys.binary_search(key) {
+                    let range = offsets[idx] as usize..offsets[idx + 1] as usize;
+                    scratch.term_ids.extend(postings.get(range).unwrap_or_default().iter().copied());
+                }
+            }
+            scratch.rank(input, |idx| self.term(idx as usize), self.max_edit_distance, k, |id| self.frequency(id))
+        })
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use crate::core::engine::ImeEngine;
+
+    /// Writes a small lexicon and returns its bytes with the section table.
+    fn lexicon_bytes(path: &Path) -> (Vec<u8>, [Section; SECTION_COUNT]) {
+        let mut engine = ImeEngine::new();
+        engine.user_confirms("namaste", "नमस्ते");
+        engine.user_confirms("ghar", "घर");
+        write_lexicon(&engine.trie, &engine.symspell, path).unwrap();
+        let bytes = fs::read(path).unwrap();
+        let sections = unsafe { (*(bytes.as_ptr() as *const Header)).sections };
+        (bytes, sections)
+    }
+
+    /// Overwrites the `u32` at `offset` within a section, then attaches the
+    /// file to an empty engine and runs exact and fuzzy queries against it.
+    fn query_with_u32(path: &Path, id: SectionId, offset: usize, value: u32) -> ImeEngine {
+        let (mut bytes, sections) = lexicon_bytes(path);
+        let at = sections[id as usize].offset as usize + offset;
+        bytes[at..at + 4].copy_from_slice(&value.to_le_bytes());
+        fs::write(path, &bytes).unwrap();
+        let mut engine = ImeEngine::new();
+        // Only the header is checked at open, so damaged contents still map.
+        engine.attach_lexicon(path).unwrap();
+        for prefix in ["", "n", "namaste", "nmaste", "ghar"] {
+            engine.get_ranked_suggestions(prefix, 5);
+        }
+        engine
+    }
+
+    #[test]
+    fn intact_lexicon_answers_queries() {
+        let dir = tempfile::tempdir().unwrap();
+        let path = dir.path().join("lexicon.bin");
+        lexicon_bytes(&path);
+        let lexicon = MappedLexicon::open(&path).unwrap();
+        assert_eq!(lexicon.devanagari(lexicon.find_word_id("घर").unwrap()), Some("घर"));
+        let word_id = lexicon.trie().word_at("ghar").unwrap();
+        assert_eq!(lexicon.trie().get_top_k_suggestions("gh", 1), vec![(word_id, lexicon.frequency(word_id))]);
+        assert!(lexicon.fuzzy_lookup_top_k("nmaste", 5).iter().any(|m| lexicon.devanagari(m.word_id) == Some("नमस्ते")));
+    }
+
+    #[test]
+    fn out_of_range_contents_read_as_missing() {
+        let dir = tempfile::tempdir().unwrap();
+        let path = dir.path().join("lexicon.bin");
+        let first_child = std::mem::offset_of!(FrozenNode, first_child);
+        let word_id = std::mem::offset_of!(FrozenNode, word_id);
+        // The root's children start past the end of the node array.
+        let engine = query_with_u32(&path, SectionId::Nodes, first_child, u32::MAX - 1);
+        assert_eq!(engine.lexicon.unwrap().trie().word_at("ghar"), None);
+        // The root's children point back at the root, which would cycle.
+        query_with_u32(&path, SectionId::Nodes, first_child, 0);
+        query_with_u32(&path, SectionId::Nodes, word_id, 1000);
+        query_with_u32(&path, SectionId::TermWords, 0, 1000);
+        query_with_u32(&path, SectionId::Postings, 0, 1000);
+        query_with_u32(&path, SectionId::StringOffsets, 4, 1000);
+        query_with_u32(&path, SectionId::WordTable, 0, 1000);
+        query_with_u32(&path, SectionId::DeleteOffsets, 4, u32::MAX);
+    }
+}
@@ -1,7 +1,11 @@
 // File: src/lib.rs
 
+pub mod bulk;
 pub mod core;
+pub mod import;
+pub mod journal;
 pub mod learning;
+pub mod lexicon;
 pub mod persistence;
 pub mod c_api;
 pub mod fuzzy;
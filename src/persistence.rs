@@ -1,48 +1,318 @@
 // File: src/persistence.rs
+use crate::core::context::ContextModel;
 use crate::core::engine::ImeEngine;
-use crate::core::trie::Trie; // MODIFIED
+use crate::core::stats::{self, Stage};
+use crate::core::trie::{LegacyTrie, Trie}; // MODIFIED
+use crate::core::types::WordId;
 use crate::fuzzy::symspell::SymSpell;
+use std::collections::{HashMap, VecDeque};
 use std::fs::{self, File};
-use std::io::{BufReader, BufWriter, Error, ErrorKind};
+use std::io::{BufReader, BufWriter, Error, ErrorKind, Read, Write};
 use std::path::Path;
+use std::sync::Arc;
+use std::thread::JoinHandle;
 use tempfile::NamedTempFile;
 
-#[derive(Clone, serde::Serialize, serde::Deserialize)]
-struct SerializableState {
-    trie: Trie, // MODIFIED
-    context_model: crate::core::context::ContextModel,
-    symspell: SymSpell,
+/// Leads every versioned snapshot. Unversioned snapshots begin with the trie's
+/// node count instead, which can never spell this.
+const SNAPSHOT_MAGIC: [u8; 8] = *b"AKSHRDIC";
+pub const SNAPSHOT_VERSION: u32 = 5;
+const SNAPSHOT_HEADER_LEN: usize = 12;
+
+// Versioned snapshots are split into sections that decode independently, so a
+// load can return as soon as the trie is in and leave the larger fuzzy index
+// and context model to a background thread. After the header comes a table
+//   u32 section_count | (u32 kind | u64 len) * section_count
+// followed by each section's bincode payload in table order. Unknown kinds
+// are skipped.
+const SECTION_CORE: u32 = 1;
+const SECTION_CONTEXT: u32 = 2;
+const SECTION_FUZZY: u32 = 3;
+
+/// `ContextModel` layout of unversioned snapshots: raw bigram counts in a map. Decoded snapshots are converted to the compact n-gram tables.
+#[derive(serde::Deserialize)]
+struct LegacyContextModel {
+    window_size: usize,
+    history: VecDeque<WordId>,
+    bigrams: HashMap<(WordId, WordId), u64>,
 }
 
-pub fn save_to_disk(engine: &ImeEngine, path: &Path) -> Result<(), Error> {
-    let parent_dir = path.parent().unwrap_or_else(|| Path::new("."));
-    fs::create_dir_all(parent_dir)?;
+impl From<LegacyContextModel> for ContextModel {
+    fn from(legacy: LegacyContextModel) -> Self {
+        ContextModel::from_bigrams(legacy.window_size, legacy.history, legacy.bigrams)
+    }
+}
 
-    let state = SerializableState {
-        trie: engine.trie.clone(), // MODIFIED
-        context_model: engine.context_model.clone(),
-        symspell: engine.symspell.clone(),
-    };
+/// Snapshot written before journaling existed. Still accepted by `load_from_disk`.
+/// Its last field, the fuzzy index, is left undecoded: the index is rebuilt
+/// from the trie, and bincode ignores the bytes after the fields read.
+#[derive(serde::Deserialize)]
+struct LegacyState {
+    trie: LegacyTrie,
+    context_model: LegacyContextModel,
+}
 
-    let temp_file = NamedTempFile::new_in(parent_dir)?;
-    let writer = BufWriter::new(&temp_file);
+/// The section every query needs: the trie and its word metadata.
+#[derive(serde::Deserialize)]
+struct CoreSection {
+    trie: Trie,
+    /// Sequence number of the last journal record folded into this snapshot.
+    journal_seq: u64,
+}
 
-    bincode::serialize_into(writer, &state)
-        .map_err(|e| Error::new(ErrorKind::Other, e))?;
+/// Serialization view of `CoreSection`. Borrowing the state avoids deep-cloning
+/// the trie just to write it out; bincode encodes both identically.
+#[derive(serde::Serialize)]
+struct CoreSectionRef<'a> {
+    trie: &'a Trie,
+    journal_seq: u64,
+}
 
+/// The fuzzy index and context model: loaded by a `SectionLoad` when the
+/// snapshot is sectioned, or decoded along with the trie when it is older.
+pub(crate) type WarmSections = (ContextModel, SymSpell);
+
+/// A background decode of the sections that can wait.
+pub(crate) type SectionLoad = JoinHandle<Result<WarmSections, String>>;
+
+/// A decoded trie, with the rest of the snapshot decoded or on its way.
+pub(crate) struct LoadedSnapshot {
+    pub(crate) trie: Trie,
+    pub(crate) journal_seq: u64,
+    pub(crate) rest: Result<WarmSections, SectionLoad>,
+}
+
+pub fn encode_snapshot(engine: &ImeEngine) -> Result<Vec<u8>, Error> {
+    let _timer = stats::timer(Stage::Encode);
+    if engine.is_warming() {
+        return Err(Error::new(ErrorKind::Other, "dictionary is still loading"));
+    }
+    let encode = |e: bincode::Error| Error::new(ErrorKind::Other, e);
+    let core = CoreSectionRef { trie: &engine.trie, journal_seq: engine.journal_seq() };
+    let sections = [
+        (SECTION_CORE, bincode::serialize(&core).map_err(encode)?),
+        (SECTION_CONTEXT, bincode::serialize(&engine.context_model).map_err(encode)?),
+        (SECTION_FUZZY, bincode::serialize(&engine.symspell).map_err(encode)?),
+    ];
+
+    let payload_len: usize = sections.iter().map(|(_, section)| 12 + section.len()).sum();
+    let mut bytes = Vec::with_capacity(SNAPSHOT_HEADER_LEN + 4 + payload_len);
+    bytes.extend_from_slice(&SNAPSHOT_MAGIC);
+    bytes.extend_from_slice(&SNAPSHOT_VERSION.to_le_bytes());
+    bytes.extend_from_slice(&(sections.len() as u32).to_le_bytes());
+    for (kind, section) in &sections {
+        bytes.extend_from_slice(&kind.to_le_bytes());
+        bytes.extend_from_slice(&(section.len() as u64).to_le_bytes());
+    }
+    for (_, section) in &sections {
+        bytes.extend_from_slice(section);
+    }
+    Ok(bytes)
+}
+
+/// Atomically replaces `path` with an encoded snapshot.
+pub fn write_snapshot(bytes: &[u8], path: &Path) -> Result<(), Error> {
+    let _timer = stats::timer(Stage::Write);
+    let parent_dir = path.parent().unwrap_or_else(|| Path::new("."));
+    fs::create_dir_all(parent_dir)?;
+
+    let temp_file = NamedTempFile::new_in(parent_dir)?;
+    {
+        let mut writer = BufWriter::new(&temp_file);
+        writer.write_all(bytes)?;
+        writer.flush()?;
+    }
+    temp_file.as_file().sync_data()?;
     temp_file.persist(path)?;
     Ok(())
 }
 
+pub fn save_to_disk(engine: &ImeEngine, path: &Path) -> Result<(), Error> {
+    write_snapshot(&encode_snapshot(engine)?, path)
+}
+
+/// Loads a snapshot completely, waiting for every section.
 pub fn load_from_disk(path: &Path) -> Result<ImeEngine, Box<dyn std::error::Error>> {
-    let file = File::open(path)?;
-    let reader = BufReader::new(file);
-    let state: SerializableState = bincode::deserialize_from(reader)?;
-    
+    let mut engine = load_from_disk_lazy(path)?;
+    engine.finish_warmup();
+    Ok(engine)
+}
+
+/// Loads a snapshot's trie and returns at once; a sectioned snapshot's fuzzy
+/// index and context model keep decoding on a background thread until
+/// `ImeEngine::finish_warmup` installs them.
+pub fn load_from_disk_lazy(path: &Path) -> Result<ImeEngine, Box<dyn std::error::Error>> {
+    let _timer = stats::timer(Stage::Load);
+    let mut bytes = Vec::new();
+    BufReader::new(File::open(path)?).read_to_end(&mut bytes)?;
+    let snapshot = decode_snapshot(bytes)?;
+
     let mut engine = ImeEngine::new();
-    engine.trie = state.trie; // MODIFIED
-    engine.context_model = state.context_model;
-    engine.symspell = state.symspell;
-    
+    engine.trie = snapshot.trie; // MODIFIED
+    engine.set_journal_seq(snapshot.journal_seq);
+    engine.start_warmup(snapshot.rest);
     Ok(engine)
-}
\ No newline at end of file
+}
+
+fn decode_snapshot(bytes: Vec<u8>) -> Result<LoadedSnapshot, Box<dyn std::error::Error>> {
+    if !bytes.starts_with(&SNAPSHOT_MAGIC) {
+        return decode_legacy_snapshot(&bytes);
+    }
+    let version = bytes
+        .get(SNAPSHOT_MAGIC.len()..SNAPSHOT_HEADER_LEN)
+        .map(|b| u32::from_le_bytes(b.try_into().unwrap()));
+    match version {
+        Some(SNAPSHOT_VERSION) => decode_sections(bytes),
+        _ => Err(Box::new(Error::new(ErrorKind::InvalidData, "unsupported dictionary version"))),
+    }
+}
+
+/// Decodes the core section now and starts a thread for the others.
+fn decode_sections(bytes: Vec<u8>) -> Result<LoadedSnapshot, Box<dyn std::error::Error>> {
+    let invalid = || Error::new(ErrorKind::InvalidData, "truncated dictionary section table");
+    let read_u32 = |at: usize| bytes.get(at..at + 4).map(|b| u32::from_le_bytes(b.try_into().unwrap()));
+    let read_u64 = |at: usize| bytes.get(at..at + 8).map(|b| u64::from_le_bytes(b.try_into().unwrap()));
+
+    let section_count = read_u32(SNAPSHOT_HEADER_LEN).ok_or_else(invalid)? as usize;
+    let table_start = SNAPSHOT_HEADER_LEN + 4;
+    let mut offset = table_start + section_count * 12;
+    let (mut core, mut context, mut fuzzy) = (None, None, None);
+    for i in 0..section_count {
+        let entry = table_start + i * 12;
+        let kind = read_u32(entry).ok_or_else(invalid)?;
+        let len = read_u64(entry + 4).ok_or_else(invalid)? as usize;
+        let range = offset..offset.checked_add(len).filter(|&end| end <= bytes.len()).ok_or_else(invalid)?;
+        match kind {
+            SECTION_CORE => core = Some(range.clone()),
+            SECTION_CONTEXT => context = Some(range.clone()),
+            SECTION_FUZZY => fuzzy = Some(range.clone()),
+            _ => {}
+        }
+        offset = range.end;
+    }
+
+    let core_range = core.ok_or_else(|| Error::new(ErrorKind::InvalidData, "dictionary has no trie section"))?;
+    let core: CoreSection = bincode::deserialize(&bytes[core_range])?;
+
+    // The thread owns the file contents; the trie is already decoded from them.
+    let bytes = Arc::new(bytes);
+    let decode_rest = {
+        let bytes = Arc::clone(&bytes);
+        move || -> Result<WarmSections, String> {
+            let _timer = stats::timer(Stage::Warmup);
+            let section = |range: Option<std::ops::Range<usize>>, name: &str| {
+                range.map(|range| &bytes[range]).ok_or_else(|| format!("dictionary has no {} section", name))
+            };
+            let context_model = bincode::deserialize(section(context, "context")?).map_err(|e| e.to_string())?;
+            let symspell = bincode::deserialize(section(fuzzy, "fuzzy index")?).map_err(|e| e.to_string())?;
+            Ok((context_model, symspell))
+        }
+    };
+    let rest = match std::thread::Builder::new().name("akshar-warmup".into()).spawn(decode_rest.clone()) {
+        Ok(thread) => Err(thread),
+        Err(e) => {
+            eprintln!("[Rust WARN] Could not start dictionary warm-up thread: {}", e);
+            Ok(decode_rest().map_err(|e| Error::new(ErrorKind::InvalidData, e))?)
+        }
+    };
+    Ok(LoadedSnapshot { trie: core.trie, journal_seq: core.journal_seq, rest })
+}
+
+/// Decodes an unversioned snapshot, written before journaling existed.
+fn decode_legacy_snapshot(bytes: &[u8]) -> Result<LoadedSnapshot, Box<dyn std::error::Error>> {
+    // Its fuzzy index predates term verification and is rebuilt.
+    let legacy: LegacyState = bincode::deserialize(bytes)?;
+    Ok(with_rebuilt_index(legacy.trie.into(), legacy.context_model.into(), 0))
+}
+
+/// The baseline fuzzy index layout is discarded and rebuilt from the trie metadata.
+fn with_rebuilt_index(trie: Trie, context_model: ContextModel, journal_seq: u64) -> LoadedSnapshot {
+    let symspell = SymSpell::from_trie(&trie, crate::core::engine::MAX_EDIT_DISTANCE);
+    LoadedSnapshot { trie, journal_seq, rest: Ok((context_model, symspell)) }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use crate::core::types::WordMetadata;
+    use serde::Serialize;
+
+    /// The baseline `Trie`, `ContextModel` and `SymSpell`, field for field.
+    #[derive(Serialize)]
+    struct BaselineNode {
+        children: HashMap<u8, usize>,
+        word_id: Option<WordId>,
+        max_freq_in_subtree: u64,
+    }
+
+    #[derive(Serialize)]
+    struct BaselineState {
+        nodes: Vec<BaselineNode>,
+        metadata_store: Vec<WordMetadata>,
+        window_size: usize,
+        history: VecDeque<WordId>,
+        bigrams: HashMap<(WordId, WordId), u64>,
+        deletes: HashMap<String, std::collections::HashSet<WordId>>,
+        max_edit_distance: usize,
+    }
+
+    fn node(children: &[(u8, usize)], word_id: Option<WordId>, max_freq_in_subtree: u64) -> BaselineNode {
+        BaselineNode { children: children.iter().copied().collect(), word_id, max_freq_in_subtree }
+    }
+
+    fn word(devanagari: &str, frequency: u64, variant: &str) -> WordMetadata {
+        WordMetadata { devanagari: devanagari.to_string(), frequency, variants: [variant.to_string()].into() }
+    }
+
+    #[test]
+    fn baseline_snapshot_still_loads() {
+        // "ma" -> म (3 confirmations), "mo" -> मो (1), each confirmed after the other once.
+        let state = BaselineState {
+            nodes: vec![
+                node(&[(b'm', 1)], None, 3),
+                node(&[(b'a', 2), (b'o', 3)], None, 3),
+                node(&[], Some(0), 3),
+                node(&[], Some(1), 1),
+            ],
+            metadata_store: vec![word("म", 3, "ma"), word("मो", 1, "mo")],
+            window_size: 3,
+            history: VecDeque::from([1]),
+            bigrams: HashMap::from([((0, 1), 1), ((1, 0), 1)]),
+            deletes: HashMap::from([("m".to_string(), [0, 1].into())]),
+            max_edit_distance: 2,
+        };
+        let dir = tempfile::tempdir().unwrap();
+        let path = dir.path().join("user_dictionary.bin");
+        std::fs::write(&path, bincode::serialize(&state).unwrap()).unwrap();
+
+        let engine = load_from_disk(&path).unwrap();
+        assert_eq!(engine.journal_seq(), 0);
+        let top = engine.trie.get_top_k_suggestions("m", 2);
+        assert_eq!(top, vec![(0, 3), (1, 1)]);
+        assert_eq!(engine.trie.find_word_id_by_devanagari("मो"), Some(1));
+        assert!(engine.context_model.successors(0).any(|(word_id, _)| word_id == 1));
+        // The fuzzy index is rebuilt from the trie.
+        assert!(engine.get_suggestions("maa", 5).iter().any(|(devanagari, _)| devanagari == "म"));
+    }
+
+    #[test]
+    fn snapshot_round_trips_and_rejects_other_versions() {
+        let mut engine = ImeEngine::new();
+        engine.user_confirms("namaste", "नमस्ते");
+        engine.user_confirms("ghar", "घर");
+        let bytes = encode_snapshot(&engine).unwrap();
+        let dir = tempfile::tempdir().unwrap();
+        let path = dir.path().join("user_dictionary.bin");
+        std::fs::write(&path, &bytes).unwrap();
+        let loaded = load_from_disk(&path).unwrap();
+        assert_eq!(loaded.journal_seq(), 2);
+        assert_eq!(loaded.trie.get_top_k_suggestions("gh", 1).len(), 1);
+
+        let mut other = bytes.clone();
+        other[SNAPSHOT_MAGIC.len()..SNAPSHOT_HEADER_LEN].copy_from_slice(&4u32.to_le_bytes());
+        std::fs::write(&path, &other).unwrap();
+        assert!(load_from_disk(&path).is_err());
+        std::fs::write(&path, &bytes[..bytes.len() - 5]).unwrap();
+        assert!(load_from_disk(&path).is_err());
+    }
+}